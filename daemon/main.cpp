@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * sprinterd: hosts the runners for all the applications in a user session
+ *
+ * Usage: sprinterd [--plugin-path DIR] [--timeout SECS] [--socket PATH]
+ *                  [--sandbox RUNNER] [--nice N]
+ *
+ * Applications use the daemon when SPRINTER_DAEMON is set in their
+ * environment: to 1 for the default socket, sprinterd in the user's
+ * runtime directory, or to the path of another socket, which sprinterd
+ * then needs to have set as well. --timeout is how long to wait for the
+ * runners to load before listening anyways. Set QT_QPA_PLATFORM=offscreen
+ * to run without a display.
+ *
+ * Applications also start sprinterd themselves for the runners they put
+ * in sandboxes (see SPRINTER_SANDBOX), with --sandbox set to the runner
+ * to host, --socket to a path of their own and --nice to the niceness to
+ * run at, if any; such a sandbox exits once the application is gone.
+ */
+
+#include <QGuiApplication>
+#include <QStringList>
+#include <QTextStream>
+
+#include "sprinter/daemonserver_p.h"
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+static int usage()
+{
+    QTextStream(stderr) << "Usage: sprinterd [--plugin-path DIR] [--timeout SECS] [--socket PATH]\n"
+                           "                 [--sandbox RUNNER] [--nice N]\n";
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    QGuiApplication app(argc, argv);
+    app.setQuitOnLastWindowClosed(false);
+
+    Sprinter::DaemonServer server;
+    int timeout = 30;
+    int niceness = 0;
+    const QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        const QString arg = args.at(i);
+        if (arg == QLatin1String("--help") || i + 1 >= args.size()) {
+            return usage();
+        }
+
+        const QString value = args.at(++i);
+        bool ok = true;
+        if (arg == QLatin1String("--plugin-path")) {
+            QCoreApplication::addLibraryPath(value);
+        } else if (arg == QLatin1String("--timeout")) {
+            timeout = value.toInt(&ok);
+        } else if (arg == QLatin1String("--socket")) {
+            server.setSocketPath(value);
+        } else if (arg == QLatin1String("--sandbox")) {
+            server.setRunners(QStringList() << value);
+            server.setExitWhenUnused(true);
+        } else if (arg == QLatin1String("--nice")) {
+            niceness = value.toInt(&ok);
+        } else {
+            return usage();
+        }
+
+        if (!ok) {
+            return usage();
+        }
+    }
+
+#ifdef Q_OS_UNIX
+    // before the runners are loaded, so all of their threads inherit it
+    if (niceness && setpriority(PRIO_PROCESS, 0, niceness) != 0) {
+        QTextStream(stderr) << "sprinterd: could not set the niceness to " << niceness << "\n";
+    }
+#endif
+
+    if (!server.start(timeout * 1000)) {
+        QTextStream(stderr) << "sprinterd: " << server.errorString() << "\n";
+        return 1;
+    }
+
+    return app.exec();
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright 2014 by Marco Martin <mart@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MATCHIMAGEPROVIDER_H
+#define MATCHIMAGEPROVIDER_H
+
+#include <QtQuick/QQuickImageProvider>
+
+/**
+ * Serves the image://sprinter/<match-id>/<size> URLs returned by the
+ * QuerySession ImageRole. Images are loaded off the GUI thread and
+ * the scene graph caches the resulting textures per URL.
+ */
+class MatchImageProvider : public QQuickImageProvider
+{
+public:
+    MatchImageProvider();
+
+    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize);
+};
+
+#endif
@@ -27,6 +27,8 @@
 
 #include <QDebug>
 
+#include "matchimageprovider.h"
+
 
 void SprinterPlugin::registerTypes(const char *uri)
 {
@@ -35,6 +37,16 @@ void SprinterPlugin::registerTypes(const char *uri)
     qmlRegisterType<Sprinter::QuerySession>(uri, 0, 1, "QuerySession");
 }
 
+void SprinterPlugin::initializeEngine(QQmlEngine *engine, const char *uri)
+{
+    Q_UNUSED(uri)
+
+    // image providers are per-engine, so this can not be done in registerTypes
+    if (!engine->imageProvider(QStringLiteral("sprinter"))) {
+        engine->addImageProvider(QStringLiteral("sprinter"), new MatchImageProvider);
+    }
+}
+
 
 #include "sprinterplugin.moc"
 
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "batchquery.h"
+#include "batchquery_p.h"
+
+#include <QThread>
+
+#include "headlesssession.h"
+
+namespace Sprinter
+{
+
+BatchQuery::Private::Private()
+    : timeout(10000)
+{
+}
+
+void BatchQuery::Private::pageArrived(int worker, const QString &query,
+                                      const QVector<QueryMatch> &matches, bool complete)
+{
+    QMutexLocker locker(&lock);
+    Worker &w = workers[worker];
+    // pages of a query that timed out may still be on their way
+    if (w.index < 0 || w.done || w.query != query) {
+        return;
+    }
+
+    w.matches = matches;
+    if (complete) {
+        w.done = true;
+        changed.wakeAll();
+    }
+}
+
+BatchQuery::BatchQuery(const QStringList &runnerIds, int maxInFlight)
+    : d(new Private)
+{
+    if (maxInFlight < 1) {
+        maxInFlight = qMax(1, QThread::idealThreadCount());
+    }
+
+    d->workers.resize(maxInFlight);
+    for (int i = 0; i < maxInFlight; ++i) {
+        HeadlessSession *session = new HeadlessSession(runnerIds);
+        Private *p = d;
+        session->setCallback([p, i](const HeadlessSession::Page &page) {
+            p->pageArrived(i, page.query, page.matches, page.complete);
+        });
+        d->workers[i].session = session;
+    }
+}
+
+BatchQuery::~BatchQuery()
+{
+    for (auto const &worker: d->workers) {
+        delete worker.session;
+    }
+
+    delete d;
+}
+
+int BatchQuery::maxInFlight() const
+{
+    return d->workers.size();
+}
+
+void BatchQuery::setTimeout(int msecs)
+{
+    QMutexLocker locker(&d->lock);
+    d->timeout = msecs;
+}
+
+int BatchQuery::timeout() const
+{
+    QMutexLocker locker(&d->lock);
+    return d->timeout;
+}
+
+bool BatchQuery::waitForRunners(int timeout)
+{
+    QElapsedTimer clock;
+    clock.start();
+
+    bool loaded = true;
+    for (auto const &worker: d->workers) {
+        const int remaining = timeout < 0 ? -1 : qMax(0, int(timeout - clock.elapsed()));
+        loaded = worker.session->waitForRunners(remaining) && loaded;
+    }
+
+    return loaded;
+}
+
+void BatchQuery::run(const QStringList &queries, const Callback &callback)
+{
+    int next = 0;
+    int finished = 0;
+
+    QMutexLocker locker(&d->lock);
+    while (finished < queries.size()) {
+        // hand out queries to the idle sessions
+        for (int i = 0; i < d->workers.size() && next < queries.size(); ++i) {
+            Private::Worker &w = d->workers[i];
+            if (w.index >= 0) {
+                continue;
+            }
+
+            w.index = next;
+            w.query = queries.at(next);
+            w.matches.clear();
+            w.done = false;
+            w.clock.start();
+            ++next;
+
+            HeadlessSession *session = w.session;
+            const QString query = w.query;
+            locker.unlock();
+            session->setQuery(query);
+            locker.relock();
+        }
+
+        // collect the ones that are done or out of time
+        qint64 wait = -1;
+        for (int i = 0; i < d->workers.size(); ++i) {
+            Private::Worker &w = d->workers[i];
+            if (w.index < 0) {
+                continue;
+            }
+
+            const qint64 elapsed = w.clock.elapsed();
+            if (!w.done && (d->timeout < 0 || elapsed < d->timeout)) {
+                if (d->timeout >= 0) {
+                    const qint64 remaining = d->timeout - elapsed;
+                    wait = wait < 0 ? remaining : qMin(wait, remaining);
+                }
+                continue;
+            }
+
+            Result result;
+            result.index = w.index;
+            result.query = w.query;
+            result.matches = w.matches;
+            result.msecs = int(elapsed);
+            result.complete = w.done;
+            w.index = -1;
+            w.matches.clear();
+            ++finished;
+            wait = 0;
+
+            locker.unlock();
+            callback(result);
+            locker.relock();
+        }
+
+        if (wait < 0) {
+            d->changed.wait(&d->lock);
+        } else if (wait > 0) {
+            d->changed.wait(&d->lock, wait);
+        }
+    }
+}
+
+} // namespace
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPRINTER_BATCHQUERY
+#define SPRINTER_BATCHQUERY
+
+#include <sprinter/sprinter_export.h>
+#include <sprinter/querymatch.h>
+
+#include <QStringList>
+#include <QVector>
+
+#include <functional>
+
+namespace Sprinter
+{
+
+/**
+ * @class BatchQuery
+ * Pushes many queries through the runners for offline jobs, such as
+ * building suggestion caches or evaluating ranking.
+ *
+ * Queries run concurrently, each with its own QueryContext, in a fixed
+ * number of HeadlessSessions; that number bounds how many are in flight
+ * at once. Results are handed out as each query completes, in whatever
+ * order that happens.
+ *
+ * A BatchQuery may be created and run from any thread, but run must not
+ * be called from more than one thread at a time.
+ */
+class SPRINTER_EXPORT BatchQuery
+{
+public:
+    struct Result
+    {
+        Result()
+            : index(-1),
+              msecs(0),
+              complete(false)
+        {
+        }
+
+        // the position of the query in the list given to run
+        int index;
+        QString query;
+        QVector<QueryMatch> matches;
+        // how long the query took
+        int msecs;
+        // false if the query timed out; matches holds what was found
+        bool complete;
+    };
+
+    typedef std::function<void (const Result &result)> Callback;
+
+    /**
+     * @param runnerIds the runners to use; all available runners if empty
+     * @param maxInFlight how many queries may run at once; defaults to
+     *        the number of CPU cores
+     */
+    explicit BatchQuery(const QStringList &runnerIds = QStringList(), int maxInFlight = 0);
+    ~BatchQuery();
+
+    int maxInFlight() const;
+
+    /**
+     * Sets how long each query may take before it is given up on
+     * @param msecs in milliseconds; -1 for no limit. The default is 10s.
+     */
+    void setTimeout(int msecs);
+    int timeout() const;
+
+    /**
+     * Blocks until the runners are loaded
+     * @param timeout in milliseconds; -1 to wait as long as it takes
+     * @return true if all runners were loaded
+     */
+    bool waitForRunners(int timeout = -1);
+
+    /**
+     * Runs all the queries and blocks until they have completed or timed
+     * out. The callback is called once for each query as it finishes,
+     * from the calling thread.
+     */
+    void run(const QStringList &queries, const Callback &callback);
+
+private:
+    class Private;
+    Private * const d;
+};
+
+} // namespace
+
+#endif
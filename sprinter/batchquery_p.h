@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPRINTER_BATCHQUERY_P_H
+#define SPRINTER_BATCHQUERY_P_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include "batchquery.h"
+
+namespace Sprinter
+{
+
+class HeadlessSession;
+
+class BatchQuery::Private
+{
+public:
+    // one session and the query it is working on, if any
+    struct Worker
+    {
+        Worker()
+            : session(0),
+              index(-1),
+              done(false)
+        {
+        }
+
+        HeadlessSession *session;
+        // into the queries being run; -1 while idle
+        int index;
+        QString query;
+        QVector<QueryMatch> matches;
+        QElapsedTimer clock;
+        bool done;
+    };
+
+    Private();
+
+    // called from the sessions' threads
+    void pageArrived(int worker, const QString &query, const QVector<QueryMatch> &matches, bool complete);
+
+    // guards the workers' query state, which the sessions report into
+    QMutex lock;
+    QWaitCondition changed;
+    QVector<Worker> workers;
+    int timeout;
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,464 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "daemonclient_p.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QLocalSocket>
+#include <QThread>
+
+#include "daemonprotocol_p.h"
+#include "querycontext.h"
+
+namespace Sprinter
+{
+
+// how long to wait for the daemon to answer when connecting; it loads
+// its runners before it listens, so it answers right away if it is there
+static const int s_connectTimeout = 2000;
+
+static QMutex s_instanceLock;
+static DaemonClient *s_instance = 0;
+static bool s_disabled = false;
+
+// waits on the condition with lock held, for what is left of timeout;
+// returns false once that has run out
+static bool waitFor(QWaitCondition &condition, QMutex &lock, const QElapsedTimer &clock, int timeout)
+{
+    if (timeout < 0) {
+        condition.wait(&lock);
+        return true;
+    }
+
+    const qint64 remaining = timeout - clock.elapsed();
+    return remaining > 0 && condition.wait(&lock, remaining);
+}
+
+DaemonClient *DaemonClient::instance()
+{
+    QMutexLocker lock(&s_instanceLock);
+    if (s_disabled || qgetenv("SPRINTER_DAEMON").isEmpty()) {
+        return 0;
+    }
+
+    // deleted by the RunnerHost, once no runner can be using it anymore
+    if (!s_instance) {
+        const QString path = DaemonProtocol::socketPath();
+        if (path.isEmpty()) {
+            qWarning() << "Not using sprinterd, as there is no private runtime directory for its socket";
+            s_disabled = true;
+            return 0;
+        }
+
+        s_instance = new DaemonClient(path);
+    }
+
+    return s_instance;
+}
+
+void DaemonClient::disable()
+{
+    QMutexLocker lock(&s_instanceLock);
+    s_disabled = true;
+}
+
+void DaemonClient::cleanup()
+{
+    QMutexLocker lock(&s_instanceLock);
+    // the next host connects again
+    delete s_instance;
+    s_instance = 0;
+}
+
+DaemonClient::DaemonClient(const QString &socketPath)
+    : QObject(0),
+      m_socketPath(socketPath),
+      m_thread(new QThread),
+      m_socket(new QLocalSocket(this)),
+      m_connected(false),
+      m_lastChannel(0),
+      m_lastRequest(0)
+{
+    connect(m_socket, SIGNAL(readyRead()), this, SLOT(readMessages()));
+    connect(m_socket, SIGNAL(disconnected()), this, SLOT(disconnected()));
+
+    m_thread->setObjectName(QStringLiteral("Sprinter daemon client"));
+    moveToThread(m_thread);
+    m_thread->start();
+}
+
+DaemonClient::~DaemonClient()
+{
+    m_thread->quit();
+    m_thread->wait();
+    m_socket->abort();
+    delete m_thread;
+}
+
+bool DaemonClient::runnerMetaData(QVector<RunnerMetaData> &metaData)
+{
+    if (!ensureConnected()) {
+        return false;
+    }
+
+    QMutexLocker lock(&m_lock);
+    metaData = m_metaData;
+    return true;
+}
+
+quint32 DaemonClient::open(const QString &runnerId)
+{
+    if (!ensureConnected()) {
+        return 0;
+    }
+
+    quint32 channel;
+    {
+        QMutexLocker lock(&m_lock);
+        channel = ++m_lastChannel;
+        m_channels.insert(channel, Channel());
+    }
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << (quint8)DaemonProtocol::Open << channel << runnerId;
+    post(payload);
+    return channel;
+}
+
+void DaemonClient::close(quint32 channel)
+{
+    {
+        QMutexLocker lock(&m_lock);
+        if (!m_channels.remove(channel)) {
+            return;
+        }
+
+        m_changed.wakeAll();
+    }
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << (quint8)DaemonProtocol::Close << channel;
+    post(payload);
+}
+
+quint32 DaemonClient::query(quint32 channel, const QueryContext &context)
+{
+    quint32 request;
+    {
+        QMutexLocker lock(&m_lock);
+        QHash<quint32, Channel>::iterator it = m_channels.find(channel);
+        if (it == m_channels.end()) {
+            return 0;
+        }
+
+        request = ++m_lastRequest;
+        it->request = request;
+        it->page = Page();
+        it->fresh = false;
+    }
+
+    const DaemonProtocol::QueryKind kind = context.fetchMore() ? DaemonProtocol::MoreMatches :
+                                           context.isDefaultMatchesRequest() ? DaemonProtocol::DefaultMatches :
+                                                                               DaemonProtocol::NewQuery;
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << (quint8)DaemonProtocol::Query << channel << request << (quint8)kind
+           << context.query() << context.imageSize();
+    post(payload);
+    return request;
+}
+
+DaemonClient::WaitResult DaemonClient::nextPage(quint32 channel, quint32 request, Page &page, int timeout)
+{
+    QElapsedTimer clock;
+    clock.start();
+
+    QMutexLocker lock(&m_lock);
+    forever {
+        QHash<quint32, Channel>::iterator it = m_channels.find(channel);
+        if (it == m_channels.end() || it->request != request) {
+            return Lost;
+        }
+
+        if (it->fresh) {
+            it->fresh = false;
+            page = it->page;
+            return GotPage;
+        }
+
+        if (!waitFor(m_changed, m_lock, clock, timeout)) {
+            return TimedOut;
+        }
+    }
+}
+
+bool DaemonClient::exec(quint32 channel, quint64 matchId, int timeout)
+{
+    quint32 request;
+    {
+        QMutexLocker lock(&m_lock);
+        if (!m_connected || !m_channels.contains(channel)) {
+            return false;
+        }
+
+        request = ++m_lastRequest;
+        m_execs.insert(request, -1);
+    }
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << (quint8)DaemonProtocol::Exec << channel << request << matchId;
+    post(payload);
+
+    QElapsedTimer clock;
+    clock.start();
+
+    QMutexLocker lock(&m_lock);
+    while (m_execs.value(request) < 0) {
+        if (!waitFor(m_changed, m_lock, clock, timeout)) {
+            break;
+        }
+    }
+
+    return m_execs.take(request) > 0;
+}
+
+void DaemonClient::reset()
+{
+    if (QThread::currentThread() == m_thread) {
+        dropConnection();
+    } else {
+        QMetaObject::invokeMethod(this, "dropConnection", Qt::BlockingQueuedConnection);
+    }
+}
+
+bool DaemonClient::ensureConnected()
+{
+    {
+        QMutexLocker lock(&m_lock);
+        if (m_connected) {
+            return true;
+        }
+    }
+
+    if (QThread::currentThread() == m_thread) {
+        connectToDaemon();
+    } else {
+        QMetaObject::invokeMethod(this, "connectToDaemon", Qt::BlockingQueuedConnection);
+    }
+
+    QMutexLocker lock(&m_lock);
+    return m_connected;
+}
+
+void DaemonClient::post(const QByteArray &payload)
+{
+    QMetaObject::invokeMethod(this, "send", Q_ARG(QByteArray, payload));
+}
+
+void DaemonClient::connectToDaemon()
+{
+    if (m_socket->state() == QLocalSocket::ConnectedState) {
+        return;
+    }
+
+    // the runners come before anything else; readMessages must not see them
+    m_socket->blockSignals(true);
+    m_socket->abort();
+    m_socket->connectToServer(m_socketPath);
+    if (!m_socket->waitForConnected(s_connectTimeout)) {
+        qWarning() << "Could not reach sprinterd at" << m_socketPath << ":" << m_socket->errorString();
+        m_socket->abort();
+        m_socket->blockSignals(false);
+        return;
+    }
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << (quint8)DaemonProtocol::Hello << (quint32)DaemonProtocol::Version;
+    DaemonProtocol::writeFrame(m_socket, payload);
+
+    QElapsedTimer clock;
+    clock.start();
+    QByteArray reply;
+    while (!DaemonProtocol::readFrame(m_socket, reply)) {
+        const int remaining = s_connectTimeout - clock.elapsed();
+        if (remaining <= 0 || !m_socket->waitForReadyRead(remaining)) {
+            qWarning() << "sprinterd did not answer";
+            m_socket->abort();
+            m_socket->blockSignals(false);
+            return;
+        }
+    }
+
+    QDataStream replyStream(reply);
+    replyStream.setVersion(QDataStream::Qt_5_0);
+    quint8 message = 0;
+    quint32 version = 0;
+    replyStream >> message >> version;
+    if (message != DaemonProtocol::Runners || version != DaemonProtocol::Version) {
+        qWarning() << "sprinterd speaks protocol version" << version << "rather than" << DaemonProtocol::Version;
+        m_socket->abort();
+        m_socket->blockSignals(false);
+        return;
+    }
+
+    const QVector<RunnerMetaData> metaData = DaemonProtocol::readMetaData(replyStream);
+    m_socket->blockSignals(false);
+
+    {
+        QMutexLocker lock(&m_lock);
+        m_metaData = metaData;
+        m_connected = true;
+    }
+
+    // whatever else came in along with the runners
+    readMessages();
+}
+
+void DaemonClient::send(const QByteArray &payload)
+{
+    if (m_socket->state() == QLocalSocket::ConnectedState) {
+        DaemonProtocol::writeFrame(m_socket, payload);
+    }
+}
+
+void DaemonClient::readMessages()
+{
+    QByteArray payload;
+    while (DaemonProtocol::readFrame(m_socket, payload)) {
+        handleMessage(payload);
+    }
+}
+
+void DaemonClient::disconnected()
+{
+    qWarning() << "Lost the connection to sprinterd at" << m_socketPath;
+
+    QMutexLocker lock(&m_lock);
+    connectionLost();
+}
+
+void DaemonClient::dropConnection()
+{
+    m_socket->blockSignals(true);
+    m_socket->abort();
+    m_socket->blockSignals(false);
+
+    QMutexLocker lock(&m_lock);
+    connectionLost();
+}
+
+void DaemonClient::connectionLost()
+{
+    // channels opened from now on connect again
+    m_connected = false;
+    m_channels.clear();
+    for (QHash<quint32, int>::iterator it = m_execs.begin(); it != m_execs.end(); ++it) {
+        it.value() = 0;
+    }
+    m_changed.wakeAll();
+}
+
+void DaemonClient::handleMessage(const QByteArray &payload)
+{
+    QDataStream stream(payload);
+    stream.setVersion(QDataStream::Qt_5_0);
+    quint8 message = 0;
+    stream >> message;
+
+    switch (message) {
+        case DaemonProtocol::Page:
+            pageArrived(stream);
+            break;
+
+        case DaemonProtocol::ExecResult: {
+            quint32 request = 0;
+            bool success = false;
+            stream >> request >> success;
+            QMutexLocker lock(&m_lock);
+            if (m_execs.contains(request)) {
+                m_execs.insert(request, success ? 1 : 0);
+                m_changed.wakeAll();
+            }
+            break;
+        }
+
+        default:
+            qWarning() << "Unexpected message from sprinterd:" << message;
+            break;
+    }
+}
+
+void DaemonClient::pageArrived(QDataStream &stream)
+{
+    quint32 channel = 0;
+    quint32 request = 0;
+    Page page;
+    QByteArray inlined;
+    stream >> channel >> request >> page.serial >> page.complete >> inlined;
+
+    if (!inlined.isEmpty()) {
+        page.matches = DaemonProtocol::readMatches(inlined.constData(), inlined.size());
+    } else {
+        QString path;
+        qint64 size = 0;
+        stream >> path >> size;
+
+        QFile file(path);
+        uchar *data = file.open(QIODevice::ReadOnly) ? file.map(0, size) : 0;
+        if (data) {
+            page.matches = DaemonProtocol::readMatches(reinterpret_cast<const char *>(data), size);
+            file.unmap(data);
+        } else {
+            qWarning() << "Could not map the page of matches at" << path;
+        }
+    }
+
+    // the matches are copied out, so the daemon may write the next page
+    QByteArray payload;
+    QDataStream ack(&payload, QIODevice::WriteOnly);
+    ack.setVersion(QDataStream::Qt_5_0);
+    ack << (quint8)DaemonProtocol::PageRead << channel << page.serial;
+    send(payload);
+
+    QMutexLocker lock(&m_lock);
+    QHash<quint32, Channel>::iterator it = m_channels.find(channel);
+    if (it != m_channels.end() && it->request == request) {
+        it->page = page;
+        it->fresh = true;
+        m_changed.wakeAll();
+    }
+}
+
+} // namespace
+
+#include "moc_daemonclient_p.cpp"
@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPRINTER_DAEMONCLIENT_P_H
+#define SPRINTER_DAEMONCLIENT_P_H
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "querymatch.h"
+#include "runnermetadata_p.h"
+
+class QDataStream;
+class QLocalSocket;
+class QThread;
+
+namespace Sprinter
+{
+
+class QueryContext;
+
+/**
+ * @class DaemonClient
+ * The connection of this process to sprinterd, used when the
+ * SPRINTER_DAEMON environment variable is set. The RunnerHost then takes
+ * the runner metadata from the daemon instead of scanning for plugins,
+ * and stands a RemoteRunner in for each runner; each RemoteSessionData
+ * is a channel here, with the daemon running the runner for it. Each
+ * RunnerSandbox has a client of its own, connected to its sandbox.
+ *
+ * The socket lives in a thread of its own. All methods are thread safe;
+ * those which wait do so for the daemon to answer.
+ */
+class DaemonClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Page
+    {
+        Page()
+            : serial(0),
+              complete(false)
+        {
+        }
+
+        // all of the runner's matches for the request so far
+        QVector<QueryMatch> matches;
+        quint32 serial;
+        bool complete;
+    };
+
+    enum WaitResult {
+        GotPage,
+        TimedOut,
+        // the channel was closed, the request replaced or the daemon went away
+        Lost
+    };
+
+    /**
+     * A client for the daemon listening at socketPath; it connects
+     * once first used
+     */
+    explicit DaemonClient(const QString &socketPath);
+    ~DaemonClient();
+
+    /**
+     * @return the client, or 0 if this process is not to use the daemon
+     */
+    static DaemonClient *instance();
+
+    /**
+     * Keeps this process from using the daemon; called by sprinterd itself
+     */
+    static void disable();
+
+    /**
+     * Deletes the client; called by the RunnerHost once no runner can
+     * be using it anymore
+     */
+    static void cleanup();
+
+    /**
+     * Connects to the daemon if not connected yet, and copies the metadata
+     * of the runners it hosts into metaData
+     * @return false if the daemon could not be reached
+     */
+    bool runnerMetaData(QVector<RunnerMetaData> &metaData);
+
+    /**
+     * Opens a channel for a session of the runner, reconnecting to the
+     * daemon if needed
+     * @return the channel, or 0 if the daemon could not be reached
+     */
+    quint32 open(const QString &runnerId);
+    void close(quint32 channel);
+
+    /**
+     * Asks the daemon to match the context, replacing the channel's
+     * current request
+     * @return the request, to wait for pages of with nextPage
+     */
+    quint32 query(quint32 channel, const QueryContext &context);
+
+    /**
+     * Waits for a page of the request newer than the last one returned
+     */
+    WaitResult nextPage(quint32 channel, quint32 request, Page &page, int timeout);
+
+    /**
+     * Has the daemon execute a match of the channel and waits for the outcome
+     * @return true if the match was executed successfully
+     */
+    bool exec(quint32 channel, quint64 matchId, int timeout);
+
+    /**
+     * Drops the connection, as if the daemon had gone away; the next
+     * channel opened connects again
+     */
+    void reset();
+
+private Q_SLOTS:
+    void connectToDaemon();
+    void send(const QByteArray &payload);
+    void readMessages();
+    void disconnected();
+    void dropConnection();
+
+private:
+    struct Channel
+    {
+        Channel()
+            : request(0),
+              fresh(false)
+        {
+        }
+
+        quint32 request;
+        Page page;
+        // the page has not been returned by nextPage yet
+        bool fresh;
+    };
+
+    bool ensureConnected();
+    // fails everything waiting on the connection; with m_lock held
+    void connectionLost();
+    void post(const QByteArray &payload);
+    // in the client thread
+    void handleMessage(const QByteArray &payload);
+    void pageArrived(QDataStream &stream);
+
+    const QString m_socketPath;
+    QThread *m_thread;
+    QLocalSocket *m_socket;
+
+    // guards everything below
+    QMutex m_lock;
+    QWaitCondition m_changed;
+    bool m_connected;
+    QVector<RunnerMetaData> m_metaData;
+    QHash<quint32, Channel> m_channels;
+    // exec requests waiting for the daemon: -1 until answered, then 0 or 1
+    QHash<quint32, int> m_execs;
+    quint32 m_lastChannel;
+    quint32 m_lastRequest;
+};
+
+} // namespace
+
+#endif
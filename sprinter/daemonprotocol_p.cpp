@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "daemonprotocol_p.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QIODevice>
+#include <QImage>
+#include <QMetaType>
+#include <QStandardPaths>
+#include <QtEndian>
+
+#include <string.h>
+
+#include "querymatch_p.h"
+
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Sprinter
+{
+
+QString DaemonProtocol::runtimeDirectory()
+{
+    // empty when Qt found the directory to be unsafe, e.g. owned by
+    // someone else or readable by others
+    return QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+}
+
+QString DaemonProtocol::socketPath()
+{
+    const QString path = QString::fromLocal8Bit(qgetenv("SPRINTER_DAEMON"));
+    if (path.contains(QLatin1Char('/'))) {
+        return path;
+    }
+
+    // there is no shared fallback: anyone could put a socket there first,
+    // or read the pages of matches
+    const QString dir = runtimeDirectory();
+    return dir.isEmpty() ? QString() : dir + QStringLiteral("/sprinterd");
+}
+
+QString DaemonProtocol::pageDirectory(const QString &socketPath)
+{
+    return socketPath + QStringLiteral("-pages");
+}
+
+bool DaemonProtocol::makePrivateDirectory(const QString &path, QString &error)
+{
+#ifdef Q_OS_UNIX
+    const QByteArray nativePath = QFile::encodeName(path);
+    if (::mkdir(nativePath.constData(), 0700) != 0 && errno != EEXIST) {
+        error = QStringLiteral("Could not create %1: %2").arg(path).arg(QString::fromLocal8Bit(strerror(errno)));
+        return false;
+    }
+
+    // it may have been there already, made by someone else
+    struct stat info;
+    if (::lstat(nativePath.constData(), &info) != 0 ||
+        !S_ISDIR(info.st_mode) || info.st_uid != ::geteuid()) {
+        error = QStringLiteral("%1 is not a directory of our own").arg(path);
+        return false;
+    }
+
+    if ((info.st_mode & 0077) && ::chmod(nativePath.constData(), 0700) != 0) {
+        error = QStringLiteral("Could not make %1 private: %2").arg(path).arg(QString::fromLocal8Bit(strerror(errno)));
+        return false;
+    }
+
+    return true;
+#else
+    if (!QDir().mkpath(path)) {
+        error = QStringLiteral("Could not create %1").arg(path);
+        return false;
+    }
+
+    return true;
+#endif
+}
+
+void DaemonProtocol::writeFrame(QIODevice *device, const QByteArray &payload)
+{
+    uchar length[sizeof(quint32)];
+    qToBigEndian<quint32>(payload.size(), length);
+    device->write(reinterpret_cast<const char *>(length), sizeof(length));
+    device->write(payload);
+}
+
+bool DaemonProtocol::readFrame(QIODevice *device, QByteArray &payload)
+{
+    if (device->bytesAvailable() < (qint64)sizeof(quint32)) {
+        return false;
+    }
+
+    const QByteArray header = device->peek(sizeof(quint32));
+    const quint32 length = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(header.constData()));
+    if (device->bytesAvailable() < (qint64)(sizeof(quint32) + length)) {
+        return false;
+    }
+
+    device->read(sizeof(quint32));
+    payload = device->read(length);
+    return true;
+}
+
+// data() is written as its type name and the bytes of the value, so the
+// type need not have the same id on both sides
+static void writeData(QDataStream &stream, const QVariant &data)
+{
+    QByteArray bytes;
+    if (data.isValid()) {
+        QDataStream dataStream(&bytes, QIODevice::WriteOnly);
+        dataStream.setVersion(QDataStream::Qt_5_0);
+        if (!QMetaType::save(dataStream, data.userType(), data.constData())) {
+            // no stream operators for it
+            bytes.clear();
+        }
+    }
+
+    stream << (bytes.isEmpty() ? QByteArray() : QByteArray(data.typeName())) << bytes;
+}
+
+static QVariant readData(QDataStream &stream)
+{
+    QByteArray typeName;
+    QByteArray bytes;
+    stream >> typeName >> bytes;
+
+    const int type = typeName.isEmpty() ? (int)QMetaType::UnknownType : QMetaType::type(typeName.constData());
+    if (type == QMetaType::UnknownType) {
+        return QVariant();
+    }
+
+    QVariant data(type, (const void *)0);
+    QDataStream dataStream(bytes);
+    dataStream.setVersion(QDataStream::Qt_5_0);
+    if (!QMetaType::load(dataStream, type, data.data())) {
+        return QVariant();
+    }
+
+    return data;
+}
+
+QByteArray DaemonProtocol::writeMatches(const QVector<QueryMatch> &matches)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    stream << (quint32)matches.size();
+    for (auto const &match: matches) {
+        stream << match.id() << match.key() << match.title() << match.text()
+               << (quint8)match.type() << (quint8)match.source() << (quint16)match.precision()
+               << match.userData();
+        writeData(stream, match.data());
+
+        // the pixels as they are, rather than PNG encoded as QDataStream
+        // would have it; the page is on the other side in a moment anyways
+        const QImage image = match.image();
+        stream << (bool)!image.isNull();
+        if (!image.isNull()) {
+            stream << (qint32)image.width() << (qint32)image.height()
+                   << (qint32)image.format() << (qint32)image.bytesPerLine();
+            stream.writeRawData(reinterpret_cast<const char *>(image.constBits()),
+                                image.bytesPerLine() * image.height());
+        }
+    }
+
+    return data;
+}
+
+QVector<QueryMatch> DaemonProtocol::readMatches(const char *data, qint64 size)
+{
+    const QByteArray bytes = QByteArray::fromRawData(data, size);
+    QDataStream stream(bytes);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 count = 0;
+    stream >> count;
+
+    QVector<QueryMatch> matches;
+    matches.reserve(qMin<quint32>(count, size / 16));
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        quint64 id;
+        QString key;
+        QString title;
+        QString text;
+        quint8 type;
+        quint8 source;
+        quint16 precision;
+        QVariant userData;
+        bool hasImage;
+        stream >> id >> key >> title >> text >> type >> source >> precision >> userData;
+        const QVariant data = readData(stream);
+        stream >> hasImage;
+
+        QueryMatch match;
+        match.d->remoteId = id;
+        match.setKey(key);
+        match.setData(data);
+        match.setTitle(title);
+        match.setText(text);
+        match.setType((QuerySession::MatchType)type);
+        match.setSource((QuerySession::MatchSource)source);
+        match.setPrecision((QuerySession::MatchPrecision)precision);
+        match.setUserData(userData);
+
+        if (hasImage) {
+            qint32 width;
+            qint32 height;
+            qint32 format;
+            qint32 bytesPerLine;
+            stream >> width >> height >> format >> bytesPerLine;
+            if (width <= 0 || height <= 0 || bytesPerLine <= 0 ||
+                format <= QImage::Format_Invalid || format >= QImage::NImageFormats) {
+                break;
+            }
+
+            QImage image(width, height, (QImage::Format)format);
+            const int copied = qMin(bytesPerLine, image.bytesPerLine());
+            QByteArray line(bytesPerLine, Qt::Uninitialized);
+            for (int y = 0; y < height; ++y) {
+                if (stream.readRawData(line.data(), bytesPerLine) != bytesPerLine) {
+                    break;
+                }
+                memcpy(image.scanLine(y), line.constData(), copied);
+            }
+            match.setImage(image);
+        }
+
+        if (stream.status() != QDataStream::Ok) {
+            break;
+        }
+
+        matches << match;
+    }
+
+    return matches;
+}
+
+void DaemonProtocol::writeMetaData(QDataStream &stream, const QVector<RunnerMetaData> &metaData)
+{
+    stream << (quint32)metaData.size();
+    for (auto const &md: metaData) {
+        stream << md.id << md.name << md.description << md.license << md.author
+               << md.contactEmail << md.contactWebsite << md.version << md.icon
+               << md.generatesDefaultMatches;
+
+        stream << (quint32)md.sourcesUsed.size();
+        for (auto const &source: md.sourcesUsed) {
+            stream << (quint8)source;
+        }
+
+        stream << (quint32)md.matchTypesGenerated.size();
+        for (auto const &type: md.matchTypesGenerated) {
+            stream << (quint8)type;
+        }
+    }
+}
+
+QVector<RunnerMetaData> DaemonProtocol::readMetaData(QDataStream &stream)
+{
+    QVector<RunnerMetaData> metaData;
+
+    quint32 count = 0;
+    stream >> count;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        RunnerMetaData md;
+        md.remote = true;
+        stream >> md.id >> md.name >> md.description >> md.license >> md.author
+               >> md.contactEmail >> md.contactWebsite >> md.version >> md.icon
+               >> md.generatesDefaultMatches;
+
+        quint32 values = 0;
+        stream >> values;
+        for (quint32 j = 0; j < values && stream.status() == QDataStream::Ok; ++j) {
+            quint8 source;
+            stream >> source;
+            md.sourcesUsed << (QuerySession::MatchSource)source;
+        }
+
+        stream >> values;
+        for (quint32 j = 0; j < values && stream.status() == QDataStream::Ok; ++j) {
+            quint8 type;
+            stream >> type;
+            md.matchTypesGenerated << (QuerySession::MatchType)type;
+        }
+
+        if (stream.status() == QDataStream::Ok) {
+            metaData << md;
+        }
+    }
+
+    return metaData;
+}
+
+} // namespace
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPRINTER_DAEMONPROTOCOL_P_H
+#define SPRINTER_DAEMONPROTOCOL_P_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include "querymatch.h"
+#include "runnermetadata_p.h"
+
+class QDataStream;
+class QIODevice;
+
+namespace Sprinter
+{
+
+/**
+ * @class DaemonProtocol
+ * What sprinterd and its clients say to each other over the local socket.
+ *
+ * Each message is a frame: a quint32 length followed by that many bytes
+ * of QDataStream, starting with the quint8 Message. A client opens one
+ * channel per RunnerSessionData it proxies; the daemon runs that runner
+ * for it in the one session it has for the runner, see DaemonRunner.
+ *
+ * Pages of matches up to InlinePageSize are sent in the Page message.
+ * Larger ones are written to a file in the runtime directory, usually a
+ * tmpfs, which the client maps; the daemon writes the next page of a
+ * channel only once the client has sent PageRead for the last one, and
+ * pages that come in meanwhile replace each other.
+ */
+class DaemonProtocol
+{
+public:
+    enum {
+        Version = 2,
+        InlinePageSize = 16 * 1024
+    };
+
+    enum Message {
+        // client to daemon
+        Hello,          // quint32 version
+        Open,           // quint32 channel, QString runnerId
+        Close,          // quint32 channel
+        Query,          // quint32 channel, quint32 request, quint8 QueryKind, QString query, QSize imageSize
+        PageRead,       // quint32 channel, quint32 serial
+        Exec,           // quint32 channel, quint32 request, quint64 matchId
+        // daemon to client
+        Runners,        // quint32 version, metadata (see writeMetaData)
+        Page,           // quint32 channel, quint32 request, quint32 serial, bool complete,
+                        // QByteArray matches, or if that is empty: QString file, qint64 size
+        ExecResult      // quint32 request, bool success
+    };
+
+    enum QueryKind {
+        NewQuery,
+        MoreMatches,
+        DefaultMatches
+    };
+
+    /**
+     * @return the user's runtime directory, or an empty string if there
+     * is none that is safe to use; the daemon is not used then
+     */
+    static QString runtimeDirectory();
+
+    /**
+     * @return the path of the daemon's socket: the SPRINTER_DAEMON
+     * environment variable if it is a path, otherwise sprinterd in the
+     * user's runtime directory; empty if there is no safe runtime directory
+     */
+    static QString socketPath();
+
+    /**
+     * @return where the daemon listening at socketPath puts page files
+     */
+    static QString pageDirectory(const QString &socketPath);
+
+    /**
+     * Creates the directory readable by this user only, or makes sure
+     * that it is that if it exists already
+     * @return false if that was not possible, with error set to why
+     */
+    static bool makePrivateDirectory(const QString &path, QString &error);
+
+    static void writeFrame(QIODevice *device, const QByteArray &payload);
+
+    /**
+     * Takes the next whole frame off the device, if there is one
+     * @return false if the frame has not arrived in full yet
+     */
+    static bool readFrame(QIODevice *device, QByteArray &payload);
+
+    /**
+     * Matches travel with their id, which the client refers to them by
+     * when they are to be executed. Their data() goes along if QDataStream
+     * can carry it, which it can for the types Qt knows and any type
+     * registered along with its stream operators in both processes;
+     * anything else stays behind in the daemon.
+     */
+    static QByteArray writeMatches(const QVector<QueryMatch> &matches);
+    static QVector<QueryMatch> readMatches(const char *data, qint64 size);
+
+    static void writeMetaData(QDataStream &stream, const QVector<RunnerMetaData> &metaData);
+    static QVector<RunnerMetaData> readMetaData(QDataStream &stream);
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,635 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "daemonserver_p.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDebug>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSize>
+#include <QThreadPool>
+#include <QTimer>
+
+#include "daemonclient_p.h"
+#include "daemonprotocol_p.h"
+#include "headlesssession_p.h"
+#include "querysessionthread_p.h"
+#include "runnerhost_p.h"
+#include "runnersandbox_p.h"
+
+namespace Sprinter
+{
+
+DaemonServer::DaemonServer(QObject *parent)
+    : QObject(parent),
+      m_server(new QLocalServer(this)),
+      m_socketPath(DaemonProtocol::socketPath()),
+      m_resident(0),
+      m_lastConnection(0),
+      m_connections(0),
+      m_exitWhenUnused(false)
+{
+    // our own sessions run the runners here, not in another daemon
+    DaemonClient::disable();
+    RunnerSandbox::disable();
+    connect(m_server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+}
+
+DaemonServer::~DaemonServer()
+{
+    m_exitWhenUnused = false;
+    m_server->close();
+    // the connections leave the runners first
+    qDeleteAll(findChildren<DaemonConnection *>());
+    qDeleteAll(m_hosted);
+    delete m_resident;
+}
+
+void DaemonServer::setSocketPath(const QString &path)
+{
+    m_socketPath = path;
+}
+
+void DaemonServer::setRunners(const QStringList &runnerIds)
+{
+    m_runnerIds = runnerIds;
+}
+
+void DaemonServer::setExitWhenUnused(bool exit)
+{
+    m_exitWhenUnused = exit;
+}
+
+bool DaemonServer::start(int timeout)
+{
+    const QString &path = m_socketPath;
+    if (path.isEmpty()) {
+        m_error = QStringLiteral("There is no private runtime directory to put the socket in; is XDG_RUNTIME_DIR set?");
+        return false;
+    }
+
+    {
+        QLocalSocket probe;
+        probe.connectToServer(path);
+        if (probe.waitForConnected(500)) {
+            m_error = QStringLiteral("sprinterd is already running at %1").arg(path);
+            return false;
+        }
+    }
+
+    m_resident = new HeadlessSession(m_runnerIds);
+    if (!m_resident->waitForRunners(timeout)) {
+        if (m_exitWhenUnused) {
+            // a sandbox without its runner is of no use to anyone
+            m_error = QStringLiteral("The runner could not be loaded");
+            return false;
+        }
+
+        qWarning() << "Not all runners could be loaded";
+    }
+
+    QVector<RunnerMetaData> metaData;
+    RunnerHost::instance()->metaData(metaData);
+    for (auto const &md: metaData) {
+        if (m_runnerIds.isEmpty() || m_runnerIds.contains(md.id)) {
+            // the runner is loaded already, so this does not take long
+            DaemonRunner *runner = new DaemonRunner(md.id);
+            m_hosted.insert(md.id, runner);
+        }
+    }
+
+    QDataStream stream(&m_runners, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << (quint8)DaemonProtocol::Runners << (quint32)DaemonProtocol::Version;
+    DaemonProtocol::writeMetaData(stream, metaData);
+
+    // the pages hold the matches, which are no one else's business
+    if (!DaemonProtocol::makePrivateDirectory(DaemonProtocol::pageDirectory(path), m_error)) {
+        return false;
+    }
+
+    // whatever is there was left behind by a daemon that is gone
+    QLocalServer::removeServer(path);
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    if (!m_server->listen(path)) {
+        m_error = m_server->errorString();
+        return false;
+    }
+
+    if (m_exitWhenUnused) {
+        QTimer::singleShot(timeout, this, SLOT(checkUnused()));
+    }
+
+    return true;
+}
+
+QString DaemonServer::errorString() const
+{
+    return m_error;
+}
+
+void DaemonServer::newConnection()
+{
+    while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+        DaemonConnection *connection = new DaemonConnection(socket, ++m_lastConnection, m_runners, m_hosted,
+                                                            DaemonProtocol::pageDirectory(m_socketPath), this);
+        connect(connection, SIGNAL(destroyed()), this, SLOT(connectionClosed()));
+        ++m_connections;
+    }
+}
+
+void DaemonServer::connectionClosed()
+{
+    --m_connections;
+    checkUnused();
+}
+
+void DaemonServer::checkUnused()
+{
+    if (m_exitWhenUnused && m_connections < 1) {
+        QCoreApplication::quit();
+    }
+}
+
+bool DaemonRunner::Request::sameQuery(const Request &other) const
+{
+    return kind == other.kind && query == other.query && imageSize == other.imageSize;
+}
+
+bool DaemonRunner::Request::operator==(const Request &other) const
+{
+    return sameQuery(other) && more == other.more;
+}
+
+DaemonRunner::DaemonRunner(const QString &runnerId, QObject *parent)
+    : QObject(parent),
+      m_session(new HeadlessSession(QStringList() << runnerId)),
+      m_pagePending(false),
+      m_busy(false),
+      m_stateValid(false),
+      m_requestSerial(0),
+      m_morePending(0)
+{
+    m_session->waitForRunners();
+
+    // called in the session's thread; the page is handled in ours, where
+    // only the latest one matters
+    DaemonRunner *runner = this;
+    m_session->setCallback([runner](const HeadlessSession::Page &page) {
+        {
+            QMutexLocker lock(&runner->m_lock);
+            runner->m_page = page;
+            if (runner->m_pagePending) {
+                return;
+            }
+            runner->m_pagePending = true;
+        }
+
+        QMetaObject::invokeMethod(runner, "pageArrived", Qt::QueuedConnection);
+    });
+}
+
+DaemonRunner::~DaemonRunner()
+{
+    // no more pages are delivered once the session is gone
+    delete m_session;
+}
+
+void DaemonRunner::request(DaemonConnection *connection, quint32 channelId, quint32 request, const Request &wanted)
+{
+    unsubscribe(connection, channelId);
+
+    Subscriber subscriber;
+    subscriber.connection = connection;
+    subscriber.channelId = channelId;
+    subscriber.request = request;
+
+    if (m_busy && m_current.wanted == wanted) {
+        // pages are snapshots of all matches, so joining late misses nothing
+        m_current.subscribers << subscriber;
+        if (m_morePending == 0 && m_lastPage.serial > 0) {
+            deliver(subscriber, m_lastPage);
+        }
+    } else if (!m_busy && m_lastPage.complete && m_current.wanted == wanted) {
+        // asked again for what was matched last; as with a QuerySession,
+        // the same query again finds nothing new
+        deliver(subscriber, m_lastPage);
+    } else {
+        bool queued = false;
+        for (auto &job: m_queue) {
+            if (job.wanted == wanted) {
+                job.subscribers << subscriber;
+                queued = true;
+                break;
+            }
+        }
+
+        if (!queued) {
+            Job job;
+            job.wanted = wanted;
+            job.subscribers << subscriber;
+            m_queue << job;
+        }
+    }
+
+    settle();
+}
+
+void DaemonRunner::cancel(DaemonConnection *connection, quint32 channelId)
+{
+    unsubscribe(connection, channelId);
+    settle();
+}
+
+void DaemonRunner::unsubscribe(DaemonConnection *connection, quint32 channelId)
+{
+    auto drop = [connection, channelId](QList<Subscriber> &subscribers) {
+        for (int i = subscribers.size() - 1; i >= 0; --i) {
+            if (subscribers.at(i).connection == connection && subscribers.at(i).channelId == channelId) {
+                subscribers.removeAt(i);
+            }
+        }
+    };
+
+    drop(m_current.subscribers);
+    for (int i = m_queue.size() - 1; i >= 0; --i) {
+        drop(m_queue[i].subscribers);
+        if (m_queue.at(i).subscribers.isEmpty()) {
+            m_queue.removeAt(i);
+        }
+    }
+}
+
+void DaemonRunner::settle()
+{
+    // a request nobody waits for anymore only holds up the others
+    if (!m_busy || (m_current.subscribers.isEmpty() && !m_queue.isEmpty())) {
+        startNext();
+    }
+}
+
+void DaemonRunner::startNext()
+{
+    m_busy = false;
+    m_current.subscribers.clear();
+    if (m_queue.isEmpty()) {
+        return;
+    }
+
+    m_current = m_queue.takeFirst();
+    m_busy = true;
+    m_lastPage = HeadlessSession::Page();
+
+    const Request &wanted = m_current.wanted;
+    if (m_stateValid && m_state.sameQuery(wanted) && m_state.more < wanted.more) {
+        // the session is on the query already; it only needs to go further
+        m_morePending = wanted.more - m_state.more;
+        moreMatches();
+        return;
+    }
+
+    m_state = wanted;
+    m_state.more = 0;
+    m_stateValid = true;
+    m_morePending = wanted.more;
+
+    m_session->setImageSize(wanted.imageSize);
+    if (wanted.kind == DaemonProtocol::DefaultMatches) {
+        m_session->requestDefaultMatches();
+    } else {
+        m_session->setQuery(wanted.query);
+    }
+    requestMade();
+}
+
+void DaemonRunner::moreMatches()
+{
+    --m_morePending;
+    ++m_state.more;
+    m_session->requestMoreMatches();
+    requestMade();
+}
+
+void DaemonRunner::requestMade()
+{
+    // we are the only one making requests of the session, so this is ours
+    QMutexLocker lock(&m_session->d->lock);
+    m_requestSerial = m_session->d->requestSerial;
+}
+
+void DaemonRunner::pageArrived()
+{
+    HeadlessSession::Page page;
+    {
+        QMutexLocker lock(&m_lock);
+        page = m_page;
+        m_pagePending = false;
+    }
+
+    if (!m_busy || page.serial <= m_requestSerial) {
+        // for a request since replaced
+        return;
+    }
+
+    if (m_morePending > 0) {
+        // on the way to the matches wanted, which take more of them
+        if (page.complete) {
+            moreMatches();
+        }
+        return;
+    }
+
+    m_lastPage = page;
+    for (auto const &subscriber: m_current.subscribers) {
+        deliver(subscriber, page);
+    }
+
+    if (page.complete) {
+        startNext();
+    }
+}
+
+void DaemonRunner::deliver(const Subscriber &subscriber, const HeadlessSession::Page &page)
+{
+    subscriber.connection->deliver(subscriber.channelId, subscriber.request, page);
+}
+
+DaemonConnection::DaemonConnection(QLocalSocket *socket, int id, const QByteArray &runners,
+                                   const QHash<QString, DaemonRunner *> &hosted,
+                                   const QString &pageDirectory, QObject *parent)
+    : QObject(parent),
+      m_socket(socket),
+      m_id(id),
+      m_runners(runners),
+      m_hosted(hosted),
+      m_pageDirectory(pageDirectory)
+{
+    m_socket->setParent(this);
+    connect(m_socket, SIGNAL(readyRead()), this, SLOT(readMessages()));
+    connect(m_socket, SIGNAL(disconnected()), this, SLOT(deleteLater()));
+}
+
+DaemonConnection::~DaemonConnection()
+{
+    for (auto channelId: m_channels.keys()) {
+        close(channelId);
+    }
+}
+
+void DaemonConnection::readMessages()
+{
+    QByteArray payload;
+    while (DaemonProtocol::readFrame(m_socket, payload)) {
+        handleMessage(payload);
+    }
+}
+
+void DaemonConnection::handleMessage(const QByteArray &payload)
+{
+    QDataStream stream(payload);
+    stream.setVersion(QDataStream::Qt_5_0);
+    quint8 message = 0;
+    stream >> message;
+
+    quint32 channelId = 0;
+    switch (message) {
+        case DaemonProtocol::Hello:
+            // clients check the version in the reply
+            send(m_runners);
+            break;
+
+        case DaemonProtocol::Open: {
+            QString runnerId;
+            stream >> channelId >> runnerId;
+            open(channelId, runnerId);
+            break;
+        }
+
+        case DaemonProtocol::Close:
+            stream >> channelId;
+            close(channelId);
+            break;
+
+        case DaemonProtocol::Query:
+            query(stream);
+            break;
+
+        case DaemonProtocol::PageRead: {
+            quint32 serial = 0;
+            stream >> channelId >> serial;
+            Channel *channel = m_channels.value(channelId);
+            if (channel) {
+                channel->awaitingRead = false;
+                sendPage(channel);
+            }
+            break;
+        }
+
+        case DaemonProtocol::Exec: {
+            quint32 request = 0;
+            quint64 matchId = 0;
+            stream >> channelId >> request >> matchId;
+            exec(channelId, request, matchId);
+            break;
+        }
+
+        default:
+            qWarning() << "Unexpected message from client" << m_id << ":" << message;
+            break;
+    }
+}
+
+void DaemonConnection::open(quint32 channelId, const QString &runnerId)
+{
+    if (m_channels.contains(channelId)) {
+        return;
+    }
+
+    Channel *channel = new Channel;
+    channel->id = channelId;
+    channel->runner = m_hosted.value(runnerId);
+    channel->pageFile.setFileName(QStringLiteral("%1/%2-%3-%4").arg(m_pageDirectory)
+                                  .arg(QCoreApplication::applicationPid()).arg(m_id).arg(channelId));
+    m_channels.insert(channelId, channel);
+}
+
+void DaemonConnection::close(quint32 channelId)
+{
+    Channel *channel = m_channels.take(channelId);
+    if (!channel) {
+        return;
+    }
+
+    if (channel->runner) {
+        channel->runner->cancel(this, channelId);
+    }
+
+    if (channel->pageFile.exists()) {
+        channel->pageFile.remove();
+    }
+    delete channel;
+}
+
+void DaemonConnection::query(QDataStream &stream)
+{
+    quint32 channelId = 0;
+    quint32 request = 0;
+    quint8 kind = DaemonProtocol::NewQuery;
+    QString query;
+    QSize imageSize;
+    stream >> channelId >> request >> kind >> query >> imageSize;
+
+    Channel *channel = m_channels.value(channelId);
+    if (!channel) {
+        return;
+    }
+
+    DaemonRunner::Request &wanted = channel->wanted;
+    if (kind == DaemonProtocol::MoreMatches) {
+        ++wanted.more;
+    } else {
+        wanted = DaemonRunner::Request();
+        wanted.kind = kind == DaemonProtocol::DefaultMatches ? kind : (quint8)DaemonProtocol::NewQuery;
+        if (wanted.kind == DaemonProtocol::NewQuery) {
+            wanted.query = query;
+        }
+    }
+    wanted.imageSize = imageSize;
+
+    channel->request = request;
+    channel->pagePending = false;
+
+    if (channel->runner) {
+        channel->runner->request(this, channelId, request, wanted);
+    } else {
+        // nothing here to match it
+        HeadlessSession::Page page;
+        page.query = wanted.query;
+        page.complete = true;
+        deliver(channelId, request, page);
+    }
+}
+
+void DaemonConnection::exec(quint32 channelId, quint32 request, quint64 matchId)
+{
+    Channel *channel = m_channels.value(channelId);
+    if (!channel || !channel->matches.contains(matchId)) {
+        QByteArray payload;
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_5_0);
+        stream << (quint8)DaemonProtocol::ExecResult << request << false;
+        send(payload);
+        return;
+    }
+
+    m_execs.insert(matchId, request);
+    ExecRunnable *runnable = new ExecRunnable(channel->matches.value(matchId));
+    connect(runnable, SIGNAL(finished(Sprinter::QueryMatch,bool)),
+            this, SLOT(execFinished(Sprinter::QueryMatch,bool)));
+    QThreadPool::globalInstance()->start(runnable);
+}
+
+void DaemonConnection::execFinished(const Sprinter::QueryMatch &match, bool success)
+{
+    for (auto request: m_execs.values(match.id())) {
+        QByteArray payload;
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_5_0);
+        stream << (quint8)DaemonProtocol::ExecResult << request << success;
+        send(payload);
+    }
+
+    m_execs.remove(match.id());
+}
+
+void DaemonConnection::deliver(quint32 channelId, quint32 request, const HeadlessSession::Page &page)
+{
+    Channel *channel = m_channels.value(channelId);
+    if (!channel || request != channel->request) {
+        return;
+    }
+
+    // replaces a page the client has not had yet, as the newer one has
+    // all of its matches
+    channel->page = page;
+    channel->pageRequest = request;
+    channel->pagePending = true;
+    sendPage(channel);
+}
+
+void DaemonConnection::sendPage(Channel *channel)
+{
+    if (channel->awaitingRead || !channel->pagePending) {
+        // the page goes out once the client has read the last one
+        return;
+    }
+
+    const HeadlessSession::Page page = channel->page;
+    const quint32 request = channel->pageRequest;
+    channel->pagePending = false;
+    channel->page = HeadlessSession::Page();
+
+    channel->matches.clear();
+    for (auto const &match: page.matches) {
+        channel->matches.insert(match.id(), match);
+    }
+
+    const QByteArray data = DaemonProtocol::writeMatches(page.matches);
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << (quint8)DaemonProtocol::Page << channel->id << request << (quint32)page.serial << page.complete;
+    if (data.size() <= DaemonProtocol::InlinePageSize || !writePageFile(channel, data)) {
+        stream << data;
+    } else {
+        stream << QByteArray() << channel->pageFile.fileName() << (qint64)data.size();
+    }
+
+    channel->awaitingRead = true;
+    send(payload);
+}
+
+bool DaemonConnection::writePageFile(Channel *channel, const QByteArray &data)
+{
+    // the file is in the runtime directory, normally a tmpfs, so this
+    // copies the page straight into the memory the client maps
+    QFile &file = channel->pageFile;
+    if (!file.isOpen()) {
+        if (!file.open(QIODevice::ReadWrite)) {
+            qWarning() << "Could not open" << file.fileName() << ":" << file.errorString();
+            return false;
+        }
+
+        file.setPermissions(QFile::ReadOwner | QFile::WriteOwner);
+    }
+
+    return file.seek(0) && file.write(data) == data.size() && file.flush();
+}
+
+void DaemonConnection::send(const QByteArray &payload)
+{
+    DaemonProtocol::writeFrame(m_socket, payload);
+}
+
+} // namespace
+
+#include "moc_daemonserver_p.cpp"
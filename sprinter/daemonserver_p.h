@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPRINTER_DAEMONSERVER_P_H
+#define SPRINTER_DAEMONSERVER_P_H
+
+#include <sprinter/sprinter_export.h>
+
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QSize>
+#include <QStringList>
+
+#include "headlesssession.h"
+#include "querymatch.h"
+
+class QDataStream;
+class QLocalServer;
+class QLocalSocket;
+
+namespace Sprinter
+{
+
+class DaemonConnection;
+class DaemonRunner;
+
+/**
+ * @class DaemonServer
+ * The heart of sprinterd: loads all runners once and serves them to the
+ * QuerySessions of other processes, see DaemonClient and DaemonProtocol.
+ * Exported for sprinterd only.
+ */
+class SPRINTER_EXPORT DaemonServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    DaemonServer(QObject *parent = 0);
+    ~DaemonServer();
+
+    /**
+     * Sets where to listen; DaemonProtocol::socketPath() by default
+     */
+    void setSocketPath(const QString &path);
+
+    /**
+     * Sets which runners to keep loaded; all of them by default
+     */
+    void setRunners(const QStringList &runnerIds);
+
+    /**
+     * Used for runner sandboxes, which serve just the one process that
+     * started them: the application quits once the last client has gone,
+     * or if no client has come within the timeout passed to start().
+     */
+    void setExitWhenUnused(bool exit);
+
+    /**
+     * Loads the runners, waiting up to timeout milliseconds for them, and
+     * starts listening at the socket path
+     * @return false if another daemon is listening there already, or the
+     *         socket could not be set up; errorString() says which
+     */
+    bool start(int timeout);
+    QString errorString() const;
+
+private Q_SLOTS:
+    void newConnection();
+    void connectionClosed();
+    void checkUnused();
+
+private:
+    QLocalServer *m_server;
+    QString m_socketPath;
+    QStringList m_runnerIds;
+    // scans for and loads the runners, which then stay loaded between
+    // clients; it never queries, so it builds no session data of its own
+    HeadlessSession *m_resident;
+    QHash<QString, DaemonRunner *> m_hosted;
+    // the Runners message, the same for all clients
+    QByteArray m_runners;
+    QString m_error;
+    int m_lastConnection;
+    int m_connections;
+    bool m_exitWhenUnused;
+};
+
+/**
+ * @class DaemonRunner
+ * One runner as served by the daemon: a HeadlessSession with just that
+ * runner, shared by the channels of all clients, so that the runner's
+ * session data, with whatever it indexes and caches, is built once for
+ * the whole user session rather than once per client session.
+ *
+ * The session runs one request at a time. Channels asking for what is
+ * being matched join in, starting with the latest page; others wait their
+ * turn, with equal requests sharing a place in the queue. A request nobody
+ * waits for anymore gives way to the next one. Pages go out to each of the
+ * channels of a request through its DaemonConnection.
+ *
+ * Lives in the server's thread, as do the connections.
+ */
+class DaemonRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Request
+    {
+        Request()
+            : kind(0),
+              more(0)
+        {
+        }
+
+        bool operator==(const Request &other) const;
+        bool sameQuery(const Request &other) const;
+
+        // DaemonProtocol::NewQuery or DefaultMatches
+        quint8 kind;
+        QString query;
+        QSize imageSize;
+        // how many times more matches were asked for since the query
+        int more;
+    };
+
+    DaemonRunner(const QString &runnerId, QObject *parent = 0);
+    ~DaemonRunner();
+
+    /**
+     * Has the pages for wanted delivered to the channel, replacing what
+     * it asked for before
+     */
+    void request(DaemonConnection *connection, quint32 channelId, quint32 request, const Request &wanted);
+
+    /**
+     * Stops delivering pages to the channel
+     */
+    void cancel(DaemonConnection *connection, quint32 channelId);
+
+private Q_SLOTS:
+    void pageArrived();
+
+private:
+    struct Subscriber
+    {
+        DaemonConnection *connection;
+        quint32 channelId;
+        quint32 request;
+    };
+
+    struct Job
+    {
+        Request wanted;
+        QList<Subscriber> subscribers;
+    };
+
+    void unsubscribe(DaemonConnection *connection, quint32 channelId);
+    // moves on to the next request if the session is free for it
+    void settle();
+    void startNext();
+    void moreMatches();
+    // reads which pages are for the request just made
+    void requestMade();
+    void deliver(const Subscriber &subscriber, const HeadlessSession::Page &page);
+
+    HeadlessSession *m_session;
+
+    // the latest page, set in the session's thread
+    QMutex m_lock;
+    HeadlessSession::Page m_page;
+    bool m_pagePending;
+
+    // the request being matched, if m_busy, or else the last one
+    Job m_current;
+    bool m_busy;
+    // what the session was last asked for
+    Request m_state;
+    bool m_stateValid;
+    // pages up to this serial are for requests made before the last
+    int m_requestSerial;
+    // more matches to ask for before the pages are what m_current wants
+    int m_morePending;
+    // the last page delivered for m_current
+    HeadlessSession::Page m_lastPage;
+    QList<Job> m_queue;
+};
+
+/**
+ * One client of the daemon. Each channel the client opens is served by
+ * the DaemonRunner of its runner, with the pages of matches going back
+ * to the client as they come.
+ */
+class DaemonConnection : public QObject
+{
+    Q_OBJECT
+
+public:
+    DaemonConnection(QLocalSocket *socket, int id, const QByteArray &runners,
+                     const QHash<QString, DaemonRunner *> &hosted,
+                     const QString &pageDirectory, QObject *parent = 0);
+    ~DaemonConnection();
+
+    /**
+     * Sends the page to the client, as soon as it has read the last one;
+     * called by the DaemonRunner of the channel
+     */
+    void deliver(quint32 channelId, quint32 request, const HeadlessSession::Page &page);
+
+private Q_SLOTS:
+    void readMessages();
+    void execFinished(const Sprinter::QueryMatch &match, bool success);
+
+private:
+    struct Channel
+    {
+        Channel()
+            : id(0),
+              runner(0),
+              request(0),
+              pageRequest(0),
+              pagePending(false),
+              awaitingRead(false)
+        {
+        }
+
+        quint32 id;
+        // 0 if the daemon does not host the runner
+        DaemonRunner *runner;
+        quint32 request;
+        DaemonRunner::Request wanted;
+
+        // the page to send once the client has read the last one
+        HeadlessSession::Page page;
+        quint32 pageRequest;
+        bool pagePending;
+        // the client has not read the last page sent yet
+        bool awaitingRead;
+
+        // the matches of the last page sent, by id, to execute from
+        QHash<quint64, QueryMatch> matches;
+        QFile pageFile;
+    };
+
+    void handleMessage(const QByteArray &payload);
+    void open(quint32 channelId, const QString &runnerId);
+    void close(quint32 channelId);
+    void query(QDataStream &stream);
+    void exec(quint32 channelId, quint32 request, quint64 matchId);
+    void sendPage(Channel *channel);
+    bool writePageFile(Channel *channel, const QByteArray &data);
+    void send(const QByteArray &payload);
+
+    QLocalSocket *m_socket;
+    const int m_id;
+    const QByteArray m_runners;
+    const QHash<QString, DaemonRunner *> m_hosted;
+    const QString m_pageDirectory;
+    QHash<quint32, Channel *> m_channels;
+    // exec requests by the id of the match being executed
+    QMultiHash<quint64, quint32> m_execs;
+};
+
+} // namespace
+
+#endif
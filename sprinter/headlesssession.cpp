@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "headlesssession.h"
+#include "headlesssession_p.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QThread>
+
+#include "networkmonitor_p.h"
+#include "querysession.h"
+#include "querysession_p.h"
+#include "querysessionthread_p.h"
+
+namespace Sprinter
+{
+
+// waits on the condition with lock held, for what is left of timeout;
+// returns false once that has run out
+static bool waitFor(QWaitCondition &condition, QMutex &lock, const QElapsedTimer &clock, int timeout)
+{
+    if (timeout < 0) {
+        condition.wait(&lock);
+        return true;
+    }
+
+    const qint64 remaining = timeout - clock.elapsed();
+    return remaining > 0 && condition.wait(&lock, remaining);
+}
+
+HeadlessSessionPrivate::HeadlessSessionPrivate(const QStringList &ids)
+    : thread(0),
+      runnerIds(ids),
+      generation(0),
+      appliedGeneration(0),
+      readSerial(0),
+      requestSerial(0),
+      loadRequested(false),
+      loadFailures(0),
+      m_session(0),
+      m_idle(false),
+      m_halted(false)
+{
+}
+
+void HeadlessSessionPrivate::setup()
+{
+    m_session = new QuerySession(this);
+    m_session->d->headless = this;
+    connect(m_session->runnerModel(), SIGNAL(runnerIdsChanged()),
+            this, SLOT(loadRunners()));
+    connect(m_session->d->worker, SIGNAL(runnerLoaded(int)),
+            this, SLOT(runnerLoaded(int)));
+    connect(m_session->d->worker, SIGNAL(runnersIdle(int)),
+            this, SLOT(runnersIdle(int)));
+}
+
+void HeadlessSessionPrivate::teardown()
+{
+    m_session->halt();
+    delete m_session;
+    m_session = 0;
+}
+
+void HeadlessSessionPrivate::loadRunners()
+{
+    QAbstractItemModel *runners = m_session->runnerModel();
+    const QStringList available = runners->property("runnerIds").toStringList();
+    if (available.isEmpty()) {
+        return;
+    }
+
+    QStringList ids;
+    {
+        QMutexLocker locker(&lock);
+        if (loadRequested) {
+            return;
+        }
+
+        for (auto const &id: runnerIds.isEmpty() ? available : runnerIds) {
+            if (available.contains(id)) {
+                ids << id;
+                loading.insert(id);
+            } else {
+                ++loadFailures;
+            }
+        }
+
+        loadRequested = true;
+        changed.wakeAll();
+    }
+
+    runners->setProperty("enabledRunners", ids);
+    for (auto const &id: ids) {
+        QMetaObject::invokeMethod(runners, "loadRunner", Q_ARG(int, available.indexOf(id)));
+    }
+}
+
+void HeadlessSessionPrivate::runnerLoaded(int index)
+{
+    const RunnerMetaData &md = m_session->d->worker->runnerMetaData().at(index);
+
+    QMutexLocker locker(&lock);
+    if (loading.remove(md.id)) {
+        if (!md.loaded) {
+            ++loadFailures;
+        }
+        changed.wakeAll();
+    }
+}
+
+void HeadlessSessionPrivate::setQuery(const QString &query, int generation)
+{
+    {
+        QMutexLocker locker(&lock);
+        appliedGeneration = generation;
+    }
+
+    if (m_halted) {
+        // halting keeps the query, which would then not be run again
+        m_halted = false;
+        m_session->setQuery(QString());
+    } else if (m_session->query() == query.trimmed()) {
+        // nothing new to look for: once the runners are done with the
+        // query, what there is, is all there will be; until then the
+        // pages keep coming as they would have
+        if (m_idle) {
+            deliver(true);
+        }
+        return;
+    }
+
+    m_idle = false;
+    m_session->setQuery(query);
+}
+
+void HeadlessSessionPrivate::requestDefaultMatches(int generation)
+{
+    {
+        QMutexLocker locker(&lock);
+        appliedGeneration = generation;
+    }
+
+    m_idle = false;
+    m_halted = false;
+    m_session->requestDefaultMatches();
+}
+
+void HeadlessSessionPrivate::requestMoreMatches(int generation)
+{
+    {
+        QMutexLocker locker(&lock);
+        appliedGeneration = generation;
+    }
+
+    m_idle = false;
+    m_session->requestMoreMatches();
+}
+
+void HeadlessSessionPrivate::setImageSize(const QSize &size)
+{
+    m_session->setImageSize(size);
+}
+
+void HeadlessSessionPrivate::halt()
+{
+    m_idle = false;
+    m_halted = true;
+    m_session->halt();
+    deliver(true);
+}
+
+void HeadlessSessionPrivate::runnersIdle(int generation)
+{
+    if (generation != m_session->d->worker->generation()) {
+        // for a query since replaced
+        return;
+    }
+
+    m_idle = true;
+    if (!m_session->d->syncRequested.load()) {
+        // every match is in already
+        deliver(true);
+    }
+}
+
+void HeadlessSessionPrivate::matchesSynchronized(bool changed)
+{
+    const bool complete = m_idle && !m_session->d->syncRequested.load();
+    if (changed || complete) {
+        deliver(complete);
+    }
+}
+
+void HeadlessSessionPrivate::deliver(bool complete)
+{
+    const QVector<QueryMatch> matches = m_session->d->worker->matches();
+    HeadlessSession::Page delivered;
+    HeadlessSession::Callback notify;
+    {
+        QMutexLocker locker(&lock);
+        if (appliedGeneration != generation ||
+            (complete && page.complete && page.matches == matches)) {
+            // for a query since replaced, or nothing new to tell
+            return;
+        }
+
+        page.matches = matches;
+        page.complete = complete;
+        ++page.serial;
+        changed.wakeAll();
+
+        delivered = page;
+        notify = callback;
+    }
+
+    if (notify) {
+        notify(delivered);
+    }
+}
+
+HeadlessSession::HeadlessSession(const QStringList &runnerIds)
+    : d(new HeadlessSessionPrivate(runnerIds))
+{
+    Q_ASSERT(QCoreApplication::instance());
+
+    // the network monitor belongs to the main thread; without it the
+    // runners are not told about the network coming and going
+    if (QThread::currentThread() == QCoreApplication::instance()->thread()) {
+        NetworkMonitor::instance();
+    }
+
+    d->thread = new QThread;
+    d->thread->setObjectName(QStringLiteral("HeadlessSession"));
+    d->moveToThread(d->thread);
+    d->thread->start();
+    QMetaObject::invokeMethod(d, "setup", Qt::BlockingQueuedConnection);
+}
+
+HeadlessSession::~HeadlessSession()
+{
+    QMetaObject::invokeMethod(d, "teardown", Qt::BlockingQueuedConnection);
+    d->thread->quit();
+    d->thread->wait();
+    delete d->thread;
+    delete d;
+}
+
+bool HeadlessSession::waitForRunners(int timeout)
+{
+    QElapsedTimer clock;
+    clock.start();
+
+    QMutexLocker locker(&d->lock);
+    while (!d->loadRequested || !d->loading.isEmpty()) {
+        if (!waitFor(d->changed, d->lock, clock, timeout)) {
+            return false;
+        }
+    }
+
+    return d->loadFailures == 0;
+}
+
+void HeadlessSession::setCallback(const Callback &callback)
+{
+    QMutexLocker locker(&d->lock);
+    d->callback = callback;
+}
+
+void HeadlessSession::setQuery(const QString &query)
+{
+    int generation;
+    {
+        QMutexLocker locker(&d->lock);
+        generation = ++d->generation;
+        d->requestSerial = d->page.serial;
+        d->page.query = query;
+        d->page.matches.clear();
+        d->page.complete = false;
+    }
+
+    QMetaObject::invokeMethod(d, "setQuery", Q_ARG(QString, query), Q_ARG(int, generation));
+}
+
+QString HeadlessSession::query() const
+{
+    QMutexLocker locker(&d->lock);
+    return d->page.query;
+}
+
+void HeadlessSession::requestDefaultMatches()
+{
+    int generation;
+    {
+        QMutexLocker locker(&d->lock);
+        generation = ++d->generation;
+        d->requestSerial = d->page.serial;
+        d->page.query.clear();
+        d->page.matches.clear();
+        d->page.complete = false;
+    }
+
+    QMetaObject::invokeMethod(d, "requestDefaultMatches", Q_ARG(int, generation));
+}
+
+void HeadlessSession::requestMoreMatches()
+{
+    // pages still on their way from before are not for the longer list
+    int generation;
+    {
+        QMutexLocker locker(&d->lock);
+        generation = ++d->generation;
+        d->requestSerial = d->page.serial;
+        d->page.complete = false;
+    }
+
+    QMetaObject::invokeMethod(d, "requestMoreMatches", Q_ARG(int, generation));
+}
+
+void HeadlessSession::setImageSize(const QSize &size)
+{
+    QMetaObject::invokeMethod(d, "setImageSize", Q_ARG(QSize, size));
+}
+
+void HeadlessSession::halt()
+{
+    QMetaObject::invokeMethod(d, "halt");
+}
+
+bool HeadlessSession::nextPage(Page &page, int timeout)
+{
+    QElapsedTimer clock;
+    clock.start();
+
+    QMutexLocker locker(&d->lock);
+    while (d->page.serial == d->readSerial) {
+        if (d->page.complete || !waitFor(d->changed, d->lock, clock, timeout)) {
+            return false;
+        }
+    }
+
+    d->readSerial = d->page.serial;
+    page = d->page;
+    return true;
+}
+
+} // namespace
+
+#include "moc_headlesssession_p.cpp"
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPRINTER_HEADLESSSESSION
+#define SPRINTER_HEADLESSSESSION
+
+#include <sprinter/sprinter_export.h>
+#include <sprinter/querymatch.h>
+
+#include <QSize>
+#include <QStringList>
+#include <QVector>
+
+#include <functional>
+
+namespace Sprinter
+{
+
+class HeadlessSessionPrivate;
+
+/**
+ * @class HeadlessSession
+ * Runs queries through Sprinter's runners without a QAbstractItemModel,
+ * for use in services and batch tools.
+ *
+ * It is driven by the same machinery as QuerySession, which lives in a
+ * thread of its own here, so it does not need an event loop in the
+ * application and may be used from any thread. A QCoreApplication must
+ * exist (a QGuiApplication if runners create icons), but it need not
+ * be running.
+ *
+ * Results are delivered as pages: after each synchronization, a snapshot
+ * of all current matches in the order a model would list them. Pages
+ * either go to a callback, or are pulled with nextPage, or both. The
+ * last page for a query, once all runners are done with it, is marked
+ * as complete.
+ */
+class SPRINTER_EXPORT HeadlessSession
+{
+public:
+    struct Page
+    {
+        Page()
+            : serial(0),
+              complete(false)
+        {
+        }
+
+        // the query the matches are for; empty for default matches
+        QString query;
+        QVector<QueryMatch> matches;
+        // increases with each page delivered by the session
+        int serial;
+        // true when the runners are done with the query
+        bool complete;
+    };
+
+    /**
+     * Called with each page from the session's own thread; it should
+     * return quickly and may call the other methods of the session
+     */
+    typedef std::function<void (const Page &page)> Callback;
+
+    /**
+     * @param runnerIds the runners to load and use; all available
+     *        runners if empty
+     */
+    explicit HeadlessSession(const QStringList &runnerIds = QStringList());
+    ~HeadlessSession();
+
+    /**
+     * Blocks until the runners are loaded, so that the first queries
+     * are not missed by runners still loading
+     * @param timeout in milliseconds; -1 to wait as long as it takes
+     * @return true if all runners were loaded
+     */
+    bool waitForRunners(int timeout = -1);
+
+    void setCallback(const Callback &callback);
+
+    /**
+     * Starts a query, replacing the current one
+     */
+    void setQuery(const QString &query);
+    QString query() const;
+
+    void requestDefaultMatches();
+    void requestMoreMatches();
+
+    /**
+     * Sets the size of the images matches should come with, as
+     * QuerySession::setImageSize; applies to queries started afterwards
+     */
+    void setImageSize(const QSize &size);
+
+    /**
+     * Ends the query session, as QuerySession::halt. Readers waiting in
+     * nextPage receive an empty, complete page.
+     */
+    void halt();
+
+    /**
+     * Waits for a page newer than the last one returned, if there is no
+     * such page yet. Pages that are replaced before they are read are
+     * skipped. Meant for a single reader.
+     * @param page set to the page, if one is returned
+     * @param timeout in milliseconds; -1 to wait as long as it takes
+     * @return false on timeout, or once the complete page for the current
+     *         query has been returned
+     */
+    bool nextPage(Page &page, int timeout = -1);
+
+private:
+    friend class DaemonRunner;
+    HeadlessSessionPrivate * const d;
+};
+
+} // namespace
+
+#endif
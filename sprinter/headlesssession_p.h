@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPRINTER_HEADLESSSESSION_P_H
+#define SPRINTER_HEADLESSSESSION_P_H
+
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QWaitCondition>
+
+#include "headlesssession.h"
+
+class QThread;
+
+namespace Sprinter
+{
+
+class QuerySession;
+
+/**
+ * Lives in its own thread along with the QuerySession it drives. The
+ * public methods post to the slots here, and pages are handed back to
+ * the callers' threads under lock.
+ */
+class HeadlessSessionPrivate : public QObject
+{
+    Q_OBJECT
+
+public:
+    HeadlessSessionPrivate(const QStringList &runnerIds);
+
+    // called by QuerySession after each sync
+    void matchesSynchronized(bool changed);
+
+    QThread *thread;
+    const QStringList runnerIds;
+
+    // guards everything below, which is shared with the callers' threads
+    QMutex lock;
+    QWaitCondition changed;
+    HeadlessSession::Callback callback;
+    HeadlessSession::Page page;
+    // bumped by each query started, so that pages of a query which has
+    // already been replaced are not delivered
+    int generation;
+    int appliedGeneration;
+    int readSerial;
+    // the serial of the last page before the latest query or request for
+    // more matches; the pages after it are all for that request
+    int requestSerial;
+    // runners asked to load which have not reported back yet
+    QSet<QString> loading;
+    bool loadRequested;
+    int loadFailures;
+
+public Q_SLOTS:
+    void setup();
+    void teardown();
+    void setQuery(const QString &query, int generation);
+    void requestDefaultMatches(int generation);
+    void requestMoreMatches(int generation);
+    void setImageSize(const QSize &size);
+    void halt();
+
+private Q_SLOTS:
+    void loadRunners();
+    void runnerLoaded(int index);
+    void runnersIdle(int generation);
+
+private:
+    void deliver(bool complete);
+
+    QuerySession *m_session;
+    // the runners are done with the current query; only a sync may remain
+    bool m_idle;
+    bool m_halted;
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,447 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "iconcache_p.h"
+
+#include <QAtomicInt>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QIcon>
+#include <QLockFile>
+#include <QMap>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QUuid>
+
+#include <string.h>
+
+// #define DEBUG_ICONCACHE
+
+namespace Sprinter
+{
+
+// the on-disk layout is a FileHeader followed by any number of entries,
+// each of which is an EntryHeader, the utf8 key and the pixel data. every
+// part starts on an Alignment boundary so the pixels can be used in place.
+static const quint32 FileMagic = 0x53504943; // "SPIC"
+static const quint32 FileVersion = 1;
+static const quint32 EntryMagic = 0x53504945; // "SPIE"
+static const qint64 Alignment = 16;
+static const qint64 MaxFileSize = 16 * 1024 * 1024;
+static const int LockTimeout = 100;
+
+struct FileHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint64 generation;
+};
+
+struct EntryHeader
+{
+    quint32 magic;
+    quint32 keyLength;
+    qint32 width;
+    qint32 height;
+    qint32 bytesPerLine;
+    qint32 reserved;
+    double scale;
+    quint64 totalLength;
+    quint64 padding;
+};
+
+static inline qint64 alignUp(qint64 value)
+{
+    return (value + Alignment - 1) & ~(Alignment - 1);
+}
+
+static inline qint64 firstEntryOffset()
+{
+    return alignUp(sizeof(FileHeader));
+}
+
+static inline qint64 pixelOffset(quint32 keyLength)
+{
+    return alignUp(sizeof(EntryHeader) + keyLength);
+}
+
+static const EntryHeader *entryAt(const uchar *data, qint64 size, qint64 offset)
+{
+    if (offset + (qint64)sizeof(EntryHeader) > size) {
+        return 0;
+    }
+
+    const EntryHeader *entry = reinterpret_cast<const EntryHeader *>(data + offset);
+    if (entry->magic != EntryMagic ||
+        entry->width <= 0 || entry->height <= 0 ||
+        entry->bytesPerLine < entry->width * 4 ||
+        (qint64)entry->totalLength < pixelOffset(entry->keyLength) + (qint64)entry->bytesPerLine * entry->height ||
+        offset + (qint64)entry->totalLength > size) {
+        // either damaged or still being written by another process
+        return 0;
+    }
+
+    return entry;
+}
+
+static quint64 newGeneration()
+{
+    const QUuid uuid = QUuid::createUuid();
+    return (quint64(uuid.data1) << 32) | (quint64(uuid.data2) << 16) | uuid.data3;
+}
+
+static qreal rasterScale()
+{
+    if (qGuiApp && QCoreApplication::testAttribute(Qt::AA_UseHighDpiPixmaps)) {
+        return qGuiApp->devicePixelRatio();
+    }
+
+    return 1.0;
+}
+
+class IconCacheMapping
+{
+public:
+    IconCacheMapping(const QString &path)
+        : file(path),
+          data(0),
+          size(0),
+          ref(1)
+    {
+    }
+
+    ~IconCacheMapping()
+    {
+        if (data) {
+            file.unmap(data);
+        }
+    }
+
+    QFile file;
+    uchar *data;
+    qint64 size;
+    QAtomicInt ref;
+};
+
+static void releaseMapping(void *info)
+{
+    IconCacheMapping *mapping = static_cast<IconCacheMapping *>(info);
+    if (!mapping->ref.deref()) {
+        delete mapping;
+    }
+}
+
+Q_GLOBAL_STATIC(IconCache, s_iconCache)
+
+IconCache *IconCache::instance()
+{
+    return s_iconCache();
+}
+
+IconCache::IconCache()
+    : m_mapping(0),
+      m_scannedTo(0),
+      m_generation(0)
+{
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+    if (!dir.isEmpty() && QDir().mkpath(dir + QStringLiteral("/sprinter"))) {
+        m_path = dir + QStringLiteral("/sprinter/iconraster.cache");
+    }
+}
+
+IconCache::~IconCache()
+{
+    if (m_mapping) {
+        releaseMapping(m_mapping);
+    }
+}
+
+QString IconCache::cacheKey(const QString &theme, const QString &name, const QSize &size, qreal scale)
+{
+    return theme + QLatin1Char('/') + name + QLatin1Char('/') +
+           QString::number(size.width()) + QLatin1Char('x') +
+           QString::number(size.height()) + QLatin1Char('@') +
+           QString::number(scale);
+}
+
+QImage IconCache::image(const QIcon &icon, const QSize &size)
+{
+    if (icon.isNull() || icon.name().isEmpty() || m_path.isEmpty()) {
+        return icon.pixmap(size).toImage();
+    }
+
+    const QString theme = QIcon::themeName();
+    const qreal scale = rasterScale();
+    QImage image = lookup(theme, icon.name(), size, scale);
+    if (image.isNull()) {
+        image = icon.pixmap(size).toImage();
+        insert(theme, icon.name(), size, scale, image);
+    }
+
+    return image;
+}
+
+QImage IconCache::lookup(const QString &theme, const QString &name, const QSize &size, qreal scale)
+{
+    if (m_path.isEmpty()) {
+        return QImage();
+    }
+
+    return lookup(cacheKey(theme, name, size, scale));
+}
+
+QImage IconCache::lookup(const QString &key)
+{
+    QMutexLocker lock(&m_lock);
+
+    QHash<QString, qint64>::const_iterator it = m_index.constFind(key);
+    if (it == m_index.constEnd()) {
+        // another process may have added it since we last looked
+        if (!remap()) {
+            return QImage();
+        }
+
+        it = m_index.constFind(key);
+        if (it == m_index.constEnd()) {
+            return QImage();
+        }
+    }
+
+    const EntryHeader *entry = reinterpret_cast<const EntryHeader *>(m_mapping->data + it.value());
+    const uchar *pixels = m_mapping->data + it.value() + pixelOffset(entry->keyLength);
+
+    // the image keeps the mapping alive until it, and all its copies, are gone
+    m_mapping->ref.ref();
+    QImage image(pixels, entry->width, entry->height, entry->bytesPerLine,
+                 QImage::Format_ARGB32_Premultiplied, releaseMapping, m_mapping);
+    image.setDevicePixelRatio(entry->scale);
+    return image;
+}
+
+bool IconCache::remap()
+{
+    const QFileInfo info(m_path);
+    if (!info.exists()) {
+        return false;
+    }
+
+    if (m_mapping && m_mapping->size == info.size()) {
+        // nothing was appended
+        return true;
+    }
+
+    IconCacheMapping *mapping = new IconCacheMapping(m_path);
+    if (!mapping->file.open(QIODevice::ReadOnly)) {
+        delete mapping;
+        return false;
+    }
+
+    mapping->size = mapping->file.size();
+    if (mapping->size < firstEntryOffset()) {
+        delete mapping;
+        return false;
+    }
+
+    mapping->data = mapping->file.map(0, mapping->size);
+    if (!mapping->data) {
+        delete mapping;
+        return false;
+    }
+
+    const FileHeader *header = reinterpret_cast<const FileHeader *>(mapping->data);
+    if (header->magic != FileMagic || header->version != FileVersion) {
+        delete mapping;
+        return false;
+    }
+
+    if (!m_mapping || header->generation != m_generation) {
+        // the file was replaced by a compaction; offsets are no longer valid
+        m_index.clear();
+        m_scannedTo = firstEntryOffset();
+        m_generation = header->generation;
+    }
+
+    if (m_mapping) {
+        releaseMapping(m_mapping);
+    }
+
+    m_mapping = mapping;
+    scan();
+    return true;
+}
+
+void IconCache::scan()
+{
+    qint64 offset = m_scannedTo;
+    while (const EntryHeader *entry = entryAt(m_mapping->data, m_mapping->size, offset)) {
+        const char *key = reinterpret_cast<const char *>(entry) + sizeof(EntryHeader);
+        m_index.insert(QString::fromUtf8(key, entry->keyLength), offset);
+        offset += entry->totalLength;
+    }
+
+#ifdef DEBUG_ICONCACHE
+    qDebug() << "Icon cache scanned" << (offset - m_scannedTo) << "bytes," << m_index.size() << "entries";
+#endif
+    m_scannedTo = offset;
+}
+
+void IconCache::insert(const QString &theme, const QString &name, const QSize &size, qreal scale, const QImage &image)
+{
+    if (m_path.isEmpty() || image.isNull()) {
+        return;
+    }
+
+    const QImage pixels = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    const QByteArray key = cacheKey(theme, name, size, scale).toUtf8();
+    const qint64 dataOffset = pixelOffset(key.size());
+    const qint64 totalLength = alignUp(dataOffset + pixels.byteCount());
+
+    QByteArray record((int)totalLength, '\0');
+    EntryHeader *entry = reinterpret_cast<EntryHeader *>(record.data());
+    entry->magic = EntryMagic;
+    entry->keyLength = key.size();
+    entry->width = pixels.width();
+    entry->height = pixels.height();
+    entry->bytesPerLine = pixels.bytesPerLine();
+    entry->scale = pixels.devicePixelRatio();
+    entry->totalLength = totalLength;
+    memcpy(record.data() + sizeof(EntryHeader), key.constData(), key.size());
+    memcpy(record.data() + dataOffset, pixels.constBits(), pixels.byteCount());
+
+    QLockFile lockFile(m_path + QStringLiteral(".lock"));
+    if (!lockFile.tryLock(LockTimeout)) {
+        // someone else is busy with the file; we'll just rasterize again next time
+        return;
+    }
+
+    QFile file(m_path);
+    bool usable = file.open(QIODevice::ReadWrite);
+    if (usable) {
+        FileHeader header;
+        usable = file.read(reinterpret_cast<char *>(&header), sizeof(FileHeader)) == sizeof(FileHeader) &&
+                 header.magic == FileMagic && header.version == FileVersion &&
+                 file.size() % Alignment == 0;
+    }
+
+    if (!usable) {
+        // new, damaged or from an incompatible version: never truncate in
+        // place as other processes may have it mapped, replace it instead
+        file.close();
+        if (!compactLocked() || !file.open(QIODevice::ReadWrite)) {
+            return;
+        }
+    }
+
+    file.seek(file.size());
+    const bool written = file.write(record) == record.size();
+    const qint64 fileSize = file.size();
+    file.close();
+
+    if (!written || fileSize > MaxFileSize) {
+        compactLocked();
+    }
+}
+
+void IconCache::compact()
+{
+    if (m_path.isEmpty()) {
+        return;
+    }
+
+    QLockFile lockFile(m_path + QStringLiteral(".lock"));
+    if (lockFile.tryLock(LockTimeout)) {
+        compactLocked();
+    }
+}
+
+bool IconCache::compactLocked()
+{
+    // must be called with the lock file held
+    QByteArray contents;
+    {
+        QFile file(m_path);
+        if (file.open(QIODevice::ReadOnly)) {
+            contents = file.readAll();
+        }
+    }
+
+    const uchar *data = reinterpret_cast<const uchar *>(contents.constData());
+    const qint64 size = contents.size();
+
+    // find the most recent entry for each key
+    QHash<QByteArray, qint64> newest;
+    const FileHeader *header = reinterpret_cast<const FileHeader *>(data);
+    if (size >= firstEntryOffset() &&
+        header->magic == FileMagic && header->version == FileVersion) {
+        qint64 offset = firstEntryOffset();
+        while (const EntryHeader *entry = entryAt(data, size, offset)) {
+            const char *key = reinterpret_cast<const char *>(entry) + sizeof(EntryHeader);
+            newest.insert(QByteArray(key, entry->keyLength), offset);
+            offset += entry->totalLength;
+        }
+    }
+
+    QMap<qint64, qint64> kept;
+    for (auto const &offset: newest) {
+        kept.insert(offset, reinterpret_cast<const EntryHeader *>(data + offset)->totalLength);
+    }
+
+    // keep the most recently added entries within half the size limit so
+    // the file does not need compacting again right away
+    qint64 budget = MaxFileSize / 2;
+    qint64 cutoff = -1;
+    QMapIterator<qint64, qint64> it(kept);
+    it.toBack();
+    while (it.hasPrevious()) {
+        it.previous();
+        if (it.value() > budget) {
+            cutoff = it.key();
+            break;
+        }
+        budget -= it.value();
+    }
+
+    QSaveFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    FileHeader newHeader;
+    newHeader.magic = FileMagic;
+    newHeader.version = FileVersion;
+    newHeader.generation = newGeneration();
+    QByteArray headerBytes((int)firstEntryOffset(), '\0');
+    memcpy(headerBytes.data(), &newHeader, sizeof(FileHeader));
+    file.write(headerBytes);
+
+    for (QMap<qint64, qint64>::const_iterator entry = kept.upperBound(cutoff); entry != kept.constEnd(); ++entry) {
+        file.write(contents.constData() + entry.key(), entry.value());
+    }
+
+#ifdef DEBUG_ICONCACHE
+    qDebug() << "Icon cache compacted from" << size << "bytes to" << file.size();
+#endif
+    return file.commit();
+}
+
+} // namespace
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPRINTER_ICONCACHE_P_H
+#define SPRINTER_ICONCACHE_P_H
+
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+
+class QIcon;
+
+namespace Sprinter
+{
+
+class IconCacheMapping;
+
+/**
+ * @class IconCache
+ * A cache of rasterized theme icons which is shared between processes.
+ *
+ * Entries are appended to a single file in the user's cache directory,
+ * keyed by theme, icon name, size and scale. Readers memory-map that file
+ * and hand out QImages which point directly into the mapping, so no pixels
+ * are copied on a hit. Writers only ever append (serialized between
+ * processes with a lock file); once the file grows past a fixed limit it is
+ * compacted into a fresh file that atomically replaces the old one.
+ * Mappings stay alive for as long as an image refers to them, so a
+ * compaction in another process never invalidates images handed out here.
+ *
+ * All methods are thread safe.
+ */
+class IconCache
+{
+public:
+    IconCache();
+    ~IconCache();
+
+    static IconCache *instance();
+
+    /**
+     * @return a rasterized version of the icon at the given size. Named
+     * theme icons are looked up in and added to the cache; other icons
+     * are simply rasterized.
+     */
+    QImage image(const QIcon &icon, const QSize &size);
+
+    /**
+     * @return the cached image for the given key, or a null image
+     */
+    QImage lookup(const QString &theme, const QString &name, const QSize &size, qreal scale);
+
+    /**
+     * Appends an image to the cache file
+     */
+    void insert(const QString &theme, const QString &name, const QSize &size, qreal scale, const QImage &image);
+
+    /**
+     * Rewrites the cache file with only the most recent entry for each key
+     */
+    void compact();
+
+private:
+    static QString cacheKey(const QString &theme, const QString &name, const QSize &size, qreal scale);
+    QImage lookup(const QString &key);
+    bool remap();
+    void scan();
+    bool compactLocked();
+
+    QMutex m_lock;
+    QString m_path;
+    IconCacheMapping *m_mapping;
+    QHash<QString, qint64> m_index;
+    qint64 m_scannedTo;
+    quint64 m_generation;
+};
+
+} // namespace
+
+#endif
@@ -25,6 +25,9 @@
 #include "sprinter/querycontext.h"
 #include "sprinter/runnersessiondata.h"
 
+#include "querymatch_p.h"
+#include "runnersessiondata_p.h"
+
 namespace Sprinter
 {
 
@@ -34,9 +37,21 @@ public:
     QPointer<Sprinter::RunnerSessionData> sessionData;
     Sprinter::QueryContext context;
     QVector<Sprinter::QueryMatch> matches;
+    // the SessionDataRegistry handle of sessionData
+    quint64 handle;
     bool async;
+
+    void adopt(int from);
 };
 
+void MatchData::Private::adopt(int from)
+{
+    const QVector<QueryMatch> &constMatches = matches;
+    for (int i = from; i < constMatches.size(); ++i) {
+        constMatches[i].d->sessionData = handle;
+    }
+}
+
 MatchData::MatchData(RunnerSessionData *sessionData,
                      const QueryContext &context)
     : d(new Private)
@@ -44,6 +59,7 @@ MatchData::MatchData(RunnerSessionData *sessionData,
     //qDebug() << "Our session data object is" << sessionData;
     d->sessionData = sessionData;
     d->context = context;
+    d->handle = sessionData ? sessionData->d->handle : 0;
     d->async = false;
 }
 
@@ -55,7 +71,7 @@ MatchData::~MatchData()
     if (d->sessionData && (!d->matches.isEmpty() || !d->async)) {
         //qDebug() << "Our session data object is" << d->sessionData;
         //qDebug() << "and how many matches?" << d->matches.count();
-        d->sessionData->setMatches(d->matches, d->context);
+        d->sessionData->setMatches(std::move(d->matches), d->context);
     }
 
     delete d;
@@ -101,12 +117,28 @@ void MatchData::clearMatches()
 MatchData &MatchData::operator<<(const Sprinter::QueryMatch &match)
 {
     d->matches << match;
+    d->adopt(d->matches.size() - 1);
     return *this;
 }
 
 MatchData &MatchData::operator<<(const QVector<Sprinter::QueryMatch> &matches)
 {
+    const int from = d->matches.size();
     d->matches << matches;
+    d->adopt(from);
+    return *this;
+}
+
+MatchData &MatchData::operator<<(QVector<Sprinter::QueryMatch> &&matches)
+{
+    const int from = d->matches.size();
+    if (from == 0) {
+        d->matches = std::move(matches);
+    } else {
+        d->matches << matches;
+        matches.clear();
+    }
+    d->adopt(from);
     return *this;
 }
 
@@ -39,7 +39,10 @@ class RunnerSessionData;
  * 3. Provides a place to store QueryMatch objects as they are generated
  *
  * The class will take care of adding matches to the RunnerSessionData object
- * automatically, relieving the Runner of having to do this.
+ * automatically, relieving the Runner of having to do this. Matches are
+ * associated with the session data as they are added and are handed over
+ * without further copying, so moving a whole vector of matches in is the
+ * cheapest way to add them.
  *
  * Objects of this type may not be copied or assigned to.
  */
@@ -106,6 +109,11 @@ public:
      */
     MatchData &operator<<(const QVector<Sprinter::QueryMatch> &matches);
 
+    /**
+     * Used to add matches to the MatchData object
+     */
+    MatchData &operator<<(QVector<Sprinter::QueryMatch> &&matches);
+
 private:
     MatchData(const MatchData &other);
     MatchData &operator=(const MatchData &other);
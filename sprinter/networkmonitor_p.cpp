@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "networkmonitor_p.h"
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QHostAddress>
+#include <QNetworkConfigurationManager>
+#include <QNetworkInterface>
+#include <QSocketNotifier>
+#include <QThread>
+#include <QTimer>
+
+#ifdef Q_OS_LINUX
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// #define DEBUG_NETWORKMONITOR
+
+namespace Sprinter
+{
+
+// optimistic until we know better, so that network runners are not
+// skipped when there is no monitor at all
+static QAtomicInt s_online(1);
+static NetworkMonitor *s_instance = 0;
+
+NetworkMonitor *NetworkMonitor::instance()
+{
+    Q_ASSERT(QCoreApplication::instance());
+    Q_ASSERT(QThread::currentThread() == QCoreApplication::instance()->thread());
+
+    if (!s_instance) {
+        s_instance = new NetworkMonitor(QCoreApplication::instance());
+    }
+
+    return s_instance;
+}
+
+NetworkMonitor *NetworkMonitor::existingInstance()
+{
+    return s_instance;
+}
+
+bool NetworkMonitor::isOnline()
+{
+    return s_online.loadAcquire();
+}
+
+NetworkMonitor::NetworkMonitor(QObject *parent)
+    : QObject(parent),
+      m_netlinkSocket(-1),
+      m_notifier(0),
+      m_checkTimer(new QTimer(this)),
+      m_configurations(0)
+{
+    // link and address changes tend to come in bursts
+    m_checkTimer->setInterval(100);
+    m_checkTimer->setSingleShot(true);
+    connect(m_checkTimer, SIGNAL(timeout()), this, SLOT(checkInterfaces()));
+
+    const QByteArray forced = qgetenv("SPRINTER_NETWORK_STATE");
+    if (forced == "online") {
+        forceState(true);
+    } else if (forced == "offline") {
+        forceState(false);
+    } else {
+        startMonitoring();
+    }
+}
+
+NetworkMonitor::~NetworkMonitor()
+{
+    stopMonitoring();
+    s_instance = 0;
+}
+
+void NetworkMonitor::forceState(bool online)
+{
+    stopMonitoring();
+    setOnline(online);
+}
+
+void NetworkMonitor::startMonitoring()
+{
+#ifdef Q_OS_LINUX
+    m_netlinkSocket = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (m_netlinkSocket >= 0) {
+        sockaddr_nl address;
+        memset(&address, 0, sizeof(address));
+        address.nl_family = AF_NETLINK;
+        address.nl_groups = RTMGRP_LINK |
+                            RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR |
+                            RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+        if (bind(m_netlinkSocket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0) {
+            m_notifier = new QSocketNotifier(m_netlinkSocket, QSocketNotifier::Read, this);
+            connect(m_notifier, SIGNAL(activated(int)), this, SLOT(netlinkActivity()));
+            checkInterfaces();
+            return;
+        }
+
+        ::close(m_netlinkSocket);
+        m_netlinkSocket = -1;
+    }
+
+    qWarning() << "Sprinter: could not monitor rtnetlink, falling back to the bearer API";
+#endif
+
+    m_configurations = new QNetworkConfigurationManager(this);
+    connect(m_configurations, SIGNAL(onlineStateChanged(bool)), this, SLOT(setOnline(bool)));
+    setOnline(m_configurations->isOnline());
+}
+
+void NetworkMonitor::stopMonitoring()
+{
+    m_checkTimer->stop();
+
+    delete m_notifier;
+    m_notifier = 0;
+
+#ifdef Q_OS_LINUX
+    if (m_netlinkSocket >= 0) {
+        ::close(m_netlinkSocket);
+        m_netlinkSocket = -1;
+    }
+#endif
+
+    delete m_configurations;
+    m_configurations = 0;
+}
+
+void NetworkMonitor::netlinkActivity()
+{
+#ifdef Q_OS_LINUX
+    // we don't care what changed, only that something did; drain the
+    // socket and look at the interfaces once things settle down
+    char buffer[4096];
+    while (recv(m_netlinkSocket, buffer, sizeof(buffer), 0) > 0) {
+    }
+#endif
+
+    m_checkTimer->start();
+}
+
+void NetworkMonitor::checkInterfaces()
+{
+    static const QPair<QHostAddress, int> linkLocal4 = QHostAddress::parseSubnet(QStringLiteral("169.254.0.0/16"));
+    static const QPair<QHostAddress, int> linkLocal6 = QHostAddress::parseSubnet(QStringLiteral("fe80::/10"));
+
+    bool online = false;
+    for (auto const &iface: QNetworkInterface::allInterfaces()) {
+        const QNetworkInterface::InterfaceFlags flags = iface.flags();
+        if (!(flags & QNetworkInterface::IsUp) ||
+            !(flags & QNetworkInterface::IsRunning) ||
+            (flags & QNetworkInterface::IsLoopBack)) {
+            continue;
+        }
+
+        for (auto const &entry: iface.addressEntries()) {
+            const QHostAddress ip = entry.ip();
+            if (!ip.isNull() && !ip.isInSubnet(linkLocal4) && !ip.isInSubnet(linkLocal6)) {
+                online = true;
+                break;
+            }
+        }
+
+        if (online) {
+            break;
+        }
+    }
+
+    setOnline(online);
+}
+
+void NetworkMonitor::setOnline(bool online)
+{
+#ifdef DEBUG_NETWORKMONITOR
+    qDebug() << "Network is" << (online ? "online" : "offline");
+#endif
+    if (s_online.fetchAndStoreRelease(online ? 1 : 0) != (online ? 1 : 0)) {
+        emit onlineChanged(online);
+    }
+}
+
+} // namespace
+
+#include "moc_networkmonitor_p.cpp"
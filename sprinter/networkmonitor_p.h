@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPRINTER_NETWORKMONITOR_P_H
+#define SPRINTER_NETWORKMONITOR_P_H
+
+#include <QObject>
+
+class QNetworkConfigurationManager;
+class QSocketNotifier;
+class QTimer;
+
+namespace Sprinter
+{
+
+/**
+ * @class NetworkMonitor
+ * A process-wide monitor of network reachability. The current state is
+ * published in an atomic so that isOnline() is a single load and can be
+ * called from any thread as often as needed, e.g. for every match of a
+ * runner that relies on network services.
+ *
+ * On Linux changes are picked up from rtnetlink; elsewhere the Qt bearer
+ * API is used. Setting SPRINTER_NETWORK_STATE to "online" or "offline" in
+ * the environment, or calling forceState, pins the state instead, which is
+ * useful for tests and benchmarks.
+ *
+ * The instance lives in, and must be created from, the GUI thread.
+ */
+class NetworkMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+    static NetworkMonitor *instance();
+
+    /**
+     * @return the instance if it has been created already, or 0;
+     * may be called from any thread
+     */
+    static NetworkMonitor *existingInstance();
+    static bool isOnline();
+
+    /**
+     * Stops watching the system and publishes the given state instead
+     */
+    void forceState(bool online);
+
+Q_SIGNALS:
+    void onlineChanged(bool online);
+
+private Q_SLOTS:
+    void netlinkActivity();
+    void checkInterfaces();
+    void setOnline(bool online);
+
+private:
+    NetworkMonitor(QObject *parent);
+    ~NetworkMonitor();
+
+    void startMonitoring();
+    void stopMonitoring();
+
+    int m_netlinkSocket;
+    QSocketNotifier *m_notifier;
+    QTimer *m_checkTimer;
+    QNetworkConfigurationManager *m_configurations;
+};
+
+} // namespace
+
+#endif
@@ -23,38 +23,21 @@
 
 #include <QDebug>
 
+#include "networkmonitor_p.h"
 #include "runnersessiondata.h"
 #include "runnersessiondata_p.h"
 
 namespace Sprinter
 {
 
-void QueryContext::Private::reset(QExplicitlySharedDataPointer<Private> toDetach)
-{
-    // We will detach if we are a copy of someone. But we will reset
-    // if we are the 'main' context others copied from. Resetting
-    // one QueryContext makes all the copies obsolete.
-
-    // We need to reset the session id of the detached instance
-    // on detach to avoid receiving results for old queries
-    const QUuid id = sessionId;
-    sessionId = QUuid();
-
-    toDetach.detach();
-
-    // Now that we detached the d pointer we need to reset its q pointer
-    sessionId = id;
-}
-
 QueryContext::QueryContext()
     : d(new Private)
 {
 }
 
 QueryContext::QueryContext(const QueryContext &other)
+    : d(other.d)
 {
-    QReadLocker lock(&other.d->lock);
-    d = other.d;
 }
 
 QueryContext::~QueryContext()
@@ -63,20 +46,21 @@ QueryContext::~QueryContext()
 
 QueryContext &QueryContext::operator=(const QueryContext &other)
 {
-    if (this->d == other.d) {
-        return *this;
-    }
-
-    QExplicitlySharedDataPointer<QueryContext::Private> oldD = d;
-    d->lock.lockForWrite();
-    other.d->lock.lockForRead();
     d = other.d;
-    other.d->lock.unlock();
-    oldD->lock.unlock();
-
     return *this;
 }
 
+void QueryContext::invalidate()
+{
+    // Bumping the shared generation makes every copy of this context
+    // invalid in one step; we then detach so that we alone carry on
+    // with the new generation. Copies keep their (now stale) data, so
+    // a runner still working on an old query sees a consistent state.
+    const quint64 next = d->currentGeneration->fetchAndAddOrdered(1) + 1;
+    d.detach();
+    d->generation = next;
+}
+
 void QueryContext::setQuery(const QString &query)
 {
     QString trimmedQuery = query.trimmed();
@@ -84,7 +68,7 @@ void QueryContext::setQuery(const QString &query)
         return;
     }
 
-    d->reset(d);
+    invalidate();
 
     d->fetchMore = false;
     d->isDefaultMatchesRequest = false;
@@ -104,7 +88,7 @@ bool QueryContext::isDefaultMatchesRequest() const
 void QueryContext::setIsDefaultMatchesRequest(bool requestDefaults)
 {
     if (d->isDefaultMatchesRequest != requestDefaults) {
-        d->reset(d);
+        invalidate();
         d->fetchMore = false;
         d->query.clear();
         d->isDefaultMatchesRequest = requestDefaults;
@@ -113,13 +97,14 @@ void QueryContext::setIsDefaultMatchesRequest(bool requestDefaults)
 
 bool QueryContext::isValid(const RunnerSessionData *sessionData) const
 {
-    return !d->sessionId.isNull() &&
-          (!sessionData || sessionData->d->sessionId == d->sessionId);
+    return d->generation == d->currentGeneration->loadAcquire() &&
+           d->sessionId &&
+           (!sessionData || sessionData->d->sessionId == d->sessionId);
 }
 
 bool QueryContext::networkAccessible() const
 {
-    return d->network->networkAccessible() == QNetworkAccessManager::Accessible;
+    return NetworkMonitor::isOnline();
 }
 
 void QueryContext::setFetchMore(bool fetchMore)
@@ -142,14 +127,4 @@ QSize QueryContext::imageSize() const
     return d->imageSize;
 }
 
-void QueryContext::readLock() const
-{
-    d->lock.lockForRead();
-}
-
-void QueryContext::readUnlock() const
-{
-    d->lock.unlock();
-}
-
 } //namespace
\ No newline at end of file
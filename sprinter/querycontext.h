@@ -40,7 +40,8 @@ namespace Sprinter
  *
  * With copy-on-write style semantics, when the query state is changed
  * on one object it detaches from all copies, causing all other copies
- * to become invalid.
+ * to become invalid. Checking validity is a single atomic load, so it
+ * is cheap to do often and from many threads.
  *
  * Only the QuerySession object should set the query state. To all other
  * users it is a read-only object.
@@ -106,7 +107,8 @@ public:
     bool isValid(const RunnerSessionData *sessionData) const;
 
     /**
-     * @return true if the newtork is accessible
+     * @return true if the network is accessible. This reflects a
+     * process-wide state and is cheap enough to call for every match.
      */
     bool networkAccessible() const;
 
@@ -135,27 +137,20 @@ public:
 
     /**
      * A higher-order function which runs the passed in lambda function
-     * if and only if the context is valid. This prevents race conditions
-     * that would otherwise exist in test-then-run patterns across multiple
-     * threads.
+     * if the context is valid. Invalidation is not blocked while the
+     * algorithm runs, so it should only touch state that is reset when
+     * the next query starts, as is the case for paging and
+     * canFetchMoreMatches in RunnerSessionData.
      * @param algorithm the lambda function to execute
+     * @return the result of the algorithm, or false if the context is invalid
      */
     template<typename Func>
     bool ifValid(Func algorithm, const RunnerSessionData *sessionData) const {
-        readLock();
-        bool rv = false;
-
-        if (isValid(sessionData)) {
-            rv = algorithm();
-        }
-
-        readUnlock();
-        return rv;
+        return isValid(sessionData) && algorithm();
     }
 
 private:
-    void readLock() const;
-    void readUnlock() const;
+    void invalidate();
 
     friend class QuerySessionThread;
 
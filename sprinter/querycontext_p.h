@@ -21,9 +21,8 @@
 #ifndef QUERYCONTEXT_PRIVATE
 #define QUERYCONTEXT_PRIVATE
 
-#include <QReadWriteLock>
-#include <QNetworkAccessManager>
-#include <QUuid>
+#include <QAtomicInteger>
+#include <QSharedPointer>
 
 namespace Sprinter
 {
@@ -33,28 +32,34 @@ class QueryContext::Private : public QSharedData
 public:
     Private()
         : QSharedData(),
-          network(new QNetworkAccessManager),
+          currentGeneration(new QAtomicInteger<quint64>(1)),
+          generation(1),
           imageSize(64, 64),
+          sessionId(0),
           fetchMore(false),
           isDefaultMatchesRequest(false)
     {
     }
 
-
     Private(const Private &p)
-        : QSharedData()
+        : QSharedData(),
+          currentGeneration(p.currentGeneration),
+          generation(p.generation),
+          query(p.query),
+          imageSize(p.imageSize),
+          sessionId(p.sessionId),
+          fetchMore(p.fetchMore),
+          isDefaultMatchesRequest(p.isDefaultMatchesRequest)
     {
-        //kDebug() << "¿¿¿¿¿¿¿¿¿¿¿¿¿¿¿¿¿boo yeah" <<
-        //type;
     }
 
-    void reset(QExplicitlySharedDataPointer<Private> toDetach);
-
+    // shared by a context and every Private detached from it; a copy
+    // of the context is valid while its generation is the current one
+    QSharedPointer<QAtomicInteger<quint64> > currentGeneration;
+    quint64 generation;
     QString query;
-    QReadWriteLock lock;
-    QSharedPointer<QNetworkAccessManager> network;
     QSize imageSize;
-    QUuid sessionId;
+    quint64 sessionId;
     bool fetchMore;
     bool isDefaultMatchesRequest;
 };
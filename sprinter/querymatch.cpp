@@ -23,11 +23,12 @@
 
 #include <QGuiApplication>
 #include <QClipboard>
+#include <QDataStream>
 #include <QDebug>
-#include <QPointer>
 
 // #include "runner.h"
 #include "runnersessiondata.h"
+#include "sessiondataregistry_p.h"
 
 namespace Sprinter
 {
@@ -42,6 +43,11 @@ QueryMatch::QueryMatch(const QueryMatch &other)
 {
 }
 
+QueryMatch::QueryMatch(QueryMatch &&other)
+{
+    d.swap(other.d);
+}
+
 QueryMatch::~QueryMatch()
 {
 }
@@ -52,6 +58,12 @@ QueryMatch &QueryMatch::operator=(const QueryMatch &other)
     return *this;
 }
 
+QueryMatch &QueryMatch::operator=(QueryMatch &&other)
+{
+    d.swap(other.d);
+    return *this;
+}
+
 bool QueryMatch::operator==(const QueryMatch &rhs) const
 {
     return d == rhs.d;
@@ -59,7 +71,8 @@ bool QueryMatch::operator==(const QueryMatch &rhs) const
 
 bool QueryMatch::isValid() const
 {
-    return d->sessionData && d->sessionData->runner();
+    RunnerSessionData *sessionData = SessionDataRegistry::lookup(d->sessionData);
+    return sessionData && sessionData->runner();
 }
 
 void QueryMatch::setTitle(const QString &title)
@@ -94,12 +107,13 @@ void QueryMatch::setSource(QuerySession::MatchSource source)
 
 QuerySession::MatchSource QueryMatch::source() const
 {
-    return d->source;
+    return (QuerySession::MatchSource)d->source;
 }
 
 void QueryMatch::setImage(const QImage &image)
 {
     d->image = image;
+    d->serial = Private::nextSerial();
 }
 
 QImage QueryMatch::image() const
@@ -127,9 +141,68 @@ QVariant QueryMatch::data() const
     return d->data;
 }
 
+void QueryMatch::setKey(const QString &key)
+{
+    d->key = key;
+}
+
+QString QueryMatch::key() const
+{
+    return d->key;
+}
+
+quint64 QueryMatch::id() const
+{
+    return d->id;
+}
+
+// 64 bit FNV-1a; stable between runs, unlike qHash
+static const quint64 s_fnvOffsetBasis = Q_UINT64_C(14695981039346656037);
+
+static quint64 fnv1a(const char *bytes, int length, quint64 hash)
+{
+    for (int i = 0; i < length; ++i) {
+        hash ^= (uchar)bytes[i];
+        hash *= Q_UINT64_C(1099511628211);
+    }
+
+    return hash;
+}
+
+static quint64 fnv1a(const QString &string, quint64 hash)
+{
+    return fnv1a(reinterpret_cast<const char *>(string.constData()), string.size() * sizeof(QChar), hash);
+}
+
+void QueryMatch::Private::updateId(const QString &runnerId)
+{
+    quint64 hash = fnv1a(runnerId, s_fnvOffsetBasis);
+    // a NUL separator keeps "ab" + "c" and "a" + "bc" apart
+    hash = fnv1a("", 1, hash);
+    if (!key.isEmpty()) {
+        hash = fnv1a(key, hash);
+    } else if (data.type() == QVariant::String) {
+        hash = fnv1a(data.toString(), hash);
+    } else if (!data.isNull()) {
+        QByteArray bytes;
+        QDataStream stream(&bytes, QIODevice::WriteOnly);
+        stream << data;
+        hash = fnv1a(bytes.constData(), bytes.size(), hash);
+    }
+
+    // 0 means no id at all
+    if (!hash) {
+        hash = 1;
+    }
+
+    if (id != hash) {
+        id = hash;
+    }
+}
+
 QuerySession::MatchType QueryMatch::type() const
 {
-    return d->type;
+    return (QuerySession::MatchType)d->type;
 }
 
 void QueryMatch::setPrecision(QuerySession::MatchPrecision precision)
@@ -139,17 +212,18 @@ void QueryMatch::setPrecision(QuerySession::MatchPrecision precision)
 
 QuerySession::MatchPrecision QueryMatch::precision() const
 {
-    return d->precision;
+    return (QuerySession::MatchPrecision)d->precision;
 }
 
 RunnerSessionData *QueryMatch::sessionData() const
 {
-    return d->sessionData;
+    return SessionDataRegistry::lookup(d->sessionData);
 }
 
 Runner *QueryMatch::runner() const
 {
-    return  d->sessionData ? d->sessionData->runner() : 0;
+    RunnerSessionData *sessionData = SessionDataRegistry::lookup(d->sessionData);
+    return sessionData ? sessionData->runner() : 0;
 }
 
 bool QueryMatch::sendUserDataToClipboard() const
@@ -50,9 +50,16 @@ public:
      */
     QueryMatch(const QueryMatch &other);
 
+    /**
+     * Move constructor; the other match may only be assigned to or
+     * destroyed afterwards
+     */
+    QueryMatch(QueryMatch &&other);
+
     ~QueryMatch();
 
     QueryMatch &operator=(const QueryMatch &other);
+    QueryMatch &operator=(QueryMatch &&other);
     bool operator==(const QueryMatch &rhs) const;
 
     /**
@@ -149,6 +156,28 @@ public:
      */
     QVariant data() const;
 
+    /**
+     * Sets a key which identifies this match among all the matches its
+     * runner may generate, e.g. a URL or a database id. Matches with the
+     * same key are considered the same match across queries, which lets
+     * views keep their state for them. If no key is set, data() is used.
+     *
+     * @param key the key to identify the match with
+     */
+    void setKey(const QString &key);
+
+    /**
+     * @return the key of this match, if one was set
+     */
+    QString key() const;
+
+    /**
+     * @return an identifier for this match which is stable across queries,
+     * derived from the id of its runner and its key() or data(). This is
+     * 0 until the match has been handed to a RunnerSessionData object.
+     */
+    quint64 id() const;
+
     /**
      * Sets the precision of this match. @see QuerySession
      *
@@ -180,6 +209,10 @@ public:
     bool sendUserDataToClipboard() const;
 
 private:
+    friend class DaemonProtocol;
+    friend class MatchData;
+    friend class QuerySession;
+    friend class RemoteRunner;
     friend class RunnerSessionData;
 
     class Private;
@@ -21,7 +21,7 @@
 #ifndef QUERYMATCH_P_H
 #define QUERYMATCH_P_H
 
-#include <QPointer>
+#include <QAtomicInteger>
 #include <QSharedData>
 
 #include "querysession.h"
@@ -37,16 +37,38 @@ public:
     Private()
         : type(QuerySession::UnknownType),
           source(QuerySession::FromInternalSource),
-          precision(QuerySession::UnrelatedMatch)
+          precision(QuerySession::UnrelatedMatch),
+          serial(nextSerial()),
+          sessionData(0),
+          id(0),
+          remoteId(0)
     {
     }
 
-    QPointer<RunnerSessionData> sessionData;
+    void updateId(const QString &runnerId);
+
+    // unique per match object in this process; changes with the image
+    // so image URLs handed out by QuerySession never go stale
+    static quint64 nextSerial()
+    {
+        static QAtomicInteger<quint64> s_serial;
+        return s_serial.fetchAndAddRelaxed(1) + 1;
+    }
+
+    // the enums are stored narrowly so they pack in next to the ref count
+    quint8 type;
+    quint8 source;
+    quint16 precision;
+    quint64 serial;
+    // a SessionDataRegistry handle
+    quint64 sessionData;
+    // stable across queries, unlike the serial
+    quint64 id;
+    // for matches from sprinterd: the id of the match there
+    quint64 remoteId;
+    QString key;
     QString title;
     QString text;
-    QuerySession::MatchType type;
-    QuerySession::MatchSource source;
-    QuerySession::MatchPrecision precision;
     QVariant data;
     QVariant userData;
     QImage image;
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "queryrecorder_p.h"
+
+#include <QDebug>
+#include <QUrl>
+
+namespace Sprinter
+{
+
+QueryRecorder::QueryRecorder()
+{
+}
+
+QueryRecorder::~QueryRecorder()
+{
+    stop();
+}
+
+bool QueryRecorder::start(const QString &path)
+{
+    stop();
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Could not open query log" << path << ":" << m_file.errorString();
+        return false;
+    }
+
+    m_file.write("# sprinter query log 1\n");
+    m_file.flush();
+    m_clock.start();
+    return true;
+}
+
+void QueryRecorder::stop()
+{
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+}
+
+bool QueryRecorder::isRecording() const
+{
+    return m_file.isOpen();
+}
+
+QString QueryRecorder::path() const
+{
+    return m_file.isOpen() ? m_file.fileName() : QString();
+}
+
+void QueryRecorder::record(Event event, const QString &argument)
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+
+    QByteArray line = QByteArray::number(m_clock.elapsed());
+    switch (event) {
+        case Query:
+            line += " query ";
+            line += QUrl::toPercentEncoding(argument);
+            break;
+        case MoreMatches:
+            line += " more";
+            break;
+        case DefaultMatches:
+            line += " default";
+            break;
+        case Execute:
+            line += " exec ";
+            line += argument.toLatin1();
+            break;
+        case Halt:
+            line += " halt";
+            break;
+    }
+
+    line += '\n';
+    m_file.write(line);
+    m_file.flush();
+}
+
+} // namespace
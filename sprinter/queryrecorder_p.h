@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPRINTER_QUERYRECORDER_P_H
+#define SPRINTER_QUERYRECORDER_P_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+
+namespace Sprinter
+{
+
+/**
+ * @class QueryRecorder
+ * Logs what the user asks of a QuerySession along with when they asked,
+ * so that sessions seen in the field can be replayed later. Each event is
+ * one line: the milliseconds since recording started, the event name and,
+ * for some events, an argument. Query strings are percent encoded so that
+ * lines never contain spaces or line breaks beyond the separators. Lines
+ * are flushed as they are written, so the log survives a crash.
+ *
+ * Only used from the GUI thread.
+ */
+class QueryRecorder
+{
+public:
+    enum Event {
+        Query,
+        MoreMatches,
+        DefaultMatches,
+        Execute,
+        Halt
+    };
+
+    QueryRecorder();
+    ~QueryRecorder();
+
+    /**
+     * Starts writing to the file at path, replacing its contents
+     * @return true on success
+     */
+    bool start(const QString &path);
+    void stop();
+
+    bool isRecording() const;
+    QString path() const;
+
+    void record(Event event, const QString &argument = QString());
+
+private:
+    QFile m_file;
+    QElapsedTimer m_clock;
+};
+
+} // namespace
+
+#endif
@@ -21,33 +21,76 @@
 #include "querysession.h"
 #include "querysession_p.h"
 
+#include <QCache>
+#include <QAtomicInt>
+#include <QCoreApplication>
 #include <QDebug>
 #include <QMetaEnum>
 #include <QMimeData>
+#include <QMutex>
 #include <QThreadPool>
 #include <QUrl>
 
+#include "headlesssession_p.h"
 #include "runner.h"
+#include "querymatch_p.h"
 #include "querysessionthread_p.h"
+#include "runnerhost_p.h"
 #include "runnermodel_p.h"
+#include "tracerecorder_p.h"
 
 namespace Sprinter
 {
 
+// images that have been handed out as URLs by the ImageRole, keyed
+// by the match serial; bounded so abandoned entries eventually go away
+static QMutex s_matchImagesLock;
+static QCache<quint64, QImage> s_matchImages(32 * 1024);
+
+// sessions recording to SPRINTER_RECORD_FILE so far in this process
+static QAtomicInt s_envRecordings(0);
+
+static QUrl registerMatchImage(quint64 serial, const QImage &image)
+{
+    {
+        QMutexLocker lock(&s_matchImagesLock);
+        if (!s_matchImages.contains(serial)) {
+            s_matchImages.insert(serial, new QImage(image), qMax(1, image.byteCount() / 1024));
+        }
+    }
+
+    return QUrl(QStringLiteral("image://sprinter/%1/%2x%3")
+                .arg(serial).arg(image.width()).arg(image.height()));
+}
+
 QuerySession::Private::Private(QuerySession *session)
     : q(session),
-      workerThread(new QThread(q)),
+      host(RunnerHost::ref()),
       worker(new QuerySessionThread(q)),
       runnerModel(new RunnerModel(worker, q)),
-      syncTimer(new NonRestartingTimer(q)),
-      matchesArrivedWhileExecuting(false)
+      syncScheduler(new SyncScheduler(worker, q)),
+      headless(0),
+      modelNotifications(0),
+      measuringQuery(false),
+      firstMatchLatency(-1),
+      lastMatchLatency(-1),
+      idleLatency(-1)
 {
     fillTypeStringSet();
-    qRegisterMetaType<QUuid>("QUuid");
     qRegisterMetaType<Sprinter::QueryContext>("Sprinter::QueryContext");
     qRegisterMetaType<Sprinter::QueryMatch>("Sprinter::QueryMatch");
 
     q->connect(worker, SIGNAL(resetModel()), q, SLOT(resetModel()));
+    q->connect(worker, SIGNAL(runnersIdle(int)), q, SLOT(runnersIdle(int)));
+
+    const QString recordPath = QString::fromLocal8Bit(qgetenv("SPRINTER_RECORD_FILE"));
+    if (!recordPath.isEmpty()) {
+        // every session of every process sees the same variable; each gets
+        // a log of its own rather than replacing the logs of the others
+        recorder.start(QStringLiteral("%1.%2-%3").arg(recordPath)
+                       .arg(QCoreApplication::applicationPid())
+                       .arg(s_envRecordings.fetchAndAddRelaxed(1) + 1));
+    }
 
     roles.insert(Qt::DisplayRole, "Title");
     roleColumns.append(Qt::DisplayRole);
@@ -68,130 +111,307 @@ QuerySession::Private::Private(QuerySession *session)
 
     // if synchronization becomes too slow, it could be moved to happen
     // in this worker thread, but only with significant complexity
-    syncTimer->setInterval(10);
-    syncTimer->setSingleShot(true);
-
-    connect(syncTimer, SIGNAL(timeout()),
+    connect(syncScheduler, SIGNAL(synchronize()),
             q, SLOT(startMatchSynchronization()));
 
-    // when the thread exits, the worker object should
-    // be deleted. the thread is exited in ~QuerySession
-    connect(workerThread, SIGNAL(finished()),
-            worker, SLOT(deleteLater()));
-
-    qDebug() << "Starting QuerySession worker thread from"
-             << QThread::currentThread();
-    workerThread->start();
-    worker->moveToThread(workerThread);
+    // the worker thread is shared by all sessions, see RunnerHost
+    worker->moveToThread(host->workerThread());
     QMetaObject::invokeMethod(worker, "loadRunnerMetaData");
 }
 
 void QuerySession::Private::fillTypeStringSet()
 {
-    typeStrings.insert(UnknownType, tr("Unknown"));
-
-    typeStrings.insert(ExecutableType, tr("Program"));
-    typeStrings.insert(FileType, tr("File"));
-    typeStrings.insert(InstallableType, tr("Package"));
-    typeStrings.insert(PathType, tr("Path"));
-
-    typeStrings.insert(FilesystemLocationType, tr("Location"));
-    typeStrings.insert(HardwareType, tr("Hardware"));
-    typeStrings.insert(NetworkLocationType, tr("Network"));
-
-    typeStrings.insert(DateTimeType, tr("Date and Time"));
-    typeStrings.insert(EnvironmentalType, tr("Environmental"));
-    typeStrings.insert(GeolocationType, tr("Geolocation"));
-    typeStrings.insert(LanguageType, tr("Langauge"));
-    typeStrings.insert(MathAndUnitsType, tr("Math and Units"));
-    typeStrings.insert(ReferenceType, tr("Reference"));
-
-    typeStrings.insert(AlbumType, tr("Album"));
-    typeStrings.insert(AudioType, tr("Audio"));
-    typeStrings.insert(BookmarkType, tr("Bookmark"));
-    typeStrings.insert(BookType, tr("Book"));
-    typeStrings.insert(ContactType, tr("Contact"));
-    typeStrings.insert(DocumentType, tr("Document"));
-    typeStrings.insert(EventType, tr("Event"));
-    typeStrings.insert(MagazineType, tr("Magazine"));
-    typeStrings.insert(MessageType, tr("Message"));
-    typeStrings.insert(VideoType, tr("Video"));
-
-    typeStrings.insert(ActivityType, tr("Activity"));
-    typeStrings.insert(ApplicationGroupType, tr("Application Group"));
-    typeStrings.insert(AppActionType, tr("Action"));
-    typeStrings.insert(AppSessionType, tr("Application Session"));
-    typeStrings.insert(DesktopType, tr("Desktop"));
-    typeStrings.insert(UserSessionType, tr("User Session"));
-    typeStrings.insert(WindowType, tr("Window"));
+    typeStrings.resize(WindowType + 1);
+    typeStrings[UnknownType] = tr("Unknown");
+
+    typeStrings[ExecutableType] = tr("Program");
+    typeStrings[FileType] = tr("File");
+    typeStrings[InstallableType] = tr("Package");
+    typeStrings[PathType] = tr("Path");
+
+    typeStrings[FilesystemLocationType] = tr("Location");
+    typeStrings[HardwareType] = tr("Hardware");
+    typeStrings[NetworkLocationType] = tr("Network");
+
+    typeStrings[DateTimeType] = tr("Date and Time");
+    typeStrings[EnvironmentalType] = tr("Environmental");
+    typeStrings[GeolocationType] = tr("Geolocation");
+    typeStrings[LanguageType] = tr("Langauge");
+    typeStrings[MathAndUnitsType] = tr("Math and Units");
+    typeStrings[ReferenceType] = tr("Reference");
+
+    typeStrings[AlbumType] = tr("Album");
+    typeStrings[AudioType] = tr("Audio");
+    typeStrings[BookmarkType] = tr("Bookmark");
+    typeStrings[BookType] = tr("Book");
+    typeStrings[ContactType] = tr("Contact");
+    typeStrings[DocumentType] = tr("Document");
+    typeStrings[EventType] = tr("Event");
+    typeStrings[MagazineType] = tr("Magazine");
+    typeStrings[MessageType] = tr("Message");
+    typeStrings[VideoType] = tr("Video");
+
+    typeStrings[ActivityType] = tr("Activity");
+    typeStrings[ApplicationGroupType] = tr("Application Group");
+    typeStrings[AppActionType] = tr("Action");
+    typeStrings[AppSessionType] = tr("Application Session");
+    typeStrings[DesktopType] = tr("Desktop");
+    typeStrings[UserSessionType] = tr("User Session");
+    typeStrings[WindowType] = tr("Window");
 }
 
 void QuerySession::Private::resetModel()
 {
+    if (headless) {
+        return;
+    }
+
     q->beginResetModel();
     q->endResetModel();
 }
 
 void QuerySession::Private::addingMatches(int start, int end)
 {
-    q->beginInsertRows(QModelIndex(), start, end);
+    ++modelNotifications;
+    if (!headless) {
+        q->beginInsertRows(QModelIndex(), start, end);
+    }
 }
 
 void QuerySession::Private::matchesAdded()
 {
-    q->endInsertRows();
+    if (!headless) {
+        q->endInsertRows();
+    }
 }
 
 void QuerySession::Private::removingMatches(int start, int end)
 {
-    q->beginRemoveRows(QModelIndex(), start, end);
+    ++modelNotifications;
+    if (!headless) {
+        q->beginRemoveRows(QModelIndex(), start, end);
+    }
 }
 
 void QuerySession::Private::matchesRemoved()
 {
-    q->endRemoveRows();
+    if (!headless) {
+        q->endRemoveRows();
+    }
+}
+
+void QuerySession::Private::movingMatch(int from, int to)
+{
+    ++modelNotifications;
+    if (!headless) {
+        q->beginMoveRows(QModelIndex(), from, from, QModelIndex(), to);
+    }
+}
+
+void QuerySession::Private::matchMoved()
+{
+    if (!headless) {
+        q->endMoveRows();
+    }
+}
+
+QuerySession::Private::RoleMask QuerySession::Private::roleBit(int role)
+{
+    return role == Qt::DisplayRole ? 1 : RoleMask(1) << (role - Qt::UserRole + 1);
+}
+
+QuerySession::Private::RoleMask QuerySession::Private::changedRoles(const QueryMatch &from, const QueryMatch &to)
+{
+    if (from == to) {
+        // the same match, possibly altered in place; no telling what changed
+        return AllRoles;
+    }
+
+    RoleMask roles = 0;
+    if (from.title() != to.title()) {
+        roles |= roleBit(Qt::DisplayRole);
+    }
+
+    if (from.text() != to.text()) {
+        roles |= roleBit(TextRole);
+    }
+
+    if (from.d->serial != to.d->serial) {
+        roles |= roleBit(ImageRole);
+    }
+
+    if (from.type() != to.type()) {
+        roles |= roleBit(TypeRole) | roleBit(TypeStringRole);
+    }
+
+    if (from.source() != to.source()) {
+        roles |= roleBit(SourceRole);
+    }
+
+    if (from.precision() != to.precision()) {
+        roles |= roleBit(PrecisionRole);
+    }
+
+    if (from.userData() != to.userData()) {
+        roles |= roleBit(UserDataRole);
+    }
+
+    if (from.data() != to.data()) {
+        roles |= roleBit(DataRole);
+    }
+
+    if (from.d->sessionData != to.d->sessionData) {
+        roles |= roleBit(RunnerRole);
+    }
+
+    if (from.d->id != to.d->id) {
+        roles |= roleBit(IdRole);
+    }
+
+    return roles;
 }
 
-void QuerySession::Private::matchesUpdated(int start, int end)
+void QuerySession::Private::matchesUpdated(int start, int end, RoleMask roles)
 {
-    emit q->dataChanged(q->createIndex(start, 0), q->createIndex(end, roleColumns.count()));
+    if (!roles) {
+        return;
+    }
+
+    if (headless) {
+        ++modelNotifications;
+        return;
+    }
+
+    if (roles == AllRoles) {
+        ++modelNotifications;
+        emit q->dataChanged(q->createIndex(start, 0), q->createIndex(end, roleColumns.count() - 1));
+        return;
+    }
+
+    // QML only looks at the roles, QWidget views at the columns;
+    // give both the least they need to refresh
+    QVector<int> changed;
+    int firstColumn = -1;
+    int lastColumn = 0;
+    for (int column = 0; column < roleColumns.count(); ++column) {
+        const int role = roleColumns[column];
+        if (roles & roleBit(role)) {
+            changed << role;
+            if (role == ImageRole) {
+                changed << Qt::DecorationRole;
+            }
+
+            if (firstColumn < 0) {
+                firstColumn = column;
+            }
+            lastColumn = column;
+        }
+    }
+
+    if (firstColumn < 0) {
+        return;
+    }
+
+    ++modelNotifications;
+    emit q->dataChanged(q->createIndex(start, firstColumn), q->createIndex(end, lastColumn), changed);
 }
 
 void QuerySession::Private::matchesArrived()
 {
     //NOTE: this gets called from non-GUI threads
-    matchesArrivedWhileExecuting = matchesArrivedWhileExecuting ||
-                                   !executingMatches.isEmpty();
-    if (!matchesArrivedWhileExecuting) {
-        QMetaObject::invokeMethod(syncTimer, "startIfStopped");
+
+    // only the first arrival since the last sync started posts anything
+    if (syncRequested.testAndSetOrdered(0, 1)) {
+        QCoreApplication::postEvent(syncScheduler, new QEvent(SyncScheduler::requestEventType()));
     }
 }
 
 void QuerySession::Private::executionFinished(const Sprinter::QueryMatch &match, bool success)
 {
-    // remove the match from the list of matches being executed
-    QMutableHashIterator<int, QueryMatch> it(executingMatches);
-    while (it.hasNext()) {
-        it.next();
-        if (it.value() == match) {
-            const int index = it.key();
-            it.remove();
-            matchesUpdated(index, index);
-            break;
+    // remove the match from the list of matches being executed; it
+    // may have moved or even gone away in the meantime
+    if (executingMatches.remove(match.id())) {
+        const int row = worker->rowForMatchId(match.id());
+        if (row >= 0) {
+            matchesUpdated(row, row, roleBit(ExecutingRole));
         }
     }
-
-    // if we have no matches executing, check if there are matches waiting
-    // synchronization
-    if (executingMatches.isEmpty() && matchesArrivedWhileExecuting) {
-        matchesArrivedWhileExecuting = false;
-        matchesArrived();
-    }
 }
 
 void QuerySession::Private::startMatchSynchronization()
 {
+    // cleared first, so matches arriving during the sync ask for another
+    syncRequested.fetchAndStoreOrdered(0);
+
+    TraceRecorder *trace = worker->trace();
+    const qint64 traceStart = trace->isRecording() ? trace->now() : -1;
+    const int notifications = modelNotifications;
+
     worker->syncMatches();
+
+    if (headless) {
+        headless->matchesSynchronized(modelNotifications != notifications);
+    }
+
+    if (measuringQuery && modelNotifications != notifications) {
+        lastMatchLatency = queryClock.elapsed();
+        // rows of the last query may not all be gone yet
+        if (firstMatchLatency < 0 && worker->currentMatchCount() > 0) {
+            firstMatchLatency = lastMatchLatency;
+            emit q->firstMatchesShown(int(firstMatchLatency));
+        }
+    }
+
+    if (measuringQuery && idleLatency >= 0 && !syncRequested.load()) {
+        // the runners were done and this was the sync they were waiting on
+        queryCompleted();
+    }
+
+    if (traceStart >= 0 && trace->isRecording()) {
+        QVariantMap args;
+        args.insert(QStringLiteral("matches"), worker->matchCount());
+        args.insert(QStringLiteral("notifications"), modelNotifications - notifications);
+        trace->complete("sync", "model", traceStart, args);
+    }
+}
+
+void QuerySession::Private::queryStarted()
+{
+    queryClock.start();
+    measuringQuery = true;
+    firstMatchLatency = lastMatchLatency = idleLatency = -1;
+}
+
+void QuerySession::Private::runnersIdle(int generation)
+{
+    // queued from the worker thread, so possibly for a query since replaced
+    if (generation != worker->generation() || !measuringQuery || idleLatency >= 0) {
+        return;
+    }
+
+    idleLatency = queryClock.elapsed();
+
+    // with matches still waiting to be synced, the last of them are not
+    // visible yet; startMatchSynchronization completes the query then
+    if (!syncRequested.load()) {
+        queryCompleted();
+    }
+}
+
+void QuerySession::Private::queryCompleted()
+{
+    measuringQuery = false;
+
+    if (firstMatchLatency >= 0) {
+        firstMatchLatencies.add(firstMatchLatency);
+    }
+
+    if (lastMatchLatency >= 0) {
+        lastMatchLatencies.add(lastMatchLatency);
+    }
+
+    idleLatencies.add(idleLatency);
+    emit q->queryCompleted(int(firstMatchLatency), int(lastMatchLatency), int(idleLatency));
 }
 
 void QuerySession::Private::askMeAgainSetup()
@@ -206,8 +426,8 @@ void QuerySession::Private::askMeAgainSetup()
     if (askAgainRunners == worker->enabledRunners()) {
         if (askAgainDelayedQuery.isEmpty()) {
             q->requestDefaultMatches();
-        } else {
-            worker->launchQuery(askAgainDelayedQuery);
+        } else if (worker->launchQuery(askAgainDelayedQuery)) {
+            queryStarted();
         }
     }
 
@@ -224,8 +444,12 @@ QuerySession::QuerySession(QObject *parent)
 
 QuerySession::~QuerySession()
 {
-    d->workerThread->exit();
+    // the worker thread is shared, so rather than the thread being
+    // stopped the worker is wound down, and deletes itself afterwards;
+    // the host, and with it the thread, lasts until we let go of it
+    QMetaObject::invokeMethod(d->worker, "shutdown", Qt::BlockingQueuedConnection);
     delete d;
+    RunnerHost::deref();
 }
 
 QAbstractItemModel *QuerySession::runnerModel() const
@@ -233,9 +457,62 @@ QAbstractItemModel *QuerySession::runnerModel() const
     return d->runnerModel;
 }
 
+QVariantMap QuerySession::runnerStatistics(const QString &runnerId) const
+{
+    for (auto const &info: d->worker->runnerMetaData()) {
+        if (info.id == runnerId) {
+            return info.statistics->toMap();
+        }
+    }
+
+    return QVariantMap();
+}
+
+static QVariantMap latencySummary(const LatencySamples &samples, const QVector<qint64> &bounds)
+{
+    QVariantMap summary;
+    summary.insert(QStringLiteral("Samples"), samples.count());
+    if (samples.count() > 0) {
+        summary.insert(QStringLiteral("P50"), samples.percentile(50));
+        summary.insert(QStringLiteral("P95"), samples.percentile(95));
+        summary.insert(QStringLiteral("P99"), samples.percentile(99));
+    }
+
+    QVariantList histogram;
+    for (int count: samples.histogram(bounds)) {
+        histogram << count;
+    }
+    summary.insert(QStringLiteral("Histogram"), histogram);
+    return summary;
+}
+
+QVariantMap QuerySession::queryLatencies() const
+{
+    // powers of two from 8ms to 2s; the last bucket catches the rest
+    static QVector<qint64> s_bounds;
+    if (s_bounds.isEmpty()) {
+        for (qint64 bound = 8; bound <= 2048; bound *= 2) {
+            s_bounds << bound;
+        }
+    }
+
+    QVariantList bounds;
+    for (qint64 bound: s_bounds) {
+        bounds << bound;
+    }
+
+    QVariantMap latencies;
+    latencies.insert(QStringLiteral("HistogramBounds"), bounds);
+    latencies.insert(QStringLiteral("FirstMatch"), latencySummary(d->firstMatchLatencies, s_bounds));
+    latencies.insert(QStringLiteral("LastMatch"), latencySummary(d->lastMatchLatencies, s_bounds));
+    latencies.insert(QStringLiteral("Idle"), latencySummary(d->idleLatencies, s_bounds));
+    return latencies;
+}
+
 void QuerySession::requestDefaultMatches()
 {
-    qDebug() << "Manager, default query:" << QThread::currentThread();
+    d->recorder.record(QueryRecorder::DefaultMatches);
+
     if (!d->askMeAgainResetEnabledRunnersTo.isEmpty()) {
         // the runners were temporarily reset for the "ask me again" feature
         // we now have to re-set it back to what it was earlier
@@ -251,18 +528,20 @@ void QuerySession::requestDefaultMatches()
     }
 
     d->worker->launchDefaultMatches();
+    d->queryStarted();
     emit queryChanged(d->worker->query());
 }
 
 void QuerySession::requestMoreMatches()
 {
-    qDebug() << "Manager, more matches:" << QThread::currentThread();
+    d->recorder.record(QueryRecorder::MoreMatches);
     d->worker->launchMoreMatches();
 }
 
 void QuerySession::setQuery(const QString &query)
 {
-    qDebug() << "Manager:" << QThread::currentThread() << query;
+    d->recorder.record(QueryRecorder::Query, query);
+
     if (!d->askMeAgainResetEnabledRunnersTo.isEmpty()) {
         // the runners were temporarily reset for the "ask me again" feature
         // we now have to re-set it back to what it was earlier
@@ -278,10 +557,78 @@ void QuerySession::setQuery(const QString &query)
     }
 
     if (d->worker->launchQuery(query)) {
+        d->queryStarted();
         emit queryChanged(d->worker->query());
     }
 }
 
+void QuerySession::setFirstMatchDelay(int msecs)
+{
+    if (d->syncScheduler->firstDelay() != msecs) {
+        d->syncScheduler->setFirstDelay(msecs);
+        emit synchronizationChanged();
+    }
+}
+
+int QuerySession::firstMatchDelay() const
+{
+    return d->syncScheduler->firstDelay();
+}
+
+void QuerySession::setSyncInterval(int msecs)
+{
+    if (d->syncScheduler->interval() != msecs) {
+        d->syncScheduler->setInterval(msecs);
+        emit synchronizationChanged();
+    }
+}
+
+int QuerySession::syncInterval() const
+{
+    return d->syncScheduler->interval();
+}
+
+void QuerySession::setWindow(QWindow *window)
+{
+    if (d->syncScheduler->window() != window) {
+        d->syncScheduler->setWindow(window);
+        emit synchronizationChanged();
+    }
+}
+
+QWindow *QuerySession::window() const
+{
+    return d->syncScheduler->window();
+}
+
+void QuerySession::setTraceFile(const QString &path)
+{
+    if (path.isEmpty()) {
+        d->worker->trace()->stop();
+    } else {
+        d->worker->trace()->start(path);
+    }
+}
+
+QString QuerySession::traceFile() const
+{
+    return d->worker->trace()->path();
+}
+
+void QuerySession::setRecordFile(const QString &path)
+{
+    if (path.isEmpty()) {
+        d->recorder.stop();
+    } else {
+        d->recorder.start(path);
+    }
+}
+
+QString QuerySession::recordFile() const
+{
+    return d->recorder.path();
+}
+
 void QuerySession::setImageSize(const QSize &size)
 {
     if (d->worker->setImageSize(size)) {
@@ -296,6 +643,8 @@ QSize QuerySession::imageSize() const
 
 void QuerySession::executeMatch(int index)
 {
+    d->recorder.record(QueryRecorder::Execute, QString::number(index));
+
     const QueryMatch &match = d->worker->matchAt(index);
 
     if (!match.isValid()) {
@@ -319,16 +668,12 @@ void QuerySession::executeMatch(int index)
         return;
     }
 
-    QHashIterator<int, QueryMatch> it(d->executingMatches);
-    while (it.hasNext()) {
-        it.next();
-        if (it.value() == match) {
-            return;
-        }
+    if (d->executingMatches.contains(match.id())) {
+        return;
     }
 
-    d->executingMatches.insert(index, match);
-    d->matchesUpdated(index, index);
+    d->executingMatches.insert(match.id(), match);
+    d->matchesUpdated(index, index, Private::roleBit(ExecutingRole));
     ExecRunnable *exec = new ExecRunnable(match);
     connect(exec, SIGNAL(finished(Sprinter::QueryMatch,bool)),
             this, SLOT(executionFinished(Sprinter::QueryMatch,bool)));
@@ -342,7 +687,8 @@ void QuerySession::executeMatch(const QModelIndex &index)
 
 void QuerySession::halt()
 {
-    d->matchesArrivedWhileExecuting = false;
+    d->recorder.record(QueryRecorder::Halt);
+    d->measuringQuery = false;
     d->worker->endQuerySession();
 }
 
@@ -351,6 +697,19 @@ QString QuerySession::query() const
     return d->worker->query();
 }
 
+QImage QuerySession::matchImage(const QString &id)
+{
+    bool ok = false;
+    const quint64 serial = id.section(QLatin1Char('/'), 0, 0).toULongLong(&ok);
+    if (!ok) {
+        return QImage();
+    }
+
+    QMutexLocker lock(&s_matchImagesLock);
+    QImage *image = s_matchImages.object(serial);
+    return image ? *image : QImage();
+}
+
 int QuerySession::columnCount(const QModelIndex &parent) const
 {
     if (parent.isValid()) {
@@ -382,12 +741,8 @@ QVariant QuerySession::data(const QModelIndex &index, int role) const
         asText = true;
         role = d->roleColumns[index.column()];
     } else if (index.column() == d->imageRoleColumn && role == Qt::DecorationRole) {
-        role = ImageRole;
-    }
-
-    // short circuit for execution; don't need the QueryMatch object
-    if (role == ExecutingRole) {
-        return d->executingMatches.contains(index.row());
+        // QWidget views get the image itself
+        return d->worker->matchAt(index.row()).image();
     }
 
     const QueryMatch &match = d->worker->matchAt(index.row());
@@ -399,9 +754,13 @@ QVariant QuerySession::data(const QModelIndex &index, int role) const
         case TextRole:
             return match.text();
             break;
-        case ImageRole:
-            return match.image();
+        case ImageRole: {
+            const QImage image = match.image();
+            if (!image.isNull()) {
+                return registerMatchImage(match.d->serial, image);
+            }
             break;
+        }
         case TypeRole:
             if (asText) {
                 return textForEnum(this, "MatchType", match.type());
@@ -409,9 +768,11 @@ QVariant QuerySession::data(const QModelIndex &index, int role) const
                 return match.type();
             }
             break;
-        case TypeStringRole:
-            return d->typeStrings[match.type()];
+        case TypeStringRole: {
+            const int type = match.type();
+            return d->typeStrings[type >= 0 && type < d->typeStrings.size() ? type : UnknownType];
             break;
+        }
         case SourceRole:
             if (asText) {
                 return textForEnum(this, "MatchSource", match.source());
@@ -439,6 +800,12 @@ QVariant QuerySession::data(const QModelIndex &index, int role) const
             }
             break;
         }
+        case ExecutingRole:
+            return d->executingMatches.contains(match.id());
+            break;
+        case IdRole:
+            return match.id();
+            break;
         default:
             break;
     }
@@ -485,6 +852,8 @@ QVariant QuerySession::headerData(int section, Qt::Orientation orientation, int
                 break;
             case ExecutingRole:
                 return tr("Executing");
+            case IdRole:
+                return tr("ID");
             default:
                 break;
         }
@@ -24,6 +24,8 @@
 #include <sprinter/sprinter_export.h>
 
 #include <QAbstractItemModel>
+#include <QImage>
+#include <QWindow>
 
 namespace Sprinter
 {
@@ -37,6 +39,9 @@ class SPRINTER_EXPORT QuerySession : public QAbstractItemModel
     Q_PROPERTY(QAbstractItemModel *runnerModel READ runnerModel CONSTANT)
     Q_PROPERTY(QSize imageSize WRITE setImageSize READ imageSize NOTIFY imageSizeChanged)
     Q_PROPERTY(QSize ImageSize WRITE setImageSize READ imageSize NOTIFY imageSizeChanged)
+    Q_PROPERTY(int firstMatchDelay WRITE setFirstMatchDelay READ firstMatchDelay NOTIFY synchronizationChanged)
+    Q_PROPERTY(int syncInterval WRITE setSyncInterval READ syncInterval NOTIFY synchronizationChanged)
+    Q_PROPERTY(QWindow *window WRITE setWindow READ window NOTIFY synchronizationChanged)
 
 public:
     enum DisplayRoles {
@@ -50,7 +55,8 @@ public:
         UserDataRole,
         DataRole,
         RunnerRole,
-        ExecutingRole
+        ExecutingRole,
+        IdRole
     };
     Q_ENUMS(DisplayRoles)
 
@@ -138,6 +144,22 @@ public:
      *   SourcesUsedRole: the sources used by the runner for generating matches
      *                   @see QuerySession::MatchSource
      *
+     * It also provides these statistics, gathered over the lifetime of the
+     * session and updated whenever the runner starts or finishes matching.
+     * Times are in milliseconds and invalid until first measured:
+     *   SessionDataTimeRole: how long creating the runner's session data took
+     *   MatchLatencyP50Role, MatchLatencyP95Role, MatchLatencyP99Role:
+     *                   percentiles of how long recent match runs took
+     *   TimeToFirstMatchRole: the median time from a query starting to the
+     *                         runner's first matches for it, over recent queries
+     *   MatchesProducedRole: how many matches the runner has handed over
+     *   MatchesDisplayedRole: how many of those made it into the model
+     *   MatchRunsRole: how many times the runner was asked to match
+     *   CancellationsRole: how many of those runs outlived their query
+     *   CpuTimeRole: the CPU time spent by the runner in its match runs
+     *   StaleResultsRole: how many times the runner handed over matches
+     *                     for a query that was no longer current
+     *
      * Additionally, the model provides control over the runners with
      * the following properties and methods which are available via the
      * QProperty sytem to both C++ and QML users:
@@ -150,6 +172,30 @@ public:
      **/
     QAbstractItemModel *runnerModel() const;
 
+    /**
+     * The statistics of a runner as also found in the runner model, in a
+     * form convenient for reporting: the keys are the names of the roles
+     * without the "Role" suffix, e.g. "MatchLatencyP95".
+     * @param runnerId the id of the runner
+     * @return the statistics, or an empty map if there is no such runner
+     */
+    Q_INVOKABLE QVariantMap runnerStatistics(const QString &runnerId) const;
+
+    /**
+     * How long recent queries took to show up, measured from setQuery (or
+     * requestDefaultMatches) to:
+     *   FirstMatch: the first model update which left matches in the model
+     *   LastMatch: the last model update before the query completed
+     *   Idle: all the runners asked to match having finished
+     * Each of these is a map with the number of queries measured
+     * ("Samples"), the "P50", "P95" and "P99" percentiles in milliseconds,
+     * and a "Histogram" of counts per bucket. The buckets' upper bounds
+     * are listed in "HistogramBounds", with one more bucket beyond those.
+     * Only the most recent queries are kept.
+     * @see firstMatchesShown @see queryCompleted
+     */
+    Q_INVOKABLE QVariantMap queryLatencies() const;
+
     /**
      * Returns the current query string
      * @see setQuery
@@ -168,6 +214,97 @@ public:
      */
     QSize imageSize() const;
 
+    /**
+     * Sets how long to wait before showing the first matches of a query,
+     * i.e. while the model is empty. Defaults to 0, which shows them as
+     * soon as they arrive.
+     * @param msecs the delay in milliseconds
+     */
+    void setFirstMatchDelay(int msecs);
+
+    /**
+     * @return the delay before the first matches are shown
+     */
+    int firstMatchDelay() const;
+
+    /**
+     * Sets the minimum time between two updates of the model once it has
+     * matches. Matches arriving more often than this are coalesced, while
+     * matches arriving less often are shown right away. Defaults to 16ms.
+     * @param msecs the interval in milliseconds
+     */
+    void setSyncInterval(int msecs);
+
+    /**
+     * @return the minimum time between two updates of the model
+     */
+    int syncInterval() const;
+
+    /**
+     * Sets the window the model is shown in. If it is a QQuickWindow, model
+     * updates are aligned with its frames so that there is at most one per
+     * frame; other windows are ignored.
+     * @param window the window, or 0 to update on a timer only
+     */
+    void setWindow(QWindow *window);
+
+    /**
+     * @return the window model updates are aligned with, if any
+     */
+    QWindow *window() const;
+
+    /**
+     * Records a timeline of what happens in the session, such as when each
+     * runner is asked to match and how long it takes, when matches arrive
+     * and how long synchronizing them into the model takes. It is written
+     * to the file as Chrome trace events, viewable in chrome://tracing or
+     * ui.perfetto.dev. Recording may also be started by setting the
+     * SPRINTER_TRACE_FILE environment variable to a file path; each session
+     * then records to that path followed by .<process id>-<session number>.
+     * @param path the file to write to, replacing its contents; an empty
+     *        path stops recording and finishes the file
+     */
+    void setTraceFile(const QString &path);
+
+    /**
+     * @return the file being recorded to, or an empty string if not recording
+     */
+    QString traceFile() const;
+
+    /**
+     * Records what is asked of the session and when, so that it can be
+     * replayed later with the same timing, e.g. to reproduce a slow
+     * session from the field. Each line of the file is one event: the
+     * milliseconds since recording started, then one of
+     *   query <percent encoded query string>
+     *   more
+     *   default
+     *   exec <row>
+     *   halt
+     * separated by single spaces. Lines starting with # are comments.
+     * Recording may also be started by setting the SPRINTER_RECORD_FILE
+     * environment variable to a file path; each session then records to
+     * that path followed by .<process id>-<session number>.
+     * @param path the file to write to, replacing its contents; an empty
+     *        path stops recording
+     */
+    void setRecordFile(const QString &path);
+
+    /**
+     * @return the file being recorded to, or an empty string if not recording
+     */
+    QString recordFile() const;
+
+    /**
+     * The ImageRole provides images as image://sprinter/<match-id>/<size>
+     * URLs so that QML can load and cache them without passing the image
+     * through the model. This returns the image for such a URL's id, e.g.
+     * from a QQuickImageProvider. It is safe to call from any thread.
+     * @param id the part of the URL after image://sprinter/
+     * @return the image, or a null image if it is no longer available
+     */
+    static QImage matchImage(const QString &id);
+
 public Q_SLOTS:
     /**
      * @return the type of a given index, UnknownType if the index does not exist
@@ -242,6 +379,29 @@ Q_SIGNALS:
      */
     void imageSizeChanged(const QSize &size);
 
+    /**
+     * Emitted when firstMatchDelay, syncInterval or window change
+     */
+    void synchronizationChanged();
+
+    /**
+     * Emitted when matches for a query first appear in the model
+     * @param msecs the time since the query was set
+     */
+    void firstMatchesShown(int msecs);
+
+    /**
+     * Emitted once the runners have finished matching a query and their
+     * matches have been synchronized into the model
+     * @param firstMatchMsecs the time from the query being set until
+     *        matches first appeared in the model, or -1 if none did
+     * @param lastMatchMsecs the time until the last model update for the
+     *        query, or -1 if there was none
+     * @param idleMsecs the time until the runners were done
+     * @see queryLatencies
+     */
+    void queryCompleted(int firstMatchMsecs, int lastMatchMsecs, int idleMsecs);
+
 public:
     // The reimplemented model API follows below:
     /**
@@ -302,6 +462,7 @@ public:
 private:
     // these methods are for RunnserSessionData class (e.g. in syncMatches) only
     friend class RunnerSessionData;
+    friend class HeadlessSessionPrivate;
 
     class Private;
     friend class Private;
@@ -311,6 +472,7 @@ private:
     Q_PRIVATE_SLOT(d, void resetModel());
     Q_PRIVATE_SLOT(d, void executionFinished(const Sprinter::QueryMatch &match, bool success));
     Q_PRIVATE_SLOT(d, void askMeAgainSetup());
+    Q_PRIVATE_SLOT(d, void runnersIdle(int));
 };
 
 } // namespace
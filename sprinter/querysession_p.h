@@ -21,14 +21,22 @@
 #ifndef RUNNERMANAGER_PRIVATE
 #define RUNNERMANAGER_PRIVATE
 
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+#include "queryrecorder_p.h"
+#include "runnerstatistics_p.h"
+
 namespace Sprinter
 {
 
+class HeadlessSessionPrivate;
 class QuerySession;
 class QueryMatch;
 class QuerySessionThread;
+class RunnerHost;
 class RunnerModel;
-class NonRestartingTimer;
+class SyncScheduler;
 
 class QuerySession::Private
 {
@@ -39,25 +47,62 @@ public:
     void matchesAdded();
     void removingMatches(int start, int end);
     void matchesRemoved();
-    void matchesUpdated(int start, int end);
+    void movingMatch(int from, int to);
+    void matchMoved();
+    // changed roles are collected as bits: bit 0 for Qt::DisplayRole
+    // and bit n + 1 for the role Qt::UserRole + n
+    typedef quint32 RoleMask;
+    static const RoleMask AllRoles = ~RoleMask(0);
+    static RoleMask roleBit(int role);
+    static RoleMask changedRoles(const QueryMatch &from, const QueryMatch &to);
+    void matchesUpdated(int start, int end, RoleMask roles);
     void matchesArrived();
     void resetModel();
     void executionFinished(const Sprinter::QueryMatch &match, bool success);
     void startMatchSynchronization();
     void askMeAgainSetup();
     void fillTypeStringSet();
+    void queryStarted();
+    void runnersIdle(int generation);
+    void queryCompleted();
 
     QuerySession *q;
-    QThread *workerThread;
+    // held until the session is gone; declared first, as the worker needs it
+    RunnerHost *host;
     QuerySessionThread *worker;
     RunnerModel *runnerModel;
-    NonRestartingTimer *syncTimer;
+    SyncScheduler *syncScheduler;
     QHash<int, QByteArray> roles;
     QVector<int> roleColumns;
-    QHash<int, QueryMatch> executingMatches;
-    QHash<MatchType, QString> typeStrings;
+    // keyed by QueryMatch::id, so rows may move while matches execute
+    QHash<quint64, QueryMatch> executingMatches;
+    // indexed by MatchType
+    QVector<QString> typeStrings;
     int imageRoleColumn;
-    bool matchesArrivedWhileExecuting;
+    // set when the session is driven by a HeadlessSession: no model
+    // notifications are emitted and it is told about every sync instead
+    HeadlessSessionPrivate *headless;
+    // rows inserted, removed or moved and dataChanged emitted, for tracing
+    int modelNotifications;
+
+    // matchesArrived is called from runner threads; this is set from
+    // the first arrival until the sync starts
+    QAtomicInt syncRequested;
+
+    // how long it takes for a query to show up, from the moment it is
+    // set to the first and last model updates, in milliseconds; -1 until
+    // known. Only accessed in the GUI thread
+    QElapsedTimer queryClock;
+    bool measuringQuery;
+    qint64 firstMatchLatency;
+    qint64 lastMatchLatency;
+    qint64 idleLatency;
+    LatencySamples firstMatchLatencies;
+    LatencySamples lastMatchLatencies;
+    LatencySamples idleLatencies;
+
+    // what the user asked for and when, for replaying the session later
+    QueryRecorder recorder;
 
     // suppor for 'ask me again' feature
     QStringList askMeAgainResetEnabledRunnersTo;
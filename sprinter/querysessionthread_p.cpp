@@ -20,32 +20,40 @@
 
 #include "querysessionthread_p.h"
 
+#include <QAtomicInt>
+#include <QAtomicInteger>
 #include <QCoreApplication>
 #include <QDebug>
 #include <QDir>
 #include <QJsonArray>
 #include <QMetaEnum>
+#include <QPair>
 #include <QPluginLoader>
 #include <QReadLocker>
 #include <QThreadPool>
 #include <QTimer>
 #include <QTime>
+#include <QWindow>
 #include <QWriteLocker>
 
 #include "runner.h"
 #include "runner_p.h"
+#include "networkmonitor_p.h"
 #include "querycontext_p.h"
 #include "querysession.h"
 #include "runnersessiondata_p.h"
+#include "stringatoms_p.h"
+#include "tracerecorder_p.h"
+#include "tracing_p.h"
 
-#define DEBUG_THREADING
-#define DEBUG_PLUGIN_DISCOVERY
+// #define DEBUG_THREADING
+// #define DEBUG_PLUGIN_DISCOVERY
 
 #ifdef DEBUG_THREADING
     #define CHECK_IS_WORKER_THREAD \
-        Q_ASSERT_X(QThread::currentThread() != QCoreApplication::instance()->thread(), "QeST thread check", "should be in worker thread, is not");
+        Q_ASSERT_X(QThread::currentThread() != guiThread(), "QeST thread check", "should be in worker thread, is not");
     #define CHECK_IS_GUI_THREAD \
-        Q_ASSERT_X(QThread::currentThread() == QCoreApplication::instance()->thread(), "QeST thread check", "should be in GUI thread, is not");
+        Q_ASSERT_X(QThread::currentThread() == guiThread(), "QeST thread check", "should be in GUI thread, is not");
 #else
     #define CHECK_IS_WORKER_THREAD
     #define CHECK_IS_GUI_THREAD
@@ -54,6 +62,9 @@
 namespace Sprinter
 {
 
+// sessions tracing to SPRINTER_TRACE_FILE so far in this process
+static QAtomicInt s_envTraces(0);
+
 int enumForText(const QObject *obj, const char *enumName, const QString &key)
 {
     QMetaEnum e = obj->metaObject()->enumerator(obj->metaObject()->indexOfEnumerator(enumName));
@@ -62,32 +73,80 @@ int enumForText(const QObject *obj, const char *enumName, const QString &key)
 
 QString textForEnum(const QObject *obj, const char *enumName, int value)
 {
+    // this is called for every row and column of a model that is asked
+    // for text, so the strings are built once per enum and then shared.
+    // enumName is practically always a literal, so its address is the key
+    typedef QPair<const QMetaObject *, const char *> EnumKey;
+    static QReadWriteLock s_lock;
+    static QHash<EnumKey, QHash<int, QString> > s_texts;
+    static const QString s_unknown = QStringLiteral("Unknown");
+
+    const EnumKey key(obj->metaObject(), enumName);
+    {
+        QReadLocker lock(&s_lock);
+        QHash<EnumKey, QHash<int, QString> >::const_iterator it = s_texts.constFind(key);
+        if (it != s_texts.constEnd()) {
+            return it.value().value(value, s_unknown);
+        }
+    }
+
+    QHash<int, QString> texts;
     QMetaEnum e = obj->metaObject()->enumerator(obj->metaObject()->indexOfEnumerator(enumName));
-    QLatin1String text(e.valueToKey(value));
-    if (text.size() < 1) {
-        return QStringLiteral("Unknown");
+    for (int i = 0; i < e.keyCount(); ++i) {
+        texts.insert(e.value(i), QLatin1String(e.key(i)));
     }
 
-    return text;
+    QWriteLocker lock(&s_lock);
+    s_texts.insert(key, texts);
+    return texts.value(value, s_unknown);
+}
+
+static quint64 createSessionId()
+{
+    static QAtomicInteger<quint64> s_lastSessionId;
+    return s_lastSessionId.fetchAndAddRelaxed(1) + 1;
 }
 
 QuerySessionThread::QuerySessionThread(QuerySession *session)
     : QObject(0),
-      m_threadPool(new QThreadPool(this)),
+      m_threadPool(RunnerHost::instance()->threadPool()),
       m_session(session),
       m_dummySessionData(new RunnerSessionData(0)),
       m_runnerBookmark(0),
       m_currentRunner(0),
-      m_sessionId(QUuid::createUuid()),
+      m_sessionId(createSessionId()),
       m_restartMatchingTimer(new QTimer(this)),
-      m_matchCount(-1)
+      m_matchCount(-1),
+      m_idRowsValid(false),
+      m_generation(1),
+      m_idleDue(0),
+      m_dispatchedGeneration(0),
+      m_trace(new TraceRecorder)
 {
+    const QString tracePath = QString::fromLocal8Bit(qgetenv("SPRINTER_TRACE_FILE"));
+    if (!tracePath.isEmpty()) {
+        // as with SPRINTER_RECORD_FILE, each session gets a file of its
+        // own rather than overwriting those of the others
+        m_trace->start(QStringLiteral("%1.%2-%3").arg(tracePath)
+                       .arg(QCoreApplication::applicationPid())
+                       .arg(s_envTraces.fetchAndAddRelaxed(1) + 1));
+    }
+
     m_restartMatchingTimer->setInterval(50);
     m_restartMatchingTimer->setSingleShot(true);
     connect(this, SIGNAL(continueMatching()),
             m_restartMatchingTimer, SLOT(start()));
     connect(m_restartMatchingTimer, SIGNAL(timeout()),
             this, SLOT(startMatching()));
+
+    // the monitor belongs to the main thread; sessions living elsewhere
+    // (see HeadlessSession) use it if the main thread has created it
+    NetworkMonitor *monitor = QThread::currentThread() == QCoreApplication::instance()->thread() ?
+                              NetworkMonitor::instance() : NetworkMonitor::existingInstance();
+    if (monitor) {
+        connect(monitor, SIGNAL(onlineChanged(bool)),
+                this, SLOT(networkStateChanged(bool)));
+    }
 }
 
 QuerySessionThread::~QuerySessionThread()
@@ -97,16 +156,41 @@ QuerySessionThread::~QuerySessionThread()
         clearSessionData();
     }
 
-    m_sessionDataThread->exit();
-    m_sessionDataThread = 0;
+    // runnables still in flight record into the trace
+    m_runnables.waitForDone();
+    delete m_trace;
+}
+
+void QuerySessionThread::shutdown()
+{
+    CHECK_IS_WORKER_THREAD
+
+    m_restartMatchingTimer->stop();
+    NetworkMonitor *monitor = NetworkMonitor::existingInstance();
+    if (monitor) {
+        disconnect(monitor, 0, this, 0);
+    }
+
+    {
+        QWriteLocker lock(&m_matchIndexLock);
+        startNewSession();
+        clearSessionData();
+        m_matchers.fill(0);
+    }
+
+    // nothing can be queued for us after this but session data that
+    // was already on its way, which sessionDataRetrieved drops
+    m_runnables.waitForDone();
+    m_session = 0;
+    deleteLater();
 }
 
 void QuerySessionThread::syncMatches()
 {
     CHECK_IS_GUI_THREAD
-//     QTime t;
-//     t.start();
+    SPRINTER_TRACE(sync_begin);
     m_matchCount = -1;
+    m_idRowsValid = false;
 
     int offset = 0;
     for (auto const &data: m_sessionData) {
@@ -115,7 +199,36 @@ void QuerySessionThread::syncMatches()
         }
     }
     m_matchCount = offset;
-//     qDebug() << "synchronization took" << t.elapsed();
+    SPRINTER_TRACE1(sync_end, offset);
+}
+
+int QuerySessionThread::currentMatchCount() const
+{
+    CHECK_IS_GUI_THREAD
+
+    int count = 0;
+    for (auto const &data: m_sessionData) {
+        if (data && data->d->syncedContext.isValid(data.data())) {
+            count += data->d->syncedMatches.size();
+        }
+    }
+
+    return count;
+}
+
+QVector<QueryMatch> QuerySessionThread::matches() const
+{
+    CHECK_IS_GUI_THREAD
+
+    QVector<QueryMatch> all;
+    all.reserve(matchCount());
+    for (auto const &data: m_sessionData) {
+        if (data) {
+            all += data->d->syncedMatches;
+        }
+    }
+
+    return all;
 }
 
 int QuerySessionThread::matchCount() const
@@ -166,6 +279,30 @@ const QueryMatch &QuerySessionThread::matchAt(int index)
     return m_dummyMatch;
 }
 
+int QuerySessionThread::rowForMatchId(quint64 id)
+{
+    CHECK_IS_GUI_THREAD
+
+    if (!m_idRowsValid) {
+        m_idRows.clear();
+        int row = 0;
+        for (auto const &data: m_sessionData) {
+            if (!data) {
+                continue;
+            }
+
+            const QVector<QueryMatch> &matches = data->d->syncedMatches;
+            for (int i = 0; i < matches.size(); ++i) {
+                m_idRows.insert(matches[i].id(), row++);
+            }
+        }
+
+        m_idRowsValid = true;
+    }
+
+    return m_idRows.value(id, -1);
+}
+
 const QVector<RunnerMetaData> &QuerySessionThread::runnerMetaData() const
 {
      return m_runnerMetaData;
@@ -182,11 +319,14 @@ void QuerySessionThread::loadRunnerMetaData()
     t.start();
 #endif
 
-    m_sessionId = QUuid::createUuid();
-    m_context.d->sessionId = m_sessionId;
+    {
+        QWriteLocker lock(&m_matchIndexLock);
+        startNewSession();
+    }
 
     m_runners.clear();
     m_enabledRunnerIds.clear();
+    m_enabledRunnerAtoms.clear();
 
     {
         QWriteLocker lock(&m_matchIndexLock);
@@ -194,106 +334,51 @@ void QuerySessionThread::loadRunnerMetaData()
         m_matchers.clear();
     }
 
-    QHash<QString, int> seenIds;
-    const QStringList langs = QLocale::system().uiLanguages();
-    for (auto const &path: QCoreApplication::instance()->libraryPaths()) {
-        if (path.endsWith(QLatin1String("plugins"))) {
-            QDir pluginDir(path);
-            if (!pluginDir.cd(QStringLiteral("sprinter"))) {
+    // with the set of runners changing entirely, nothing carries over
+    emit resetModel();
+
+    // the plugins are only scanned for by the first session
+    if (RunnerHost::instance()->metaData(m_runnerMetaData)) {
+        for (auto const &md: m_runnerMetaData) {
+            m_enabledRunnerIds << md.id;
+        }
+    } else {
+        QHash<QString, int> seenIds;
+        const QStringList langs = QLocale::system().uiLanguages();
+
+        // runners linked into the application; anything without Sprinter
+        // metadata is some other kind of plugin
+        for (auto const &plugin: QPluginLoader::staticPlugins()) {
+            const QJsonObject pluginMetaData = plugin.metaData();
+            if (!pluginMetaData[QStringLiteral("MetaData")].toObject().contains(QStringLiteral("Sprinter"))) {
                 continue;
             }
-            for (auto const &fileName: pluginDir.entryList(QDir::Files)) {
-                const QString path = pluginDir.absoluteFilePath(fileName);
-                QPluginLoader loader(path);
-
-                RunnerMetaData md;
-                md.library = path;
-                md.id = loader.metaData()[QStringLiteral("IID")].toString();
-                if (md.id.isEmpty()) {
-                    qDebug() << "Invalid plugin, no metadata:" << path;
-                    continue;
-                }
 
-                int replaceIndex = -1;
-                if (seenIds.contains(md.id)) {
-                    replaceIndex = seenIds.value(md.id);
-                    Q_ASSERT(replaceIndex <= m_runnerMetaData.size());
-                    qDebug() << "Duplicate plugin id" << md.id << replaceIndex << m_runnerMetaData.size();
-                    qDebug() << "    replacing plugin at "
-                             << m_runnerMetaData[replaceIndex].library
-                             << "with" << path;
-                }
-// qDebug() << "FOUND:" << md.id << md.library;
-                const QJsonObject json = loader.metaData()[QStringLiteral("MetaData")].toObject();
-
-                QJsonObject info = json[QStringLiteral("PluginInfo")].toObject();
-                if (!info.isEmpty()) {
-                    const QJsonObject desc = info[QStringLiteral("Description")].toObject();
-                    for (auto const &lang: langs) {
-                        if (desc.contains(lang)) {
-                            const QJsonObject langObj = desc[lang].toObject();
-                            md.name = langObj["Name"].toString();
-                            md.description = langObj["Comment"].toString();
-                            break;
-                        } else if (lang.contains('-')) {
-                            const QString shortLang = lang.left(lang.indexOf('-'));
-                            if (desc.contains(shortLang)) {
-                                const QJsonObject langObj = desc[shortLang].toObject();
-                                md.name = langObj["Name"].toString();
-                                md.description = langObj["Comment"].toString();
-                                break;
-                            }
-                        }
-                    }
-
-                    md.icon = info[QStringLiteral("Icon")].toString();
-                    md.license = info["License"].toString();
-                    md.version = info[QStringLiteral("Version")].toString();
-
-                    const QJsonArray authors = info[QStringLiteral("Authors")].toArray();
-                    QStringList authorStrings;
-                    for (int i = 0; i < authors.size(); ++i) {
-                        authorStrings << authors[i].toString();
-                    }
-                    md.author = authorStrings.join(',');
-
-                    QJsonObject contact = info[QStringLiteral("Contacts")].toObject();
-                    md.contactEmail = contact[QStringLiteral("Email")].toString();
-                    md.contactWebsite = contact[QStringLiteral("Website")].toString();
-                }
+            RunnerMetaData md;
+            md.staticInstance = plugin.instance;
+            addRunnerMetaData(md, pluginMetaData, langs, seenIds);
+        }
 
-                info = json[QStringLiteral("Sprinter")].toObject();
-                if (!info.isEmpty()) {
-                    md.generatesDefaultMatches = info[QStringLiteral("GeneratesDefaultMatches")].toBool();
-
-                    const QJsonArray matchSources = info[QStringLiteral("MatchSources")].toArray();
-                    for (auto const &matchSource: matchSources) {
-                        int val = enumForText(m_session, "MatchSource", matchSource.toString());
-                        if (val != -1) {
-                            md.sourcesUsed << (QuerySession::MatchSource)val;
-                        }
-                    }
-
-                    const QJsonArray matchTypes = info[QStringLiteral("MatchTypes")].toArray();
-                    for (auto const &matchType: matchTypes) {
-                        int val = enumForText(m_session, "MatchType", matchType.toString());
-                        if (val != -1) {
-                            md.matchTypesGenerated << (QuerySession::MatchType)val;
-                        }
-                    }
+        for (auto const &path: QCoreApplication::instance()->libraryPaths()) {
+            if (path.endsWith(QLatin1String("plugins"))) {
+                QDir pluginDir(path);
+                if (!pluginDir.cd(QStringLiteral("sprinter"))) {
+                    continue;
                 }
-
-                if (replaceIndex > -1) {
-                    m_runnerMetaData[replaceIndex] = md;
-                } else {
-                    seenIds.insert(md.id, m_runnerMetaData.size());
-                    m_runnerMetaData << md;
-                    m_enabledRunnerIds << md.id;
+                for (auto const &fileName: pluginDir.entryList(QDir::Files)) {
+                    RunnerMetaData md;
+                    md.library = pluginDir.absoluteFilePath(fileName);
+                    QPluginLoader loader(md.library);
+                    addRunnerMetaData(md, loader.metaData(), langs, seenIds);
                 }
             }
         }
+
+        RunnerHost::instance()->setMetaData(m_runnerMetaData);
     }
 
+    m_enabledRunnerAtoms = StringAtoms::atomSet(m_enabledRunnerIds);
+
     emit loadedRunnerMetaData();
 
     QWriteLocker lock(&m_matchIndexLock);
@@ -302,12 +387,102 @@ void QuerySessionThread::loadRunnerMetaData()
     m_runners.resize(m_runnerMetaData.size());
     m_sessionData.resize(m_runnerMetaData.size());
     m_matchers.resize(m_runnerMetaData.size());
+    m_matcherGenerations.fill(0, m_runnerMetaData.size());
+    m_matcherRunning.fill(false, m_runnerMetaData.size());
 
 #ifdef DEBUG_PLUGIN_DISCOVERY
    qDebug() << m_runnerMetaData.count() << "runner plugins found" << "in" << t.elapsed() << "ms";
 #endif
 }
 
+void QuerySessionThread::addRunnerMetaData(RunnerMetaData &md, const QJsonObject &pluginMetaData,
+                                           const QStringList &langs, QHash<QString, int> &seenIds)
+{
+    md.id = pluginMetaData[QStringLiteral("IID")].toString();
+    if (md.id.isEmpty()) {
+        qDebug() << "Invalid plugin, no metadata:" << md.library;
+        return;
+    }
+    md.idAtom = StringAtoms::intern(md.id);
+
+    int replaceIndex = -1;
+    if (seenIds.contains(md.id)) {
+        replaceIndex = seenIds.value(md.id);
+        Q_ASSERT(replaceIndex <= m_runnerMetaData.size());
+        qDebug() << "Duplicate plugin id" << md.id << replaceIndex << m_runnerMetaData.size();
+        qDebug() << "    replacing plugin at "
+                 << m_runnerMetaData[replaceIndex].library
+                 << "with" << md.library;
+    }
+// qDebug() << "FOUND:" << md.id << md.library;
+    const QJsonObject json = pluginMetaData[QStringLiteral("MetaData")].toObject();
+
+    QJsonObject info = json[QStringLiteral("PluginInfo")].toObject();
+    if (!info.isEmpty()) {
+        const QJsonObject desc = info[QStringLiteral("Description")].toObject();
+        for (auto const &lang: langs) {
+            if (desc.contains(lang)) {
+                const QJsonObject langObj = desc[lang].toObject();
+                md.name = langObj["Name"].toString();
+                md.description = langObj["Comment"].toString();
+                break;
+            } else if (lang.contains('-')) {
+                const QString shortLang = lang.left(lang.indexOf('-'));
+                if (desc.contains(shortLang)) {
+                    const QJsonObject langObj = desc[shortLang].toObject();
+                    md.name = langObj["Name"].toString();
+                    md.description = langObj["Comment"].toString();
+                    break;
+                }
+            }
+        }
+
+        md.icon = info[QStringLiteral("Icon")].toString();
+        md.license = info["License"].toString();
+        md.version = info[QStringLiteral("Version")].toString();
+
+        const QJsonArray authors = info[QStringLiteral("Authors")].toArray();
+        QStringList authorStrings;
+        for (int i = 0; i < authors.size(); ++i) {
+            authorStrings << authors[i].toString();
+        }
+        md.author = authorStrings.join(',');
+
+        QJsonObject contact = info[QStringLiteral("Contacts")].toObject();
+        md.contactEmail = contact[QStringLiteral("Email")].toString();
+        md.contactWebsite = contact[QStringLiteral("Website")].toString();
+    }
+
+    info = json[QStringLiteral("Sprinter")].toObject();
+    if (!info.isEmpty()) {
+        md.generatesDefaultMatches = info[QStringLiteral("GeneratesDefaultMatches")].toBool();
+
+        const QJsonArray matchSources = info[QStringLiteral("MatchSources")].toArray();
+        for (auto const &matchSource: matchSources) {
+            int val = enumForText(m_session, "MatchSource", matchSource.toString());
+            if (val != -1) {
+                md.sourcesUsed << (QuerySession::MatchSource)val;
+            }
+        }
+
+        const QJsonArray matchTypes = info[QStringLiteral("MatchTypes")].toArray();
+        for (auto const &matchType: matchTypes) {
+            int val = enumForText(m_session, "MatchType", matchType.toString());
+            if (val != -1) {
+                md.matchTypesGenerated << (QuerySession::MatchType)val;
+            }
+        }
+    }
+
+    if (replaceIndex > -1) {
+        m_runnerMetaData[replaceIndex] = md;
+    } else {
+        seenIds.insert(md.id, m_runnerMetaData.size());
+        m_runnerMetaData << md;
+        m_enabledRunnerIds << md.id;
+    }
+}
+
 void QuerySessionThread::loadRunner(int index)
 {
     CHECK_IS_WORKER_THREAD
@@ -320,10 +495,9 @@ void QuerySessionThread::loadRunner(int index)
         return;
     }
 
-    const QString path = m_runnerMetaData[index].library;
-    QPluginLoader loader(path);
-    QObject *plugin = loader.instance();
-    Runner *runner = qobject_cast<Runner *>(plugin);
+    // runners are shared by all sessions and only loaded by the first
+    QString error;
+    Runner *runner = RunnerHost::instance()->runner(m_runnerMetaData[index], error);
     if (runner) {
         m_runnerMetaData[index].busy = false;
         m_runnerMetaData[index].fetchedSessionData = false;
@@ -335,16 +509,19 @@ void QuerySessionThread::loadRunner(int index)
         runner->d->matchSources = m_runnerMetaData[index].sourcesUsed;
         runner->d->generatesDefaultMatches =  m_runnerMetaData[index].generatesDefaultMatches;
         m_runnerMetaData[index].loaded = true;
-        if (m_context.isValid(0) &&
-            (!m_context.query().isEmpty() ||
-             m_context.isDefaultMatchesRequest())) {
+        const QueryContext context = currentContext();
+        if (context.isValid(0) &&
+            (!context.query().isEmpty() ||
+             context.isDefaultMatchesRequest())) {
             retrieveSessionData(index);
         }
     } else {
         m_runnerMetaData[index].loaded = false;
         m_runnerMetaData[index].busy = false;
-        qWarning() << "LOAD FAILURE" <<  path << ":" << loader.errorString();
-        delete plugin;
+        qWarning() << "LOAD FAILURE"
+                   << (m_runnerMetaData[index].staticInstance ? m_runnerMetaData[index].id
+                                                              : m_runnerMetaData[index].library)
+                   << ":" << error;
     }
 
     emit runnerLoaded(index);
@@ -360,24 +537,21 @@ void QuerySessionThread::retrieveSessionData(int index)
         return;
     }
 
-    if (!m_sessionDataThread) {
-        m_sessionDataThread = new SessionDataThread();
-    }
-
-    m_sessionDataThread->start();
     m_sessionData[index] = m_dummySessionData;
-    SessionDataRetriever *rtrver = new SessionDataRetriever(m_sessionDataThread, m_sessionId, index, runner);
+    SessionDataRetriever *rtrver = new SessionDataRetriever(RunnerHost::instance()->sessionDataThread(),
+                                                            m_sessionId, index, runner,
+                                                            m_runnerMetaData[index].statistics, m_trace,
+                                                            &m_runnables);
     rtrver->setAutoDelete(true);
-    connect(rtrver, SIGNAL(sessionDataRetrieved(QUuid,int,RunnerSessionData*)),
-            this, SLOT(sessionDataRetrieved(QUuid,int,RunnerSessionData*)));
+    connect(rtrver, SIGNAL(sessionDataRetrieved(quint64,int,RunnerSessionData*)),
+            this, SLOT(sessionDataRetrieved(quint64,int,RunnerSessionData*)));
+    m_runnables.started();
     m_threadPool->start(rtrver);
 }
 
-void QuerySessionThread::sessionDataRetrieved(const QUuid &sessionId, int index, RunnerSessionData *data)
+void QuerySessionThread::sessionDataRetrieved(quint64 sessionId, int index, RunnerSessionData *data)
 {
-    qDebug() << "got session data for runner at index " << index;
-
-    if (index < 0 || index >= m_sessionData.size()) {
+    if (!m_session || index < 0 || index >= m_sessionData.size()) {
         delete data;
         return;
     }
@@ -389,8 +563,9 @@ void QuerySessionThread::sessionDataRetrieved(const QUuid &sessionId, int index,
 
     if (data) {
         data->d->associateSession(m_session);
-        data->d->enabled = m_enabledRunnerIds.contains(m_runnerMetaData[index].id);
+        data->d->enabled = isRunnerEnabled(index);
         data->d->sessionId = m_sessionId;
+        data->d->statistics = m_runnerMetaData[index].statistics;
     }
 
     m_sessionData[index].reset(data);
@@ -398,6 +573,9 @@ void QuerySessionThread::sessionDataRetrieved(const QUuid &sessionId, int index,
     if (data) {
         connect(data, SIGNAL(busyChanged(bool)), this, SLOT(updateBusyStatus()));
         startQuery(false);
+    } else {
+        // one less runner to wait for
+        checkIdle();
     }
 }
 
@@ -412,9 +590,95 @@ void QuerySessionThread::updateBusyStatus()
         if (m_sessionData[i] == sessionData) {
             m_runnerMetaData[i].busy = sessionData->isBusy();
             emit busyChanged(i);
+            break;
+        }
+    }
+
+    checkIdle();
+}
+
+void QuerySessionThread::matcherFinished(int index, int generation)
+{
+    CHECK_IS_WORKER_THREAD
+
+    if (index < m_matcherGenerations.size() && m_matcherGenerations[index] == generation) {
+        m_matcherRunning[index] = false;
+        checkIdle();
+    }
+}
+
+void QuerySessionThread::checkIdle()
+{
+    CHECK_IS_WORKER_THREAD
+
+    const int generation = m_idleDue.load();
+    if (!generation) {
+        return;
+    }
+
+    {
+        // held until the end, so no query can start in between
+        QReadLocker lock(&m_matchIndexLock);
+        if (m_dispatchedGeneration != generation) {
+            return;
+        }
+
+        for (int i = 0; i < m_sessionData.size(); ++i) {
+            if (m_sessionData[i] == m_dummySessionData) {
+                // the runner is dispatched once its session data is in
+                return;
+            }
+
+            // busy session data left over from earlier queries do not
+            // hold up this one; asynchronous runners stay busy after
+            // their matcher is done with the query
+            if (m_matcherGenerations[i] == generation &&
+                (m_matcherRunning[i] || (m_sessionData[i] && m_sessionData[i]->isBusy()))) {
+                return;
+            }
+        }
+
+        if (!m_idleDue.testAndSetOrdered(generation, 0)) {
             return;
         }
     }
+
+    emit runnersIdle(generation);
+}
+
+void QuerySessionThread::networkStateChanged(bool online)
+{
+    CHECK_IS_WORKER_THREAD
+
+    if (!online) {
+        return;
+    }
+
+    const QueryContext context = currentContext();
+    if (!context.isValid(0) ||
+        (context.query().isEmpty() && !context.isDefaultMatchesRequest())) {
+        return;
+    }
+
+    // runners that rely only on the network skipped the current query
+    // while we were offline; let them have another go at it
+    bool redispatch = false;
+    {
+        QWriteLocker lock(&m_matchIndexLock);
+        for (int i = 0; i < m_runnerMetaData.size(); ++i) {
+            const QVector<QuerySession::MatchSource> &sources = m_runnerMetaData[i].sourcesUsed;
+            if (m_matchers[i] &&
+                sources.size() == 1 &&
+                sources[0] == QuerySession::FromNetworkService) {
+                m_matchers[i] = 0;
+                redispatch = true;
+            }
+        }
+    }
+
+    if (redispatch) {
+        startQuery(false);
+    }
 }
 
 bool QuerySessionThread::startNextRunner()
@@ -435,20 +699,41 @@ bool QuerySessionThread::startNextRunner()
         return true;
     }
 
+    // the pool is shared with the other sessions
+    if (m_runnables.count() >= RunnerHost::instance()->sessionQuota()) {
+        emit continueMatching();
+        return false;
+    }
+
     // if we have a session data object, we have a runner
     Runner *runner = m_runners.at(m_currentRunner);
     Q_ASSERT(runner);
 
     //qDebug() << "          created a new matcher";
-    matcher = new MatchRunnable(runner, sessionData, m_context);
+    const int generation = m_generation.load();
+    matcher = new MatchRunnable(runner, sessionData, m_context,
+                                m_runnerMetaData[m_currentRunner].statistics, m_trace,
+                                &m_runnables, this, m_currentRunner, generation);
+    m_runnables.started();
     if (!m_threadPool->tryStart(matcher)) {
         //qDebug() << "          threads be full";
+        m_runnables.finished();
         delete matcher;
         emit continueMatching();
         return false;
     }
 
     m_matchers[m_currentRunner] = matcher;
+    m_matcherGenerations[m_currentRunner] = generation;
+    m_matcherRunning[m_currentRunner] = true;
+    if (SPRINTER_TRACE_ENABLED(runner_dispatch)) {
+        SPRINTER_TRACE3(runner_dispatch, runner->d->id.utf16(), runner->d->id.size(), m_currentRunner);
+    }
+    if (m_trace->isRecording()) {
+        QVariantMap args;
+        args.insert(QStringLiteral("runner"), runner->id());
+        m_trace->instant("dispatch", "runner", args);
+    }
     return true;
 }
 
@@ -457,7 +742,7 @@ void QuerySessionThread::startMatching()
     CHECK_IS_WORKER_THREAD
     //qDebug() << m_context.query() << m_currentRunner << m_runnerBookmark;
 
-    if (m_runners.isEmpty()) {
+    if (!m_session || m_runners.isEmpty()) {
         return;
     }
 
@@ -469,8 +754,11 @@ void QuerySessionThread::startMatching()
     if (m_runners.size() == 1) {
         // with just one runner we don't need to loop at all
         m_currentRunner = 0;
-        startNextRunner();
+        if (startNextRunner()) {
+            m_dispatchedGeneration = m_generation.load();
+        }
         m_matchIndexLock.unlock();
+        checkIdle();
         return;
     }
 
@@ -492,16 +780,23 @@ void QuerySessionThread::startMatching()
         }
     }
 
-    startNextRunner();
+    if (startNextRunner()) {
+        m_dispatchedGeneration = m_generation.load();
+    }
     m_matchIndexLock.unlock();
+    checkIdle();
 }
 
 void QuerySessionThread::launchDefaultMatches()
 {
     CHECK_IS_GUI_THREAD
 
-    m_context.setFetchMore(false);
-    m_context.setIsDefaultMatchesRequest(true);
+    {
+        QWriteLocker lock(&m_matchIndexLock);
+        m_context.setFetchMore(false);
+        m_context.setIsDefaultMatchesRequest(true);
+    }
+
     startQuery();
 }
 
@@ -509,13 +804,17 @@ bool QuerySessionThread::launchQuery(const QString &query)
 {
     CHECK_IS_GUI_THREAD
 
-    const QString oldQuery = m_context.query();
-    m_context.setQuery(query);
-    if (m_context.query() == oldQuery) {
-        return false;
+    {
+        QWriteLocker lock(&m_matchIndexLock);
+        const QString oldQuery = m_context.query();
+        m_context.setQuery(query);
+        if (m_context.query() == oldQuery) {
+            return false;
+        }
+
+        m_context.setFetchMore(false);
     }
 
-    m_context.setFetchMore(false);
     startQuery();
     return true;
 }
@@ -524,16 +823,34 @@ void QuerySessionThread::launchMoreMatches()
 {
     CHECK_IS_GUI_THREAD
 
-    m_context.setFetchMore(true);
+    {
+        QWriteLocker lock(&m_matchIndexLock);
+        m_context.setFetchMore(true);
+    }
+
     startQuery(m_currentRunner == m_runnerBookmark);
 }
 
 void QuerySessionThread::startQuery(bool clearMatchers)
 {
-    qDebug() << m_context.query()
-             << (m_context.fetchMore() ? "Fetching more." : "")
-             << (m_context.isDefaultMatchesRequest() ? "Default matches." : "")
-             << (clearMatchers ? "Clearing matchers" : "Keeping Matchers");
+    if (SPRINTER_TRACE_ENABLED(query_start) || m_trace->isRecording()) {
+        // a copy, as we may be in the worker thread while the GUI thread
+        // changes the context
+        const QueryContext context = currentContext();
+        if (SPRINTER_TRACE_ENABLED(query_start)) {
+            const QString query = context.query();
+            SPRINTER_TRACE5(query_start, query.utf16(), query.size(),
+                            context.fetchMore(), context.isDefaultMatchesRequest(), clearMatchers);
+        }
+        if (m_trace->isRecording()) {
+            // each query starts a new stretch of the timeline
+            QVariantMap args;
+            args.insert(QStringLiteral("query"), context.query());
+            args.insert(QStringLiteral("fetchMore"), context.fetchMore());
+            args.insert(QStringLiteral("defaultMatches"), context.isDefaultMatchesRequest());
+            m_trace->instant("query", "query", args);
+        }
+    }
 
     {
         QWriteLocker lock(&m_matchIndexLock);
@@ -541,12 +858,28 @@ void QuerySessionThread::startQuery(bool clearMatchers)
                                                         : m_currentRunner - 1);
         if (clearMatchers) {
             m_matchers.fill(0);
+            nextGeneration();
+
+            if (!m_context.fetchMore()) {
+                for (int i = 0; i < m_runnerMetaData.size(); ++i) {
+                    m_runnerMetaData[i].statistics->queryStarted();
+                }
+            }
         }
+
+        // runners (re)dispatched from here on are waited for as well
+        m_dispatchedGeneration = 0;
+        m_idleDue.store(m_generation.load());
     }
 
     emit continueMatching();
 }
 
+QThread *QuerySessionThread::guiThread() const
+{
+    return m_session ? m_session->thread() : 0;
+}
+
 QString QuerySessionThread::query() const
 {
     return m_context.query();
@@ -554,6 +887,7 @@ QString QuerySessionThread::query() const
 
 bool QuerySessionThread::setImageSize(const QSize &size)
 {
+    QWriteLocker lock(&m_matchIndexLock);
     if (m_context.imageSize() != size) {
         m_context.setImageSize(size);
         return true;
@@ -573,24 +907,74 @@ void QuerySessionThread::clearSessionData()
         m_sessionData[i].clear();
         m_runnerMetaData[i].fetchedSessionData = false;
     }
+}
 
-    if (m_sessionDataThread) {
-        m_sessionDataThread->exit();
+void QuerySessionThread::nextGeneration()
+{
+    // 0 stands for no generation at all
+    if (m_generation.fetchAndAddOrdered(1) + 1 == 0) {
+        m_generation.fetchAndAddOrdered(1);
     }
 }
 
+void QuerySessionThread::startNewSession()
+{
+    // must be called with m_matchIndexLock held for writing
+    m_sessionId = createSessionId();
+    m_context.invalidate();
+    m_context.d->sessionId = m_sessionId;
+}
+
+QueryContext QuerySessionThread::currentContext()
+{
+    QReadLocker lock(&m_matchIndexLock);
+    return m_context;
+}
+
 void QuerySessionThread::endQuerySession()
 {
+    CHECK_IS_GUI_THREAD
+
+    // take the matches out of the model a runner at a time rather than
+    // resetting it, so views can hold on to their delegates. the last
+    // block goes first so the rows of the others do not move meanwhile
+    m_matchCount = -1;
+    m_idRowsValid = false;
+
+    QVector<int> offsets(m_sessionData.size());
+    int offset = 0;
+    for (int i = 0; i < m_sessionData.size(); ++i) {
+        offsets[i] = offset;
+        if (m_sessionData[i]) {
+            offset += m_sessionData[i]->d->syncedMatches.size();
+        }
+    }
+
+    for (int i = m_sessionData.size() - 1; i >= 0; --i) {
+        if (m_sessionData[i]) {
+            m_sessionData[i]->d->clearSynced(offsets[i]);
+        }
+    }
+
     QWriteLocker lock(&m_matchIndexLock);
-    m_sessionId = QUuid::createUuid();
-    m_context.d->sessionId = m_sessionId;
+    startNewSession();
+
+    // the halted query is not going to complete
+    nextGeneration();
+    m_idleDue.store(0);
+    m_dispatchedGeneration = 0;
 
     clearSessionData();
     m_matchers.fill(0);
 
     m_matchCount = -1;
+    m_idRowsValid = false;
     m_runnerBookmark = m_currentRunner = 0;
-    emit resetModel();
+
+    if (m_trace->isRecording()) {
+        m_trace->instant("halt", "query");
+        m_trace->flush();
+    }
 }
 
 void QuerySessionThread::setEnabledRunners(const QStringList &runnerIds)
@@ -602,6 +986,7 @@ void QuerySessionThread::setEnabledRunners(const QStringList &runnerIds)
     }
 
     m_enabledRunnerIds = runnerIds;
+    m_enabledRunnerAtoms = StringAtoms::atomSet(runnerIds);
     // this loop relies on the (valid) assumption that the session data
     // and metadata vectors are the same size
     const int runnerCount = m_runnerMetaData.count();
@@ -611,7 +996,12 @@ void QuerySessionThread::setEnabledRunners(const QStringList &runnerIds)
             continue;
         }
 
-        sessionData->setEnabled(m_enabledRunnerIds.contains(m_runnerMetaData[i].id));
+        const bool enabled = isRunnerEnabled(i);
+        if (sessionData->enabled() && !enabled) {
+            // its matches are removed from the model at the next sync
+            sessionData->d->requestClear();
+        }
+        sessionData->setEnabled(enabled);
     }
 
     emit enabledRunnersChanged();
@@ -622,23 +1012,208 @@ QStringList QuerySessionThread::enabledRunners() const
     return m_enabledRunnerIds;
 }
 
-MatchRunnable::MatchRunnable(Runner *runner, QSharedPointer<RunnerSessionData> sessionData, QueryContext &context)
-    : m_runner(runner),
+bool QuerySessionThread::isRunnerEnabled(int index) const
+{
+    return StringAtoms::contains(m_enabledRunnerAtoms, m_runnerMetaData[index].idAtom);
+}
+
+// if a window stops rendering, e.g. because it is hidden, pending
+// matches are synchronized this long after they were due anyways
+static const int s_frameFallback = 100;
+
+SyncScheduler::SyncScheduler(QuerySessionThread *worker, QObject *parent)
+    : QObject(parent),
+      m_worker(worker),
+      m_timer(new QTimer(this)),
+      m_lastSync(-1),
+      m_dueAt(0),
+      m_firstDelay(0),
+      m_interval(16),
+      m_pending(false)
+{
+    m_clock.start();
+    m_timer->setSingleShot(true);
+    connect(m_timer, SIGNAL(timeout()), this, SLOT(sync()));
+}
+
+QEvent::Type SyncScheduler::requestEventType()
+{
+    static const QEvent::Type type = (QEvent::Type)QEvent::registerEventType();
+    return type;
+}
+
+void SyncScheduler::setFirstDelay(int msecs)
+{
+    m_firstDelay = qMax(0, msecs);
+}
+
+int SyncScheduler::firstDelay() const
+{
+    return m_firstDelay;
+}
+
+void SyncScheduler::setInterval(int msecs)
+{
+    m_interval = qMax(0, msecs);
+}
+
+int SyncScheduler::interval() const
+{
+    return m_interval;
+}
+
+void SyncScheduler::setWindow(QWindow *window)
+{
+    if (m_window) {
+        disconnect(m_window, 0, this, 0);
+    }
+
+    m_window = 0;
+
+    // only Qt Quick windows announce their frames
+    if (window && window->metaObject()->indexOfSignal("beforeSynchronizing()") != -1) {
+        m_window = window;
+        // emitted in the render thread while the GUI thread is blocked;
+        // queued, we sync in the GUI thread right after that frame
+        connect(window, SIGNAL(beforeSynchronizing()),
+                this, SLOT(frameStarting()), Qt::QueuedConnection);
+    }
+}
+
+QWindow *SyncScheduler::window() const
+{
+    return m_window;
+}
+
+QThread *SyncScheduler::guiThread() const
+{
+    return m_worker->guiThread();
+}
+
+bool SyncScheduler::event(QEvent *event)
+{
+    if (event->type() == requestEventType()) {
+        schedule();
+        return true;
+    }
+
+    return QObject::event(event);
+}
+
+void SyncScheduler::schedule()
+{
+    CHECK_IS_GUI_THREAD
+
+    const qint64 now = m_clock.elapsed();
+    qint64 dueAt;
+    if (m_worker->matchCount() == 0) {
+        dueAt = now + m_firstDelay;
+    } else if (m_lastSync < 0) {
+        dueAt = now;
+    } else {
+        dueAt = qMax(now, m_lastSync + m_interval);
+    }
+
+    if (m_pending && m_dueAt <= dueAt) {
+        return;
+    }
+
+    m_pending = true;
+    m_dueAt = dueAt;
+
+    if (m_window) {
+        QMetaObject::invokeMethod(m_window, "update");
+        m_timer->start(int(dueAt - now) + s_frameFallback);
+    } else {
+        m_timer->start(int(dueAt - now));
+    }
+}
+
+void SyncScheduler::frameStarting()
+{
+    if (!m_pending || !m_window) {
+        return;
+    }
+
+    if (m_clock.elapsed() < m_dueAt) {
+        // too early; look again on the next frame
+        QMetaObject::invokeMethod(m_window, "update");
+        return;
+    }
+
+    sync();
+}
+
+void SyncScheduler::sync()
+{
+    m_timer->stop();
+    m_pending = false;
+    m_lastSync = m_clock.elapsed();
+    emit synchronize();
+}
+
+MatchRunnable::MatchRunnable(Runner *runner, QSharedPointer<RunnerSessionData> sessionData, const QueryContext &context,
+                             const QSharedPointer<RunnerStatistics> &statistics, TraceRecorder *trace,
+                             RunnableCounter *counter, QuerySessionThread *worker, int index, int generation)
+    : m_worker(worker),
+      m_index(index),
+      m_generation(generation),
+      m_runner(runner),
       m_sessionData(sessionData),
-      m_context(context)
+      m_context(context),
+      m_statistics(statistics),
+      m_trace(trace),
+      m_counter(counter)
 {
 }
 
 void MatchRunnable::run()
 {
-    if (m_sessionData) {
-        m_sessionData.data()->startMatch(m_context);
+    if (!m_sessionData) {
+        QMetaObject::invokeMethod(m_worker, "matcherFinished", Qt::QueuedConnection,
+                                  Q_ARG(int, m_index), Q_ARG(int, m_generation));
+        m_counter->finished();
+        return;
+    }
+
+    const qint64 traceStart = m_trace->isRecording() ? m_trace->now() : -1;
+    QElapsedTimer timer;
+    timer.start();
+    const qint64 cpuStart = RunnerStatistics::threadCpuTime();
+
+    m_sessionData.data()->startMatch(m_context);
+
+    if (m_statistics) {
+        // the query moved on while the runner was matching
+        const bool cancelled = !m_context.isValid(m_sessionData.data());
+        m_statistics->matchFinished(timer.nsecsElapsed() / 1000,
+                                    RunnerStatistics::threadCpuTime() - cpuStart,
+                                    cancelled);
     }
+
+    if (traceStart >= 0 && m_trace->isRecording()) {
+        QVariantMap args;
+        args.insert(QStringLiteral("runner"), m_runner->id());
+        args.insert(QStringLiteral("query"), m_context.query());
+        m_trace->complete("match", "runner", traceStart, args);
+    }
+
+    // the session data must go before the session may; the worker waits
+    // for the counter, so it is still there to be told
+    m_sessionData.clear();
+    QMetaObject::invokeMethod(m_worker, "matcherFinished", Qt::QueuedConnection,
+                              Q_ARG(int, m_index), Q_ARG(int, m_generation));
+    m_counter->finished();
 }
 
-SessionDataRetriever::SessionDataRetriever(QThread *destinationThread, const QUuid &sessionId, int index, Runner *runner)
+SessionDataRetriever::SessionDataRetriever(QThread *destinationThread, quint64 sessionId, int index, Runner *runner,
+                                           const QSharedPointer<RunnerStatistics> &statistics, TraceRecorder *trace,
+                                           RunnableCounter *counter)
     : m_destinationThread(destinationThread),
       m_runner(runner),
+      m_statistics(statistics),
+      m_trace(trace),
+      m_counter(counter),
       m_sessionId(sessionId),
       m_index(index)
 {
@@ -646,9 +1221,22 @@ SessionDataRetriever::SessionDataRetriever(QThread *destinationThread, const QUu
 
 void SessionDataRetriever::run()
 {
+    const qint64 traceStart = m_trace->isRecording() ? m_trace->now() : -1;
+    QElapsedTimer timer;
+    timer.start();
+
     RunnerSessionData *session = m_runner->createSessionData();
     session->moveToThread(m_destinationThread);
+    m_statistics->sessionDataCreated(timer.nsecsElapsed() / 1000);
+
+    if (traceStart >= 0 && m_trace->isRecording()) {
+        QVariantMap args;
+        args.insert(QStringLiteral("runner"), m_runner->id());
+        m_trace->complete("createSessionData", "runner", traceStart, args);
+    }
+
     emit sessionDataRetrieved(m_sessionId, m_index, session);
+    m_counter->finished();
 }
 
 ExecRunnable::ExecRunnable(const QueryMatch &match, QObject *parent)
@@ -662,7 +1250,13 @@ void ExecRunnable::run()
     bool success = false;
     Runner *runner = m_match.runner();
     if (runner) {
+        if (SPRINTER_TRACE_ENABLED(exec_start)) {
+            SPRINTER_TRACE3(exec_start, runner->d->id.utf16(), runner->d->id.size(), m_match.id());
+        }
         success = runner->startExec(m_match);
+        if (SPRINTER_TRACE_ENABLED(exec_end)) {
+            SPRINTER_TRACE4(exec_end, runner->d->id.utf16(), runner->d->id.size(), m_match.id(), success);
+        }
     }
 
     emit finished(m_match, success);
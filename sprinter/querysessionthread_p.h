@@ -21,18 +21,25 @@
 #ifndef QUERYSESSIONTHREAD
 #define QUERYSESSIONTHREAD
 
+#include <QAtomicInt>
+#include <QBitArray>
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QHash>
+#include <QJsonObject>
 #include <QReadWriteLock>
 #include <QRunnable>
 #include <QPointer>
 #include <QThread>
 #include <QTimer>
 #include <QVector>
-#include <QUuid>
 
+#include "runnerhost_p.h"
 #include "runnermetadata_p.h"
 #include "querycontext.h"
 
 class QThreadPool;
+class QWindow;
 
 namespace Sprinter
 {
@@ -40,39 +47,83 @@ namespace Sprinter
 class Runner;
 class RunnableMatch;
 class QuerySession;
+class QuerySessionThread;
 class RunnerSessionData;
+class TraceRecorder;
 
 QString textForEnum(const QObject *obj, const char *enumName, int value);
 
-class NonRestartingTimer : public QTimer
+/**
+ * Decides when pending matches are synchronized into the model. Requests
+ * may be posted from any thread (see requestEvent); the first one after a
+ * sync schedules the next sync according to how things look at that point:
+ *  - with nothing in the model yet, after firstDelay (0 by default), so the
+ *    first rows show up as soon as possible
+ *  - otherwise no sooner than interval after the previous sync, so slowly
+ *    trickling results are shown immediately while bursts are coalesced
+ *  - with a window set, on that window's next frame once the above allows
+ *    it, so there is at most one model update per frame; a timer still
+ *    covers windows which are not currently rendering
+ */
+class SyncScheduler : public QObject
 {
     Q_OBJECT
 
 public:
-    NonRestartingTimer(QObject *parent = 0)
-        : QTimer(parent)
-    {
-    }
+    SyncScheduler(QuerySessionThread *worker, QObject *parent = 0);
 
-public Q_SLOTS:
-    void startIfStopped()
-    {
-        if (!isActive()) {
-            start();
-        }
-    }
+    static QEvent::Type requestEventType();
+
+    void setFirstDelay(int msecs);
+    int firstDelay() const;
+    void setInterval(int msecs);
+    int interval() const;
+    void setWindow(QWindow *window);
+    QWindow *window() const;
+
+Q_SIGNALS:
+    void synchronize();
+
+protected:
+    bool event(QEvent *event);
+
+private Q_SLOTS:
+    void frameStarting();
+    void sync();
+
+private:
+    void schedule();
+    QThread *guiThread() const;
+
+    QuerySessionThread *m_worker;
+    QTimer *m_timer;
+    QPointer<QWindow> m_window;
+    QElapsedTimer m_clock;
+    qint64 m_lastSync;
+    qint64 m_dueAt;
+    int m_firstDelay;
+    int m_interval;
+    bool m_pending;
 };
 
 class MatchRunnable : public QRunnable
 {
 public:
-    MatchRunnable(Runner *runner, QSharedPointer<RunnerSessionData> sessionData, QueryContext &context);
+    MatchRunnable(Runner *runner, QSharedPointer<RunnerSessionData> sessionData, const QueryContext &context,
+                  const QSharedPointer<RunnerStatistics> &statistics, TraceRecorder *trace,
+                  RunnableCounter *counter, QuerySessionThread *worker, int index, int generation);
     void run();
 
 private:
+    QuerySessionThread *m_worker;
+    int m_index;
+    int m_generation;
     Runner *m_runner;
     QSharedPointer<RunnerSessionData> m_sessionData;
-    QueryContext &m_context;
+    QueryContext m_context;
+    QSharedPointer<RunnerStatistics> m_statistics;
+    TraceRecorder *m_trace;
+    RunnableCounter *m_counter;
 };
 
 class SessionDataThread : public QThread
@@ -98,6 +149,9 @@ public Q_SLOTS:
     void loadRunner(int index);
     void setEnabledRunners(const QStringList &runnerIds);
     void startMatching();
+    // called, blocking, by the session as it goes; afterwards the worker
+    // no longer touches the session and deletes itself
+    void shutdown();
 
     // in GUI thread
 public:
@@ -105,7 +159,13 @@ public:
     bool launchQuery(const QString &query);
     void launchMoreMatches();
     int matchCount() const;
+    // the synchronized matches which are for the current query, rather
+    // than left over from the last one
+    int currentMatchCount() const;
     const QueryMatch &matchAt(int index);
+    // all synchronized matches, in row order
+    QVector<QueryMatch> matches() const;
+    int rowForMatchId(quint64 id);
 
 public Q_SLOTS:
     void syncMatches();
@@ -115,6 +175,12 @@ public:
     QStringList enabledRunners() const;
     const QVector<RunnerMetaData> &runnerMetaData() const;
     QuerySession *session() const { return m_session; }
+    // the thread the session lives in, called the GUI thread throughout;
+    // that is the main thread unless used through HeadlessSession
+    QThread *guiThread() const;
+    TraceRecorder *trace() const { return m_trace; }
+    // bumped each time a query is started anew or the session is halted
+    int generation() const { return m_generation.load(); }
     void endQuerySession();
     QString query() const;
     bool setImageSize(const QSize &size);
@@ -128,12 +194,17 @@ Q_SIGNALS:
     void busyChanged(int metaDataIndex);
     void runnerLoaded(int index);
     void resetModel();
+    // every runner has been dispatched for the query of the generation,
+    // and all of them have finished matching
+    void runnersIdle(int generation);
 
 public Q_SLOTS:
-    void sessionDataRetrieved(const QUuid &sessionId, int, RunnerSessionData *data);
+    void sessionDataRetrieved(quint64 sessionId, int, RunnerSessionData *data);
 
 private Q_SLOTS:
     void updateBusyStatus();
+    void matcherFinished(int index, int generation);
+    void networkStateChanged(bool online);
 
 private:
     // in GUI thread
@@ -142,13 +213,24 @@ private:
     // in worker thread
     bool startNextRunner();
     void retrieveSessionData(int index);
+    void addRunnerMetaData(RunnerMetaData &md, const QJsonObject &pluginMetaData,
+                           const QStringList &langs, QHash<QString, int> &seenIds);
+
+    void checkIdle();
 
     // thread agnostic
     void clearSessionData();
+    // with m_matchIndexLock held for writing
+    void nextGeneration();
+    void startNewSession();
+    QueryContext currentContext();
+    bool isRunnerEnabled(int index) const;
 
     QThreadPool *m_threadPool;
     QuerySession *m_session;
     QStringList m_enabledRunnerIds;
+    // the atoms of m_enabledRunnerIds
+    QBitArray m_enabledRunnerAtoms;
     // these vectors are all the same size at all times
     QVector<RunnerMetaData> m_runnerMetaData;
     QVector<Runner *> m_runners;
@@ -161,28 +243,50 @@ private:
     QReadWriteLock m_matchIndexLock;
     int m_runnerBookmark;
     int m_currentRunner;
+    // written in the GUI thread, copied from others: both with m_matchIndexLock
     QueryContext m_context;
-    QUuid m_sessionId;
+    quint64 m_sessionId;
     QTimer *m_restartMatchingTimer;
     int m_matchCount;
-
-    QPointer<SessionDataThread> m_sessionDataThread;
+    // built on demand, in the GUI thread, after each sync
+    QHash<quint64, int> m_idRows;
+    bool m_idRowsValid;
+    QAtomicInt m_generation;
+    // the generation runnersIdle is still to be emitted for, or 0
+    QAtomicInt m_idleDue;
+    // the generation every runner has been dispatched for, or 0 while
+    // some are still waiting on the pool, the quota or their session
+    // data; with m_matchIndexLock
+    int m_dispatchedGeneration;
+    // per runner, the generation of the last MatchRunnable and whether
+    // that is still running; only touched in the worker thread
+    QVector<int> m_matcherGenerations;
+    QVector<bool> m_matcherRunning;
+
+    // this session's runnables in the shared thread pool
+    RunnableCounter m_runnables;
+    TraceRecorder *m_trace;
 };
 
 class SessionDataRetriever : public QObject, public QRunnable
 {
     Q_OBJECT
 public:
-    SessionDataRetriever(QThread *destinationThread, const QUuid &sessionId, int index, Runner *runner);
+    SessionDataRetriever(QThread *destinationThread, quint64 sessionId, int index, Runner *runner,
+                         const QSharedPointer<RunnerStatistics> &statistics, TraceRecorder *trace,
+                         RunnableCounter *counter);
     void run();
 
 Q_SIGNALS:
-    void sessionDataRetrieved(const QUuid &sessionId, int index, RunnerSessionData *data);
+    void sessionDataRetrieved(quint64 sessionId, int index, RunnerSessionData *data);
 
 private:
     QThread *m_destinationThread;
     Runner *m_runner;
-    QUuid m_sessionId;
+    QSharedPointer<RunnerStatistics> m_statistics;
+    TraceRecorder *m_trace;
+    RunnableCounter *m_counter;
+    quint64 m_sessionId;
     int m_index;
 };
 
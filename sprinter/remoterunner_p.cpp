@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "remoterunner_p.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+
+#include "daemonclient_p.h"
+#include "matchdata.h"
+#include "querymatch.h"
+#include "querymatch_p.h"
+#include "runnersandbox_p.h"
+
+namespace Sprinter
+{
+
+// how often a runner waiting on the daemon checks whether its query
+// is still current
+static const int s_pollInterval = 50;
+static const int s_execTimeout = 10000;
+
+RemoteRunner::RemoteRunner(const RunnerMetaData &md, RunnerSandbox *sandbox)
+    : Runner(0),
+      m_id(md.id),
+      m_sandbox(sandbox)
+{
+    // the runner in the daemon decides what it has an interest in
+    setMinQueryLength(0);
+    setGeneratesDefaultMatches(md.generatesDefaultMatches);
+    setMatchTypesGenerated(md.matchTypesGenerated);
+    setSourcesUsed(md.sourcesUsed);
+}
+
+RemoteRunner::~RemoteRunner()
+{
+    delete m_sandbox;
+}
+
+DaemonClient *RemoteRunner::client() const
+{
+    if (!m_sandbox) {
+        return DaemonClient::instance();
+    }
+
+    return m_sandbox->ensureRunning() ? m_sandbox->client() : 0;
+}
+
+RunnerSessionData *RemoteRunner::createSessionData()
+{
+    DaemonClient *daemon = client();
+    const quint32 channel = daemon ? daemon->open(m_id) : 0;
+    // a sandbox keeps its client when restarted, so channels opened
+    // later on are closed through it as well
+    return new RemoteSessionData(this, m_sandbox ? m_sandbox->client() : daemon, channel);
+}
+
+void RemoteRunner::match(MatchData &matchData)
+{
+    RemoteSessionData *sessionData = static_cast<RemoteSessionData *>(matchData.sessionData());
+    DaemonClient *daemon = client();
+    if (!daemon) {
+        return;
+    }
+
+    // the matches are handed to the session data as pages arrive
+    matchData.setAsynchronous(true);
+
+    const QueryContext context = matchData.queryContext();
+    quint32 request = daemon->query(sessionData->channel(), context);
+    if (!request) {
+        // the daemon went away since the channel was opened, or a hung
+        // sandbox was killed; either way there is a new one to ask
+        sessionData->setChannel(daemon->open(m_id));
+        request = daemon->query(sessionData->channel(), context);
+        if (!request) {
+            return;
+        }
+    }
+
+    DaemonClient::Page page;
+    QElapsedTimer sincePage;
+    sincePage.start();
+    forever {
+        const DaemonClient::WaitResult result = daemon->nextPage(sessionData->channel(), request, page, s_pollInterval);
+        if (result == DaemonClient::Lost) {
+            return;
+        } else if (result == DaemonClient::TimedOut) {
+            if (!matchData.isValid()) {
+                // the query moved on; the next request replaces this one
+                return;
+            }
+
+            if (m_sandbox && sincePage.elapsed() > RunnerSandbox::hangTimeout()) {
+                qWarning() << "The sandbox of" << m_id << "has not answered in"
+                           << sincePage.elapsed() << "ms, restarting it";
+                m_sandbox->restart();
+                return;
+            }
+            continue;
+        }
+
+        sincePage.restart();
+
+        // pages hold all of the matches for the query, while the session
+        // data takes only those past the offset when fetching more
+        QVector<QueryMatch> matches = page.matches;
+        const uint offset = sessionData->resultsOffset();
+        if (context.fetchMore() && offset > 0) {
+            matches = matches.mid(offset);
+        }
+
+        sessionData->setMatches(std::move(matches), context);
+        if (page.complete) {
+            return;
+        }
+    }
+}
+
+bool RemoteRunner::exec(const QueryMatch &match)
+{
+    RemoteSessionData *sessionData = static_cast<RemoteSessionData *>(match.sessionData());
+    DaemonClient *daemon = client();
+    if (!sessionData || !daemon) {
+        return false;
+    }
+
+    // the daemon knows its matches by their id there
+    return daemon->exec(sessionData->channel(), match.d->remoteId, s_execTimeout);
+}
+
+RemoteSessionData::RemoteSessionData(Runner *runner, DaemonClient *client, quint32 channel)
+    : RunnerSessionData(runner),
+      m_client(client),
+      m_channel(channel)
+{
+}
+
+RemoteSessionData::~RemoteSessionData()
+{
+    const quint32 channel = m_channel.load();
+    if (m_client && channel) {
+        m_client->close(channel);
+    }
+}
+
+quint32 RemoteSessionData::channel() const
+{
+    return m_channel.load();
+}
+
+void RemoteSessionData::setChannel(quint32 channel)
+{
+    m_channel.store(channel);
+}
+
+} // namespace
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPRINTER_REMOTERUNNER_P_H
+#define SPRINTER_REMOTERUNNER_P_H
+
+#include <QAtomicInt>
+
+#include "runner.h"
+#include "runnermetadata_p.h"
+#include "runnersessiondata.h"
+
+namespace Sprinter
+{
+
+class DaemonClient;
+class RunnerSandbox;
+
+/**
+ * @class RemoteRunner
+ * Stands in for a runner hosted by sprinterd or in a RunnerSandbox.
+ * Matching forwards the query to the daemon over the session data's
+ * channel and hands the pages that come back to the session data, until
+ * the daemon is done with the query or the query moves on. Executing a
+ * match has the daemon execute it.
+ *
+ * A sandbox which sends nothing back for too long is taken to be hung
+ * and is killed; the next query starts a new one.
+ */
+class RemoteRunner : public Runner
+{
+public:
+    /**
+     * @param sandbox the sandbox hosting the runner, which the RemoteRunner
+     *                takes ownership of; if 0, the runner is hosted by sprinterd
+     */
+    RemoteRunner(const RunnerMetaData &md, RunnerSandbox *sandbox = 0);
+    ~RemoteRunner();
+
+    RunnerSessionData *createSessionData();
+    void match(MatchData &matchData);
+
+protected:
+    bool exec(const QueryMatch &match);
+
+private:
+    DaemonClient *client() const;
+
+    const QString m_id;
+    RunnerSandbox *m_sandbox;
+};
+
+/**
+ * @class RemoteSessionData
+ * Holds a channel to the daemon open for as long as it exists; the daemon
+ * keeps a session of the actual runner for the channel meanwhile.
+ */
+class RemoteSessionData : public RunnerSessionData
+{
+public:
+    RemoteSessionData(Runner *runner, DaemonClient *client, quint32 channel);
+    ~RemoteSessionData();
+
+    /**
+     * @return the channel, or 0 if the daemon could not be reached
+     */
+    quint32 channel() const;
+
+    /**
+     * Replaces the channel, after the daemon it was opened with went away
+     */
+    void setChannel(quint32 channel);
+
+private:
+    DaemonClient *m_client;
+    QAtomicInt m_channel;
+};
+
+} // namespace
+
+#endif
@@ -22,6 +22,7 @@
 
 #include <QDebug>
 
+#include "iconcache_p.h"
 #include "runner_p.h"
 #include "runnersessiondata.h"
 
@@ -112,6 +113,11 @@ void Runner::setSourcesUsed(const QVector<QuerySession::MatchSource> &sources)
 
 QImage Runner::generateImage(const QIcon &icon, const Sprinter::QueryContext &context)
 {
+    if (!icon.name().isEmpty()) {
+        // named theme icons are shared with other processes
+        return IconCache::instance()->image(icon, context.imageSize());
+    }
+
     QImage *image = Private::s_imageCache.object(icon.cacheKey());
     if (!image || image->size() != context.imageSize()) {
         image = new QImage(icon.pixmap(context.imageSize()).toImage());
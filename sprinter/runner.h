@@ -123,7 +123,8 @@ public:
 
     /**
      * @return an appropriately sized image for a given icon.
-     * The results are cached, so caling multiple times is fast.
+     * The results are cached, so caling multiple times is fast. Named theme
+     * icons are cached on disk and shared with other processes.
      */
     QImage generateImage(const QIcon &icon, const Sprinter::QueryContext &context);
 
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "runnerhost_p.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QPluginLoader>
+#include <QThreadPool>
+
+#include "daemonclient_p.h"
+#include "querysessionthread_p.h"
+#include "remoterunner_p.h"
+#include "runner.h"
+#include "runnersandbox_p.h"
+#include "stringatoms_p.h"
+
+namespace Sprinter
+{
+
+static QMutex s_instanceLock;
+static RunnerHost *s_instance = 0;
+static int s_refs = 0;
+
+RunnableCounter::RunnableCounter()
+    : m_count(0)
+{
+}
+
+void RunnableCounter::started()
+{
+    QMutexLocker lock(&m_lock);
+    ++m_count;
+}
+
+void RunnableCounter::finished()
+{
+    QMutexLocker lock(&m_lock);
+    if (--m_count == 0) {
+        m_done.wakeAll();
+    }
+}
+
+int RunnableCounter::count() const
+{
+    QMutexLocker lock(&m_lock);
+    return m_count;
+}
+
+void RunnableCounter::waitForDone()
+{
+    QMutexLocker lock(&m_lock);
+    while (m_count > 0) {
+        m_done.wait(&m_lock);
+    }
+}
+
+RunnerHost *RunnerHost::ref()
+{
+    QMutexLocker lock(&s_instanceLock);
+    if (!s_instance) {
+        s_instance = new RunnerHost;
+    }
+
+    ++s_refs;
+    return s_instance;
+}
+
+void RunnerHost::deref()
+{
+    QMutexLocker lock(&s_instanceLock);
+    Q_ASSERT(s_refs > 0);
+    if (--s_refs == 0) {
+        delete s_instance;
+        s_instance = 0;
+    }
+}
+
+RunnerHost *RunnerHost::instance()
+{
+    QMutexLocker lock(&s_instanceLock);
+    Q_ASSERT(s_instance);
+    return s_instance;
+}
+
+RunnerHost::RunnerHost()
+    : m_workerThread(new QThread),
+      m_sessionDataThread(new SessionDataThread),
+      m_threadPool(new QThreadPool),
+      m_scanned(false)
+{
+    m_workerThread->setObjectName(QStringLiteral("Sprinter worker"));
+    m_workerThread->start();
+    m_sessionDataThread->setObjectName(QStringLiteral("Sprinter session data"));
+    m_sessionDataThread->start();
+
+    // leave a thread for the other sessions
+    bool ok = false;
+    m_sessionQuota = qgetenv("SPRINTER_SESSION_QUOTA").toInt(&ok);
+    if (!ok || m_sessionQuota < 1) {
+        m_sessionQuota = qMax(1, m_threadPool->maxThreadCount() - 1);
+    }
+}
+
+RunnerHost::~RunnerHost()
+{
+    m_threadPool->waitForDone();
+    delete m_threadPool;
+
+    // with no runnables left, nothing talks to the daemon or the
+    // sandboxes anymore
+    for (auto runner: m_runners) {
+        if (dynamic_cast<RemoteRunner *>(runner)) {
+            delete runner;
+        }
+    }
+    DaemonClient::cleanup();
+
+    m_sessionDataThread->quit();
+    m_sessionDataThread->wait();
+    delete m_sessionDataThread;
+
+    m_workerThread->quit();
+    m_workerThread->wait();
+    delete m_workerThread;
+}
+
+QThread *RunnerHost::workerThread()
+{
+    return m_workerThread;
+}
+
+QThread *RunnerHost::sessionDataThread()
+{
+    return m_sessionDataThread;
+}
+
+QThreadPool *RunnerHost::threadPool()
+{
+    return m_threadPool;
+}
+
+int RunnerHost::sessionQuota() const
+{
+    return m_sessionQuota;
+}
+
+bool RunnerHost::metaData(QVector<RunnerMetaData> &metaData)
+{
+    QMutexLocker lock(&m_lock);
+    if (!m_scanned) {
+        // sprinterd, if used, has scanned already
+        DaemonClient *daemon = DaemonClient::instance();
+        if (!daemon || !daemon->runnerMetaData(m_metaData)) {
+            return false;
+        }
+
+        for (int i = 0; i < m_metaData.size(); ++i) {
+            m_metaData[i].idAtom = StringAtoms::intern(m_metaData[i].id);
+        }
+        m_scanned = true;
+    }
+
+    metaData = m_metaData;
+    for (int i = 0; i < metaData.size(); ++i) {
+        metaData[i].loaded = false;
+        metaData[i].busy = false;
+        metaData[i].fetchedSessionData = false;
+        metaData[i].statistics = QSharedPointer<RunnerStatistics>(new RunnerStatistics);
+    }
+
+    return true;
+}
+
+void RunnerHost::setMetaData(const QVector<RunnerMetaData> &metaData)
+{
+    QMutexLocker lock(&m_lock);
+    m_metaData = metaData;
+    m_scanned = true;
+}
+
+Runner *RunnerHost::runner(const RunnerMetaData &md, QString &error)
+{
+    QMutexLocker lock(&m_lock);
+    Runner *runner = m_runners.value(md.id);
+    if (runner) {
+        return runner;
+    }
+
+    int niceness = 0;
+    if (md.remote) {
+        runner = new RemoteRunner(md);
+        m_runners.insert(md.id, runner);
+        return runner;
+    } else if (RunnerSandbox::isSandboxed(md.id, niceness)) {
+        if (md.staticInstance) {
+            // built into the application, so sprinterd can not load it;
+            // the runner is only loaded once, so this warns just the once
+            qWarning() << "Not putting" << md.id << "in a sandbox, as it is built into the application";
+        } else {
+            // the plugin is only ever loaded in the sandbox
+            runner = new RemoteRunner(md, new RunnerSandbox(md.id, niceness));
+            m_runners.insert(md.id, runner);
+            return runner;
+        }
+    }
+
+    // the loader may go; the library stays loaded as long as the process
+    QPluginLoader loader(md.library);
+    QObject *plugin = md.staticInstance ? md.staticInstance() : loader.instance();
+    runner = qobject_cast<Runner *>(plugin);
+    if (!runner) {
+        // a static plugin's instance is a singleton Qt owns, and a loaded
+        // one belongs to its loader; neither is ours to delete
+        if (md.staticInstance) {
+            error = QStringLiteral("The static plugin is not a Sprinter runner");
+        } else {
+            error = plugin ? QStringLiteral("The plugin is not a Sprinter runner") : loader.errorString();
+            loader.unload();
+        }
+        return 0;
+    }
+
+    m_runners.insert(md.id, runner);
+    return runner;
+}
+
+} // namespace
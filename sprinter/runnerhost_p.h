@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPRINTER_RUNNERHOST_P_H
+#define SPRINTER_RUNNERHOST_P_H
+
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "runnermetadata_p.h"
+
+class QThread;
+class QThreadPool;
+
+namespace Sprinter
+{
+
+class Runner;
+
+/**
+ * @class RunnableCounter
+ * Counts the runnables a session has in the shared thread pool, so that
+ * it can keep to its quota and, when it goes away, wait for just its
+ * own runnables rather than everyone's. Thread safe.
+ */
+class RunnableCounter
+{
+public:
+    RunnableCounter();
+
+    void started();
+    void finished();
+    int count() const;
+    void waitForDone();
+
+private:
+    mutable QMutex m_lock;
+    QWaitCondition m_done;
+    int m_count;
+};
+
+/**
+ * @class RunnerHost
+ * What the QuerySessions of a process share: the runner plugin metadata,
+ * which is scanned for once, the runner instances, which are loaded once,
+ * and the threads. All QuerySessionThreads live in one worker thread, all
+ * session data in one thread, and all matching happens in one thread pool.
+ * Session data, contexts and statistics remain per session.
+ *
+ * So that one busy session can not keep the others from matching, each
+ * session may only have sessionQuota() runnables in the pool at once.
+ *
+ * The host is created by the first QuerySession and deleted along with
+ * the last one, wherever in the life of the application that happens;
+ * the next session then starts a host of its own. All methods are
+ * thread safe.
+ */
+class RunnerHost
+{
+public:
+    /**
+     * Holds on to the host, creating it if there is none; each
+     * call is paired with a call to deref
+     */
+    static RunnerHost *ref();
+    static void deref();
+
+    /**
+     * @return the host, which the caller must know to be held by a session
+     */
+    static RunnerHost *instance();
+
+    QThread *workerThread();
+    QThread *sessionDataThread();
+    QThreadPool *threadPool();
+    int sessionQuota() const;
+
+    /**
+     * Copies the metadata found by the first session to scan for plugins
+     * into metaData, with runtime state and statistics of its own. With
+     * sprinterd in use, the metadata comes from the daemon instead.
+     * @return false if no session has scanned yet
+     */
+    bool metaData(QVector<RunnerMetaData> &metaData);
+    void setMetaData(const QVector<RunnerMetaData> &metaData);
+
+    /**
+     * @return the runner, loading it if it is not loaded yet, or 0 if it
+     * could not be loaded, in which case error says why. Runners hosted
+     * by sprinterd or put in a RunnerSandbox are RemoteRunners.
+     */
+    Runner *runner(const RunnerMetaData &md, QString &error);
+
+private:
+    RunnerHost();
+    ~RunnerHost();
+
+    QMutex m_lock;
+    QThread *m_workerThread;
+    QThread *m_sessionDataThread;
+    QThreadPool *m_threadPool;
+    int m_sessionQuota;
+    bool m_scanned;
+    QVector<RunnerMetaData> m_metaData;
+    QHash<QString, Runner *> m_runners;
+};
+
+} // namespace
+
+#endif
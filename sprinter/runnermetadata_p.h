@@ -21,7 +21,11 @@
 #ifndef RUNNERMETADATA
 #define RUNNERMETADATA
 
+#include <QSharedPointer>
+#include <QtPlugin>
+
 #include "sprinter/querysession.h"
+#include "runnerstatistics_p.h"
 
 namespace Sprinter
 {
@@ -31,15 +35,21 @@ class Runner;
 struct RunnerMetaData
 {
     RunnerMetaData()
-        : generatesDefaultMatches(false),
+        : idAtom(-1),
+          generatesDefaultMatches(false),
           loaded(false),
           busy(false),
-          fetchedSessionData(false)
+          fetchedSessionData(false),
+          remote(false),
+          staticInstance(0),
+          statistics(new RunnerStatistics)
     {
     }
 
     QString library;
     QString id;
+    // the interned id, @see StringAtoms
+    int idAtom;
     QString name;
     QString description;
     QString license;
@@ -54,6 +64,12 @@ struct RunnerMetaData
     bool loaded;
     bool busy;
     bool fetchedSessionData;
+    // hosted by sprinterd, and run here through a RemoteRunner
+    bool remote;
+    // set instead of library for runners linked into the application
+    QtPluginInstanceFunction staticInstance;
+    // shared by copies of this metadata and by the runner's session data
+    QSharedPointer<RunnerStatistics> statistics;
 };
 
 } // namespace
@@ -20,12 +20,14 @@
 
 #include "runnermodel_p.h"
 
+#include "iconcache_p.h"
 #include "runner.h"
 #include "querysessionthread_p.h"
 
 #include <QDebug>
 #include <QIcon>
 #include <QMetaEnum>
+#include <QPixmap>
 
 Q_DECLARE_METATYPE(QList<int>);
 
@@ -51,6 +53,8 @@ RunnerModel::RunnerModel(QuerySessionThread *worker, QObject *parent)
             m_busyColumn = i + 1;
         } else if (enumVal == IconRole) {
             m_iconRoleColumn = i + 1;
+        } else if (enumVal == SessionDataTimeRole) {
+            m_firstStatisticsColumn = i + 1;
         }
         m_roles.insert(enumVal, e.key(i));
         m_roleColumns.append(enumVal);
@@ -127,6 +131,10 @@ QVariant RunnerModel::data(const QModelIndex &index, int role) const
         role = IconRole;
     }
 
+    if (role >= SessionDataTimeRole && role <= StaleResultsRole) {
+        return statistic(info[index.row()], role);
+    }
+
     switch (role) {
         case Qt::DisplayRole:
             return info[index.row()].name;
@@ -138,7 +146,7 @@ QVariant RunnerModel::data(const QModelIndex &index, int role) const
             return info[index.row()].description;
             break;
         case IconRole:
-            return QIcon::fromTheme(info[index.row()].icon).pixmap(m_iconSize);
+            return QPixmap::fromImage(IconCache::instance()->image(QIcon::fromTheme(info[index.row()].icon), m_iconSize));
             break;
         case LicenseRole:
             return info[index.row()].license;
@@ -201,6 +209,51 @@ QVariant RunnerModel::data(const QModelIndex &index, int role) const
     return QVariant();
 }
 
+QVariant RunnerModel::statistic(const RunnerMetaData &info, int role) const
+{
+    const RunnerStatistics::Snapshot stats = info.statistics->snapshot();
+
+    switch (role) {
+        case SessionDataTimeRole:
+            return RunnerStatistics::msecs(stats.sessionDataTime);
+            break;
+        case MatchLatencyP50Role:
+            return RunnerStatistics::msecs(stats.matchLatencyP50);
+            break;
+        case MatchLatencyP95Role:
+            return RunnerStatistics::msecs(stats.matchLatencyP95);
+            break;
+        case MatchLatencyP99Role:
+            return RunnerStatistics::msecs(stats.matchLatencyP99);
+            break;
+        case TimeToFirstMatchRole:
+            return RunnerStatistics::msecs(stats.timeToFirstMatch);
+            break;
+        case MatchesProducedRole:
+            return stats.matchesProduced;
+            break;
+        case MatchesDisplayedRole:
+            return stats.matchesDisplayed;
+            break;
+        case MatchRunsRole:
+            return stats.matchRuns;
+            break;
+        case CancellationsRole:
+            return stats.cancellations;
+            break;
+        case CpuTimeRole:
+            return RunnerStatistics::msecs(stats.cpuTime);
+            break;
+        case StaleResultsRole:
+            return stats.staleResults;
+            break;
+        default:
+            break;
+    }
+
+    return QVariant();
+}
+
 QVariant RunnerModel::headerData(int section, Qt::Orientation orientation, int role) const {
     if (!m_worker) {
         return QVariant();
@@ -256,6 +309,39 @@ QVariant RunnerModel::headerData(int section, Qt::Orientation orientation, int r
             case SourcesUsedRole:
                 return tr("Sources");
                 break;
+            case SessionDataTimeRole:
+                return tr("Session Setup (ms)");
+                break;
+            case MatchLatencyP50Role:
+                return tr("Median Match (ms)");
+                break;
+            case MatchLatencyP95Role:
+                return tr("95th Percentile Match (ms)");
+                break;
+            case MatchLatencyP99Role:
+                return tr("99th Percentile Match (ms)");
+                break;
+            case TimeToFirstMatchRole:
+                return tr("First Match (ms)");
+                break;
+            case MatchesProducedRole:
+                return tr("Matches Produced");
+                break;
+            case MatchesDisplayedRole:
+                return tr("Matches Displayed");
+                break;
+            case MatchRunsRole:
+                return tr("Match Runs");
+                break;
+            case CancellationsRole:
+                return tr("Cancelled Runs");
+                break;
+            case CpuTimeRole:
+                return tr("CPU Time (ms)");
+                break;
+            case StaleResultsRole:
+                return tr("Stale Results");
+                break;
             default:
                 break;
         }
@@ -345,6 +431,11 @@ void RunnerModel::runnerLoaded(int index)
 void RunnerModel::runnerBusy(int index)
 {
     emit dataChanged(createIndex(index, m_busyColumn), createIndex(index, m_busyColumn));
+
+    // the statistics change as the runner starts and finishes matching;
+    // announcing them along with the busy state keeps the update rate sane
+    emit dataChanged(createIndex(index, m_firstStatisticsColumn),
+                     createIndex(index, m_roleColumns.count() - 1));
 }
 
 } //namespace
@@ -30,6 +30,7 @@ namespace Sprinter
 {
 
 class QuerySessionThread;
+struct RunnerMetaData;
 
 class RunnerModel : public QAbstractItemModel
 {
@@ -56,7 +57,19 @@ public:
         VersionRole,
         GeneratesDefaultMatchesRole,
         MatchTypesRole,
-        SourcesUsedRole
+        SourcesUsedRole,
+        // live statistics for the session; durations are in milliseconds
+        SessionDataTimeRole,
+        MatchLatencyP50Role,
+        MatchLatencyP95Role,
+        MatchLatencyP99Role,
+        TimeToFirstMatchRole,
+        MatchesProducedRole,
+        MatchesDisplayedRole,
+        MatchRunsRole,
+        CancellationsRole,
+        CpuTimeRole,
+        StaleResultsRole
     };
     Q_ENUMS(DisplayRoles)
 
@@ -87,6 +100,8 @@ private Q_SLOTS:
     void runnerBusy(int);
 
 private:
+    QVariant statistic(const RunnerMetaData &info, int role) const;
+
     QPointer<QuerySessionThread> m_worker;
     QHash<int, QByteArray> m_roles;
     QVector<int> m_roleColumns;
@@ -95,6 +110,7 @@ private:
     int m_loadedColumn;
     int m_busyColumn;
     int m_iconRoleColumn;
+    int m_firstStatisticsColumn;
     QSize m_iconSize;
 
 public:
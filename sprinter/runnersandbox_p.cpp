@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "runnersandbox_p.h"
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStringList>
+#include <QThread>
+
+#include "daemonclient_p.h"
+#include "daemonprotocol_p.h"
+
+#ifdef Q_OS_LINUX
+#include <signal.h>
+#include <sys/prctl.h>
+#endif
+
+namespace Sprinter
+{
+
+// how long a sandbox has to load its runner and start listening
+static const int s_startTimeout = 10000;
+static const int s_startPollInterval = 20;
+static const int s_killTimeout = 1000;
+static const int s_defaultHangTimeout = 5000;
+
+static QAtomicInt s_disabled(0);
+
+RunnerSandbox::RunnerSandbox(const QString &runnerId, int niceness)
+    : m_runnerId(runnerId),
+      m_niceness(niceness),
+      m_socketPath(QStringLiteral("%1/sprinter-sandbox-%2-%3").arg(DaemonProtocol::runtimeDirectory())
+                   .arg(QCoreApplication::applicationPid()).arg(runnerId)),
+      m_client(new DaemonClient(m_socketPath)),
+      m_process(new SandboxProcess),
+      m_failed(false)
+{
+    m_process->moveToThread(m_client->thread());
+}
+
+RunnerSandbox::~RunnerSandbox()
+{
+    stop();
+    // deleted as the client's thread finishes
+    m_process->deleteLater();
+    delete m_client;
+}
+
+bool RunnerSandbox::isSandboxed(const QString &runnerId, int &niceness)
+{
+    if (s_disabled.load()) {
+        return false;
+    }
+
+    const QStringList entries = QString::fromLocal8Bit(qgetenv("SPRINTER_SANDBOX")).split(QLatin1Char(','), QString::SkipEmptyParts);
+    for (auto const &entry: entries) {
+        const QString id = entry.section(QLatin1Char(':'), 0, 0).trimmed();
+        if (id == runnerId || id == QLatin1String("*")) {
+            if (DaemonProtocol::runtimeDirectory().isEmpty()) {
+                qWarning() << "Not putting" << runnerId << "in a sandbox, as there is no private runtime directory for its socket";
+                return false;
+            }
+
+            niceness = entry.section(QLatin1Char(':'), 1, 1).toInt();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void RunnerSandbox::disable()
+{
+    s_disabled.store(1);
+}
+
+int RunnerSandbox::hangTimeout()
+{
+    bool ok = false;
+    const int timeout = qgetenv("SPRINTER_SANDBOX_TIMEOUT").toInt(&ok);
+    return ok && timeout > 0 ? timeout : s_defaultHangTimeout;
+}
+
+bool RunnerSandbox::ensureRunning()
+{
+    QMutexLocker lock(&m_lock);
+    return isRunning() || (!m_failed && start());
+}
+
+DaemonClient *RunnerSandbox::client() const
+{
+    return m_client;
+}
+
+void RunnerSandbox::restart()
+{
+    QMutexLocker lock(&m_lock);
+    stop();
+}
+
+Qt::ConnectionType RunnerSandbox::connectionType() const
+{
+    return QThread::currentThread() == m_process->thread() ? Qt::DirectConnection
+                                                           : Qt::BlockingQueuedConnection;
+}
+
+bool RunnerSandbox::isRunning() const
+{
+    bool running = false;
+    QMetaObject::invokeMethod(m_process, "isRunning", connectionType(), Q_RETURN_ARG(bool, running));
+    return running;
+}
+
+bool RunnerSandbox::start()
+{
+    // whatever is left of a sandbox that crashed
+    stop();
+
+    QStringList args;
+    args << QStringLiteral("--sandbox") << m_runnerId
+         << QStringLiteral("--socket") << m_socketPath
+         << QStringLiteral("--timeout") << QString::number(s_startTimeout / 1000);
+    if (m_niceness) {
+        args << QStringLiteral("--nice") << QString::number(m_niceness);
+    }
+
+    // the sandbox looks for the runner where we do
+    for (auto const &path: QCoreApplication::libraryPaths()) {
+        args << QStringLiteral("--plugin-path") << path;
+    }
+
+    QString program = QString::fromLocal8Bit(qgetenv("SPRINTER_SANDBOX_EXECUTABLE"));
+    if (program.isEmpty()) {
+        program = QStringLiteral(SPRINTERD_EXECUTABLE);
+        if (!QFile::exists(program)) {
+            // not installed (yet); running from the build tree
+            program = QStringLiteral(SPRINTERD_BUILD_EXECUTABLE);
+        }
+    }
+
+    bool launched = false;
+    QMetaObject::invokeMethod(m_process, "launch", connectionType(), Q_RETURN_ARG(bool, launched),
+                              Q_ARG(QString, program), Q_ARG(QStringList, args));
+    if (!launched) {
+        qWarning() << "Could not start" << program << "to host" << m_runnerId;
+        return false;
+    }
+
+    // sprinterd listens once the runner is loaded
+    QElapsedTimer clock;
+    clock.start();
+    while (!QFile::exists(m_socketPath)) {
+        bool exited = false;
+        QMetaObject::invokeMethod(m_process, "waitForExit", connectionType(), Q_RETURN_ARG(bool, exited),
+                                  Q_ARG(int, s_startPollInterval));
+        if (exited) {
+            // it could not load the runner; it would not the next time either
+            qWarning() << "The sandbox for" << m_runnerId << "exited while starting; not trying again";
+            m_failed = true;
+            stop();
+            return false;
+        } else if (clock.elapsed() > s_startTimeout) {
+            qWarning() << "The sandbox for" << m_runnerId << "did not start";
+            stop();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void RunnerSandbox::stop()
+{
+    QMetaObject::invokeMethod(m_process, "stop", connectionType());
+
+    // waiting requests fail, and the channels are opened again
+    m_client->reset();
+
+    // a killed sprinterd leaves its socket and page files behind
+    QFile::remove(m_socketPath);
+    QDir(DaemonProtocol::pageDirectory(m_socketPath)).removeRecursively();
+}
+
+SandboxProcess::SandboxProcess()
+    : QProcess(0)
+{
+    // nothing reads the output; let it go where ours does
+    setProcessChannelMode(QProcess::ForwardedChannels);
+}
+
+bool SandboxProcess::launch(const QString &program, const QStringList &args)
+{
+    start(program, args);
+    return waitForStarted();
+}
+
+bool SandboxProcess::isRunning() const
+{
+    return state() != QProcess::NotRunning;
+}
+
+bool SandboxProcess::waitForExit(int msecs)
+{
+    return !isRunning() || waitForFinished(msecs);
+}
+
+void SandboxProcess::stop()
+{
+    if (isRunning()) {
+        kill();
+        waitForFinished(s_killTimeout);
+    }
+}
+
+void SandboxProcess::setupChildProcess()
+{
+#ifdef Q_OS_LINUX
+    // in the child, between fork and exec: should we die without getting
+    // to kill the sandbox, it goes too. this is tied to the thread which
+    // forked, the client's, which lasts as long as the sandbox is needed
+    ::prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+}
+
+} // namespace
+
+#include "moc_runnersandbox_p.cpp"
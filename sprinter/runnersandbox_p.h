@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPRINTER_RUNNERSANDBOX_P_H
+#define SPRINTER_RUNNERSANDBOX_P_H
+
+#include <QMutex>
+#include <QProcess>
+#include <QString>
+
+namespace Sprinter
+{
+
+class DaemonClient;
+
+/**
+ * @class SandboxProcess
+ * The sprinterd process of a RunnerSandbox. It lives in the thread of the
+ * sandbox's DaemonClient, whose event loop keeps its state current; it is
+ * only used through its slots, invoked from the sandbox.
+ *
+ * The child stays attached, so its pid can not go to another process
+ * before the child has been reaped here, which is only once it is
+ * known to have exited.
+ */
+class SandboxProcess : public QProcess
+{
+    Q_OBJECT
+
+public:
+    SandboxProcess();
+
+public Q_SLOTS:
+    bool launch(const QString &program, const QStringList &args);
+    bool isRunning() const;
+    // waits up to msecs for the process to exit; true if it has
+    bool waitForExit(int msecs);
+    void stop();
+
+protected:
+    void setupChildProcess();
+};
+
+/**
+ * @class RunnerSandbox
+ * A sprinterd of this process's own which hosts just one runner, so that
+ * a runner which crashes or hangs takes down only its sandbox; a hung
+ * sandbox is killed and another one started. Which runners are put in
+ * sandboxes comes from the SPRINTER_SANDBOX environment variable, a comma
+ * separated list of runner ids (or * for all) each optionally followed by
+ * a colon and the niceness to run the sandbox at, e.g.
+ * "org.kde.sprinter.files:10,org.kde.sprinter.calculator".
+ *
+ * The sandbox is the sprinterd named by the SPRINTER_SANDBOX_EXECUTABLE
+ * environment variable if that is set, otherwise the installed one, or,
+ * before sprinterd is installed, the one in the build tree.
+ *
+ * The runner is stood in for by a RemoteRunner, talking to the sandbox
+ * through a DaemonClient of its own. All methods are thread safe.
+ */
+class RunnerSandbox
+{
+public:
+    RunnerSandbox(const QString &runnerId, int niceness);
+    ~RunnerSandbox();
+
+    /**
+     * @return true if the runner is to run in a sandbox, with niceness
+     * set to the niceness asked for it
+     */
+    static bool isSandboxed(const QString &runnerId, int &niceness);
+
+    /**
+     * Keeps this process from putting runners in sandboxes; called by
+     * sprinterd, which is a sandbox itself or is hosting all runners anyways
+     */
+    static void disable();
+
+    /**
+     * @return how long a sandbox may take to send anything back for a
+     * query before it is taken to be hung, in milliseconds:
+     * SPRINTER_SANDBOX_TIMEOUT if set, otherwise 5 seconds
+     */
+    static int hangTimeout();
+
+    /**
+     * Starts the sandbox if it is not running, e.g. because it crashed
+     * or was killed, and waits for it to listen
+     * @return false if it could not be started, or once a sandbox has
+     *         exited before listening, e.g. because the runner failed to load
+     */
+    bool ensureRunning();
+
+    /**
+     * @return the client connected to the sandbox; the same one for the
+     * lifetime of this object, however often the sandbox is restarted
+     */
+    DaemonClient *client() const;
+
+    /**
+     * Kills the sandbox; ensureRunning starts a new one
+     */
+    void restart();
+
+private:
+    bool isRunning() const;
+    bool start();
+    void stop();
+    Qt::ConnectionType connectionType() const;
+
+    QMutex m_lock;
+    const QString m_runnerId;
+    const int m_niceness;
+    const QString m_socketPath;
+    DaemonClient *m_client;
+    SandboxProcess *m_process;
+    // a sandbox exited before listening, so the runner is not started again
+    bool m_failed;
+};
+
+} // namespace
+
+#endif
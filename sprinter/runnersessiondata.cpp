@@ -22,13 +22,19 @@
 #include "runnersessiondata_p.h"
 
 #include <QDebug>
+#include <QSet>
 
 #include "runner.h"
+#include "runner_p.h"
+#include "runnerstatistics_p.h"
 #include "querycontext.h"
 #include "querymatch_p.h"
 #include "querysession.h"
 #include "querysession_p.h"
 #include "querysessionthread_p.h"
+#include "sessiondataregistry_p.h"
+#include "tracerecorder_p.h"
+#include "tracing_p.h"
 
 // #define DEBUG_SYNC
 // #define DEBUG_UPDATEMATCHES
@@ -36,6 +42,13 @@
 namespace Sprinter
 {
 
+// the dummy session data used as a placeholder has no runner
+static inline const QString &traceId(const Runner *runner)
+{
+    static const QString s_none;
+    return runner ? runner->d->id : s_none;
+}
+
 RunnerSessionData::Busy::Busy(RunnerSessionData *data)
     : m_data(data)
 {
@@ -60,10 +73,12 @@ RunnerSessionData::RunnerSessionData(Runner *runner)
     : QObject(0),
       d(new Private(runner))
 {
+    d->handle = SessionDataRegistry::add(this);
 }
 
 RunnerSessionData::~RunnerSessionData()
 {
+    SessionDataRegistry::remove(d->handle);
     delete d;
 }
 
@@ -130,24 +145,24 @@ void RunnerSessionData::startMatch(const QueryContext &context)
 
     auto updatePaging = [&]() {
             if (context.fetchMore()) {
-                QMutexLocker lock(&d->currentMatchesLock);
                 // this is the minimum number of matches we need to already
                 // have to care about getting more
                 const uint minSize = d->matchOffset + d->pageSize;
+                const int pending = d->pendingCount();
 
-//                 qDebug() << "*****" << minSize << d->currentMatches.size() << d->syncedMatches.size();
-                if (d->currentMatches.isEmpty()) {
-                    if ((uint)d->syncedMatches.size() < minSize) {
+//                 qDebug() << "*****" << minSize << pending << d->syncedCount.loadAcquire();
+                if (pending == 0) {
+                    if ((uint)d->syncedCount.loadAcquire() < minSize) {
                         return false;
                     } else {
                         d->matchOffset = minSize;
                     }
-                } else if ((uint)d->currentMatches.size() < minSize) {
+                } else if ((uint)pending < minSize) {
                     return false;
                 } else {
                     d->matchOffset = minSize;
                 }
-//                 qDebug() << "***** WIN (min, cur, synced)" << minSize << d->currentMatches.size() << d->syncedMatches.size();
+//                 qDebug() << "***** WIN (min, cur, synced)" << minSize << pending << d->syncedCount.loadAcquire();
 
             } else {
                 d->matchOffset = 0;
@@ -167,45 +182,71 @@ void RunnerSessionData::startMatch(const QueryContext &context)
 
     RunnerSessionData::Busy busy(this);
     MatchData matchData(this, context);
+    if (SPRINTER_TRACE_ENABLED(match_start)) {
+        const QString &id = traceId(d->runner);
+        SPRINTER_TRACE3(match_start, id.utf16(), id.size(), this);
+    }
     d->runner->match(matchData);
+    if (SPRINTER_TRACE_ENABLED(match_end)) {
+        const QString &id = traceId(d->runner);
+        SPRINTER_TRACE3(match_end, id.utf16(), id.size(), this);
+    }
 }
 
 void RunnerSessionData::setMatches(const QVector<QueryMatch> &matches, const QueryContext &context)
+{
+    // a shallow copy; the vector only detaches if the caller keeps writing to it
+    setMatches(QVector<QueryMatch>(matches), context);
+}
+
+void RunnerSessionData::setMatches(QVector<QueryMatch> &&matches, const QueryContext &context)
 {
     if (!context.isValid(this)) {
+        if (d->statistics) {
+            d->statistics->staleResultsDropped();
+        }
         return;
     }
 
+    if (SPRINTER_TRACE_ENABLED(set_matches)) {
+        const QString &id = traceId(d->runner);
+        SPRINTER_TRACE4(set_matches, id.utf16(), id.size(), this, matches.size());
+    }
+    if (d->session && d->session->d->worker->trace()->isRecording()) {
+        QVariantMap args;
+        args.insert(QStringLiteral("runner"), traceId(d->runner));
+        args.insert(QStringLiteral("matches"), matches.size());
+        d->session->d->worker->trace()->instant("setMatches", "runner", args);
+    }
+
+    if (d->statistics) {
+        d->statistics->matchesProduced(matches.size());
+    }
+
 #ifdef DEBUG_SYNC
-    qDebug() << this << "New matches from, to: " << d->currentMatches.size() << matches.size();
+    qDebug() << this << "New matches from, to: " << d->pendingCount() << matches.size();
     for (int i = 0; i < matches.count(); ++i) {
         qDebug() << "     " << i << matches[i].title();
     }
 #endif
 
-    {
-        QMutexLocker lock(&d->currentMatchesLock);
-
-        d->lastReceivedMatchOffset = d->matchOffset;
-
-        if (matches.isEmpty()) {
-            if ((uint)d->syncedMatches.size() <= d->lastReceivedMatchOffset) {
-                // nothing going on here; we have not matches and
-                // the syncedMatch set is smaller than the
-                // size it will end up with matches removed already,
-                // so we have nothing to remove
-                return;
-            }
-        } else {
-            for (int i = 0; i < matches.count(); ++i) {
-                matches[i].d->sessionData = this;
-            }
-            d->currentMatches = matches;
-        }
-
-        d->matchesUnsynced = true;
+    if (matches.isEmpty() &&
+        d->pendingCount() == 0 &&
+        (uint)d->syncedCount.loadAcquire() <= d->matchOffset) {
+        // nothing going on here; we have not matches and
+        // the syncedMatch set is smaller than the
+        // size it will end up with matches removed already,
+        // so we have nothing to remove
+        return;
     }
 
+    d->adopt(matches);
+    PendingMatchPage *page = new PendingMatchPage;
+    page->matches = std::move(matches);
+    page->offset = d->matchOffset;
+    page->context = context;
+    d->publish(page);
+
     if (d->session) {
         d->session->d->matchesArrived();
     }
@@ -218,50 +259,16 @@ void RunnerSessionData::updateMatches(const QVector<QueryMatch> &matches)
 #ifdef DEBUG_UPDATEMATCHES
     qDebug() << "updating" << matches.size();
 #endif
-    QMutexLocker lock(&d->currentMatchesLock);
-
+    bool queued = false;
     for (auto const &match: matches) {
-#ifdef DEBUG_UPDATEMATCHES
-        qDebug() << "looking for match of" << match.data();
-#endif
-        if (match.data().isNull()) {
-            continue;
-        }
-
-        bool found = false;
-        for (int i = 0; i < d->currentMatches.size(); ++i) {
-            if (match.data() == d->currentMatches[i].data()) {
-#ifdef DEBUG_UPDATEMATCHES
-                qDebug() << "found update in pending matches at" << i << d->currentMatches[i].data();
-#endif
-                d->currentMatches[i] = match;
-                found = true;
-                break;
-            }
-#ifdef DEBUG_UPDATEMATCHES
-            qDebug() << "compared" << i << match.data() << d->currentMatches[i].data();
-#endif
-        }
-
-        if (found) {
-            continue;
+        if (!match.key().isEmpty() || !match.data().isNull()) {
+            d->queueOp(match, false);
+            queued = true;
         }
+    }
 
-        for (int i = 0; i < d->syncedMatches.size(); ++i) {
-            if (match.data() == d->syncedMatches[i].data()) {
-#ifdef DEBUG_UPDATEMATCHES
-                qDebug() << "found update in existing matches at" << i << d->syncedMatches[i].data();
-#endif
-                d->syncedMatches[i] = match;
-                d->syncedMatches[i].d->sessionData = this;
-                d->updatedMatchIndexes.insert(i);
-                d->session->d->matchesArrived();
-                break;
-            }
-#ifdef DEBUG_UPDATEMATCHES
-            qDebug() << "compared" << i << match.data() << d->syncedMatches[i].data();
-#endif
-        }
+    if (queued) {
+        d->session->d->matchesArrived();
     }
 }
 
@@ -272,59 +279,38 @@ void RunnerSessionData::removeMatches(const QVector<QueryMatch> &matches)
 #ifdef DEBUG_REMOVEMATCHES
     qDebug() << "removing" << matches.size();
 #endif
-    QMutexLocker lock(&d->currentMatchesLock);
-
+    bool queued = false;
     for (auto const &match: matches) {
-#ifdef DEBUG_REMOVEMATCHES
-        qDebug() << "looking for match of" << match.data();
-#endif
-        if (match.data().isNull()) {
-            continue;
-        }
-
-        bool found = false;
-        for (int i = 0; i < d->currentMatches.size(); ++i) {
-            if (match.data() == d->currentMatches[i].data()) {
-#ifdef DEBUG_REMOVEMATCHES
-                qDebug() << "remove match in pending matches at" << i << d->currentMatches[i].data();
-#endif
-                d->currentMatches.removeAt(i);
-                found = true;
-                break;
-            }
-#ifdef DEBUG_REMOVEMATCHES
-            qDebug() << "compared" << i << match.data() << d->currentMatches[i].data();
-#endif
-        }
-
-        if (found) {
-            continue;
+        if (!match.key().isEmpty() || !match.data().isNull()) {
+            d->queueOp(match, true);
+            queued = true;
         }
+    }
 
-        for (int i = 0; i < d->syncedMatches.size(); ++i) {
-            if (match.data() == d->syncedMatches[i].data()) {
-#ifdef DEBUG_REMOVEMATCHES
-                qDebug() << "remove match in existing matches at" << i << d->syncedMatches[i].data();
-#endif
-                d->removedMatchIndexes.insert(i);
-                d->session->d->matchesArrived();
-                break;
-            }
-#ifdef DEBUG_REMOVEMATCHES
-            qDebug() << "compared" << i << match.data() << d->syncedMatches[i].data();
-#endif
-        }
+    if (queued) {
+        d->session->d->matchesArrived();
     }
 }
 
 QVector<QueryMatch> RunnerSessionData::matches(MatchState state) const
 {
-    QMutexLocker lock(&d->currentMatchesLock);
     if (state == SynchronizedMatches) {
         return d->syncedMatches;
-    } else {
-        return d->currentMatches;
     }
+
+    // borrow the pending page for long enough to share its matches; if
+    // a runner publishes a newer one in the meantime, ours is stale
+    PendingMatchPage *page = d->pendingPage.fetchAndStoreAcquire(0);
+    if (!page) {
+        return QVector<QueryMatch>();
+    }
+
+    const QVector<QueryMatch> matches = page->matches;
+    if (!d->pendingPage.testAndSetRelease(0, page)) {
+        delete page;
+    }
+
+    return matches;
 }
 
 void RunnerSessionData::setResultsPageSize(uint pageSize)
@@ -360,6 +346,87 @@ bool RunnerSessionData::canFetchMoreMatches() const
     return d->canFetchMoreMatches;
 }
 
+RunnerSessionData::Private::~Private()
+{
+    delete pendingPage.load();
+
+    PendingMatchOp *op = pendingOps.load();
+    while (op) {
+        PendingMatchOp *next = op->next;
+        delete op;
+        op = next;
+    }
+}
+
+void RunnerSessionData::Private::adopt(const QVector<QueryMatch> &matches) const
+{
+    const QString runnerId = runner ? runner->id() : QString();
+    for (int i = 0; i < matches.size(); ++i) {
+        adopt(matches[i], runnerId);
+    }
+}
+
+void RunnerSessionData::Private::adopt(const QueryMatch &match, const QString &runnerId) const
+{
+    // matches added through MatchData already carry our handle; only
+    // write where needed so shared match data is not touched needlessly
+    if (match.d->sessionData != handle) {
+        match.d->sessionData = handle;
+    }
+
+    // done as late as possible, as the runner may change key or data
+    // after adding the match to a MatchData
+    match.d->updateId(runnerId);
+}
+
+void RunnerSessionData::Private::publish(PendingMatchPage *page)
+{
+    publishedCount.storeRelease(page->matches.size());
+    page->serial = publishedPages.fetchAndAddOrdered(1) + 1;
+
+    // an unsynchronized page we replace was never seen by the GUI thread
+    delete pendingPage.fetchAndStoreOrdered(page);
+}
+
+void RunnerSessionData::Private::queueOp(const QueryMatch &match, bool remove)
+{
+    adopt(match, runner ? runner->id() : QString());
+    PendingMatchOp *op = new PendingMatchOp { 0, match, publishedPages.loadAcquire(), remove };
+    PendingMatchOp *head;
+    do {
+        head = pendingOps.loadAcquire();
+        op->next = head;
+    } while (!pendingOps.testAndSetRelease(head, op));
+}
+
+int RunnerSessionData::Private::pendingCount() const
+{
+    return takenPages.loadAcquire() == publishedPages.loadAcquire() ? 0 : publishedCount.loadAcquire();
+}
+
+void RunnerSessionData::Private::requestClear()
+{
+    clearRequested.fetchAndStoreOrdered(1);
+    if (session) {
+        session->d->matchesArrived();
+    }
+}
+
+PendingMatchOp *RunnerSessionData::Private::takeOps()
+{
+    // the stack is newest first; reverse it into the order of the calls
+    PendingMatchOp *op = pendingOps.fetchAndStoreAcquire(0);
+    PendingMatchOp *ordered = 0;
+    while (op) {
+        PendingMatchOp *next = op->next;
+        op->next = ordered;
+        ordered = op;
+        op = next;
+    }
+
+    return ordered;
+}
+
 void RunnerSessionData::Private::associateSession(QuerySession *newSession)
 {
     if (newSession == session) {
@@ -367,7 +434,7 @@ void RunnerSessionData::Private::associateSession(QuerySession *newSession)
     }
 
     session = newSession;
-    if (session && !currentMatches.isEmpty()) {
+    if (session && (pendingPage.load() || pendingOps.load() || clearRequested.load())) {
         session->d->matchesArrived();
     }
 }
@@ -376,46 +443,111 @@ int RunnerSessionData::Private::syncMatches(int modelOffset)
 {
     Q_ASSERT(session);
 
-    QVector<QueryMatch> unsynced;
+    if (clearRequested.fetchAndStoreAcquire(0)) {
+        dropPending();
+        clearSynced(modelOffset);
+        return 0;
+    }
 
-    QMutexLocker lock(&currentMatchesLock);
-    if (!updatedMatchIndexes.isEmpty()) {
-        for (auto const &index: updatedMatchIndexes) {
-            if (index < syncedMatches.size()) {
-#ifdef DEBUG_UPDATEMATCHES
-                qDebug() << "Telling the model we've updated" << modelOffset + index;
-#endif
-                session->d->matchesUpdated(modelOffset + index, modelOffset + index);
-            }
+    PendingMatchPage *page = pendingPage.fetchAndStoreAcquire(0);
+    PendingMatchOp *ops = takeOps();
+
+    // changes requested before the page was published apply to the
+    // matches it replaces, everything after to the page itself
+    while (ops && page && ops->pageSerial < page->serial) {
+        applyOp(ops, modelOffset);
+        PendingMatchOp *next = ops->next;
+        delete ops;
+        ops = next;
+    }
+
+    if (page) {
+        takenPages.storeRelease(page->serial);
+        mergePage(page, modelOffset);
+        syncedContext = page->context;
+        if (statistics) {
+            // the page may have been cut down to the page size while merging
+            const int offset = page->offset;
+            statistics->matchesDisplayed(qMax(0, syncedMatches.size() - offset));
         }
+        delete page;
+    }
+
+    while (ops) {
+        applyOp(ops, modelOffset);
+        PendingMatchOp *next = ops->next;
+        delete ops;
+        ops = next;
+    }
+
+    syncedCount.storeRelease(syncedMatches.size());
+    return syncedMatches.size();
+}
+
+void RunnerSessionData::Private::dropPending()
+{
+    PendingMatchPage *page = pendingPage.fetchAndStoreAcquire(0);
+    if (page) {
+        takenPages.storeRelease(page->serial);
+        delete page;
+    }
 
-        updatedMatchIndexes.clear();
+    PendingMatchOp *op = takeOps();
+    while (op) {
+        PendingMatchOp *next = op->next;
+        delete op;
+        op = next;
+    }
+}
+
+void RunnerSessionData::Private::clearSynced(int modelOffset)
+{
+    if (syncedMatches.isEmpty()) {
+        return;
     }
 
-    if (!removedMatchIndexes.isEmpty()) {
-        for (auto const &index: removedMatchIndexes) {
-            if (index < syncedMatches.size()) {
+    // one removal for the whole block, rather than a model reset
+    session->d->removingMatches(modelOffset, modelOffset + syncedMatches.size() - 1);
+    syncedMatches.clear();
+    syncedContext = QueryContext();
+    syncedCount.storeRelease(0);
+    session->d->matchesRemoved();
+}
+
+void RunnerSessionData::Private::applyOp(const PendingMatchOp *op, int modelOffset)
+{
+    const quint64 id = op->match.d->id;
+    for (int i = 0; i < syncedMatches.size(); ++i) {
+        if (id != syncedMatches[i].d->id) {
+            continue;
+        }
+
+        if (op->remove) {
 #ifdef DEBUG_REMOVEMATCHES
-                qDebug() << "Telling the model we've removed" << modelOffset + index;
+            qDebug() << "Telling the model we've removed" << modelOffset + i;
 #endif
-                session->d->removingMatches(modelOffset + index, modelOffset + index);
-                syncedMatches.removeAt(index);
-                session->d->matchesRemoved();
-            }
+            session->d->removingMatches(modelOffset + i, modelOffset + i);
+            syncedMatches.removeAt(i);
+            session->d->matchesRemoved();
+        } else {
+#ifdef DEBUG_UPDATEMATCHES
+            qDebug() << "Telling the model we've updated" << modelOffset + i;
+#endif
+            const QuerySession::Private::RoleMask roles =
+                QuerySession::Private::changedRoles(syncedMatches[i], op->match);
+            syncedMatches[i] = op->match;
+            session->d->matchesUpdated(modelOffset + i, modelOffset + i, roles);
         }
 
-        removedMatchIndexes.clear();
+        return;
     }
+}
 
-    lastSyncedMatchOffset = lastReceivedMatchOffset;
-
-    if (matchesUnsynced) {
-        matchesUnsynced = false;
-        unsynced = currentMatches;
-        currentMatches.clear();
-    } else {
-        return syncedMatches.size();
-    }
+void RunnerSessionData::Private::mergePage(PendingMatchPage *page, int modelOffset)
+{
+    QVector<QueryMatch> unsynced;
+    unsynced.swap(page->matches);
+    const uint lastSyncedMatchOffset = page->offset;
 
 #ifdef DEBUG_SYNC
     qDebug() << "SYNC model offset, synced, unsynced:" << modelOffset << syncedMatches.size() << unsynced.size();
@@ -432,8 +564,8 @@ int RunnerSessionData::Private::syncMatches(int modelOffset)
         // no sync'd matches, so we only need to do something if we now do have matches
         if (!unsynced.isEmpty()) {
             // we had no matches, now we do
-            session->d->addingMatches(modelOffset, modelOffset + unsynced.size());
-            syncedMatches = unsynced;
+            session->d->addingMatches(modelOffset, modelOffset + unsynced.size() - 1);
+            syncedMatches.swap(unsynced);
             session->d->matchesAdded();
         }
     } else if (unsynced.isEmpty()) {
@@ -442,7 +574,7 @@ int RunnerSessionData::Private::syncMatches(int modelOffset)
         qDebug() << "HAD MATCHESS .. NOW WE DON'T? synced/lastOffset" << syncedMatches.size() << lastSyncedMatchOffset;
 #endif
         if ((uint)syncedMatches.size() > lastSyncedMatchOffset) {
-            session->d->removingMatches(modelOffset + lastSyncedMatchOffset, modelOffset + syncedMatches.size() - lastSyncedMatchOffset);
+            session->d->removingMatches(modelOffset + lastSyncedMatchOffset, modelOffset + syncedMatches.size() - 1);
             syncedMatches.resize(lastSyncedMatchOffset);
             session->d->matchesRemoved();
         }
@@ -450,45 +582,180 @@ int RunnerSessionData::Private::syncMatches(int modelOffset)
         // now the more complex situation: we have both synced and new matches
         // these need to be merged with the correct add/remove/update rows
         // methods called in the session (the model)
+        if (moveMatches(lastSyncedMatchOffset, unsynced, modelOffset)) {
+            return;
+        }
+
         const uint oldCount = syncedMatches.size() - lastSyncedMatchOffset;
         const uint newCount = unsynced.size();
         if (oldCount == newCount) {
-            for (uint i = 0; i < newCount; ++i) {
-                syncedMatches[i + lastSyncedMatchOffset] = unsynced[i];
-            }
-
-            session->d->matchesUpdated(modelOffset + lastSyncedMatchOffset,
-                                       modelOffset + lastSyncedMatchOffset + newCount);
+            replaceMatches(lastSyncedMatchOffset, unsynced, newCount, modelOffset);
         } else if (oldCount < newCount) {
             session->d->addingMatches(modelOffset + syncedMatches.size(),
                                       modelOffset + syncedMatches.size() +
-                                      (newCount - oldCount));
+                                      (newCount - oldCount) - 1);
 //             qDebug() << "was" << syncedMatches.size() << "will be"
 //                      << (lastSyncedMatchOffset + newCount)
 //                      << "has" << newCount << unsynced.size();
             syncedMatches.resize(lastSyncedMatchOffset + newCount);
 
-            for (uint i = 0; i < newCount; ++i) {
-                syncedMatches[i + lastSyncedMatchOffset] = unsynced[i];
+            for (uint i = oldCount; i < newCount; ++i) {
+                syncedMatches[i + lastSyncedMatchOffset] = std::move(unsynced[i]);
             }
             session->d->matchesAdded();
-            session->d->matchesUpdated(modelOffset + lastSyncedMatchOffset,
-                                       modelOffset + lastSyncedMatchOffset + oldCount);
+            replaceMatches(lastSyncedMatchOffset, unsynced, oldCount, modelOffset);
         } else {
             // more old matches than new
             session->d->removingMatches(modelOffset + lastSyncedMatchOffset + newCount,
-                                        modelOffset + lastSyncedMatchOffset + oldCount);
-            syncedMatches.resize(modelOffset + lastSyncedMatchOffset + newCount);
-            for (uint i = 0; i < newCount; ++i) {
-                syncedMatches[i + lastSyncedMatchOffset] = unsynced[i];
-            }
+                                        modelOffset + lastSyncedMatchOffset + oldCount - 1);
+            syncedMatches.resize(lastSyncedMatchOffset + newCount);
             session->d->matchesRemoved();
-            session->d->matchesUpdated(modelOffset + lastSyncedMatchOffset,
-                                       modelOffset + lastSyncedMatchOffset + newCount);
+            replaceMatches(lastSyncedMatchOffset, unsynced, newCount, modelOffset);
         }
     }
+}
 
-    return syncedMatches.size();
+bool RunnerSessionData::Private::moveMatches(int base, QVector<QueryMatch> &unsynced, int modelOffset)
+{
+    // matching up old and new rows only works if the ids are unique;
+    // if not, e.g. because the runner sets neither key nor data, the
+    // caller falls back to replacing rows by position
+    if (syncedMatches.size() < base) {
+        return false;
+    }
+
+    QSet<quint64> newIds;
+    for (int i = 0; i < unsynced.size(); ++i) {
+        const quint64 id = unsynced[i].d->id;
+        if (newIds.contains(id)) {
+            return false;
+        }
+        newIds.insert(id);
+    }
+
+    QSet<quint64> oldIds;
+    for (int i = base; i < syncedMatches.size(); ++i) {
+        const quint64 id = syncedMatches[i].d->id;
+        if (oldIds.contains(id)) {
+            return false;
+        }
+        oldIds.insert(id);
+    }
+
+    // first remove the matches which are gone, in runs from the end
+    int row = syncedMatches.size() - 1;
+    while (row >= base) {
+        if (newIds.contains(syncedMatches[row].d->id)) {
+            --row;
+            continue;
+        }
+
+        const int last = row;
+        while (row >= base && !newIds.contains(syncedMatches[row].d->id)) {
+            --row;
+        }
+
+#ifdef DEBUG_SYNC
+        qDebug() << "removing rows" << modelOffset + row + 1 << modelOffset + last;
+#endif
+        session->d->removingMatches(modelOffset + row + 1, modelOffset + last);
+        syncedMatches.remove(row + 1, last - row);
+        session->d->matchesRemoved();
+    }
+
+    // then move the ones which remain into the order of the new page
+    int target = 0;
+    for (int i = 0; i < unsynced.size(); ++i) {
+        const quint64 id = unsynced[i].d->id;
+        if (!oldIds.contains(id)) {
+            continue;
+        }
+
+        int from = target;
+        while (syncedMatches[base + from].d->id != id) {
+            ++from;
+        }
+
+        if (from != target) {
+#ifdef DEBUG_SYNC
+            qDebug() << "moving row" << modelOffset + base + from << "to" << modelOffset + base + target;
+#endif
+            session->d->movingMatch(modelOffset + base + from, modelOffset + base + target);
+            const QueryMatch match = syncedMatches[base + from];
+            syncedMatches.remove(base + from);
+            syncedMatches.insert(base + target, match);
+            session->d->matchMoved();
+        }
+
+        ++target;
+    }
+
+    // finally insert the new ones in runs and update the ones which stayed
+    QuerySession::Private::RoleMask roles = 0;
+    int first = -1;
+    int last = -1;
+    int i = 0;
+    while (i < unsynced.size()) {
+        if (oldIds.contains(unsynced[i].d->id)) {
+            QueryMatch &synced = syncedMatches[base + i];
+            const QuerySession::Private::RoleMask changed =
+                QuerySession::Private::changedRoles(synced, unsynced[i]);
+            if (changed) {
+                roles |= changed;
+                if (first < 0) {
+                    first = base + i;
+                }
+                last = base + i;
+            }
+
+            synced = std::move(unsynced[i]);
+            ++i;
+            continue;
+        }
+
+        const int start = i;
+        while (i < unsynced.size() && !oldIds.contains(unsynced[i].d->id)) {
+            ++i;
+        }
+
+        session->d->addingMatches(modelOffset + base + start, modelOffset + base + i - 1);
+        for (int j = start; j < i; ++j) {
+            syncedMatches.insert(base + j, unsynced[j]);
+        }
+        session->d->matchesAdded();
+    }
+
+    if (roles) {
+        session->d->matchesUpdated(modelOffset + first, modelOffset + last, roles);
+    }
+
+    return true;
+}
+
+void RunnerSessionData::Private::replaceMatches(int row, QVector<QueryMatch> &unsynced, int count, int modelOffset)
+{
+    // only the rows and roles which actually changed are announced
+    QuerySession::Private::RoleMask roles = 0;
+    int first = -1;
+    int last = -1;
+    for (int i = 0; i < count; ++i) {
+        QueryMatch &synced = syncedMatches[row + i];
+        const QuerySession::Private::RoleMask changed =
+            QuerySession::Private::changedRoles(synced, unsynced[i]);
+        if (changed) {
+            roles |= changed;
+            if (first < 0) {
+                first = row + i;
+            }
+            last = row + i;
+        }
+
+        synced = std::move(unsynced[i]);
+    }
+
+    if (roles) {
+        session->d->matchesUpdated(modelOffset + first, modelOffset + last, roles);
+    }
 }
 
 } // namespace
@@ -116,24 +116,34 @@ public:
      */
     void setMatches(const QVector<QueryMatch> &matches, const QueryContext &context);
 
+    /**
+     * Sets the matches for a query, taking over the vector rather than
+     * sharing it. Otherwise identical to the overload above.
+     */
+    void setMatches(QVector<QueryMatch> &&matches, const QueryContext &context);
+
     /**
      * Updates existing matches with new data. The matches are compared using
-     * the content of their data() to identify which matches to update. If no
-     * corresponding matches are found in either the pending or synchronized
-     * states, the updated match is discarded.
+     * their key(), or the content of their data() if they have no key, to
+     * identify which matches to update. If no corresponding matches are found
+     * in either the pending or synchronized states, the updated match is
+     * discarded.
      * @param matches the matches to use as updated data
      */
     void updateMatches(const QVector<QueryMatch> &matches);
 
     /**
-     * Removes matches. The matches are compared using the content of their data()
-     * to identify which matches to update. If no corresponding matches are found
-     * in either the pending or synchronized states, the removed match is discarded.
+     * Removes matches. The matches are compared using their key(), or the content
+     * of their data() if they have no key, to identify which matches to remove.
+     * If no corresponding matches are found in either the pending or
+     * synchronized states, the removed match is discarded.
      * @param matches the matches which should be removed
      */
     void removeMatches(const QVector<QueryMatch> &matches);
 
     /**
+     * Must be called from the thread the QuerySession lives in. Runners
+     * never wait on this, nor does it wait on them.
      * @param state whether to return pending or synchronized matches
      * @return the current matches held by this session data object
      */
@@ -201,6 +211,7 @@ protected:
     virtual bool shouldStartMatch(const QueryContext &context) const;
 
 private:
+    friend class MatchData;
     friend class QuerySessionThread;
     friend class QueryContext;
 
@@ -22,50 +22,109 @@
 #define RUNNERSESSIONDATA_PRIVATE_H
 
 #include <QAtomicInt>
-#include <QMutex>
-#include <QMutexLocker>
-#include <QSet>
-#include <QUuid>
+#include <QAtomicPointer>
+#include <QSharedPointer>
+#include <QVector>
+
+#include "querycontext.h"
 
 namespace Sprinter
 {
 
+class RunnerStatistics;
+
+// a page of matches published by a runner, waiting to be synchronized
+struct PendingMatchPage
+{
+    QVector<QueryMatch> matches;
+    // the result offset the page was generated for
+    uint offset;
+    int serial;
+    QueryContext context;
+};
+
+// an update or removal requested by a runner; these are kept as a
+// push-only stack, newest first, until the GUI thread takes them all
+struct PendingMatchOp
+{
+    PendingMatchOp *next;
+    QueryMatch match;
+    // the serial of the last page published before this op
+    int pageSerial;
+    bool remove;
+};
+
 class RunnerSessionData::Private
 {
 public:
     Private(Runner *r)
         : runner(r),
+          handle(0),
           session(0),
-          currentMatchesLock(QMutex::Recursive),
-          matchesUnsynced(false),
+          sessionId(0),
           canFetchMoreMatches(false),
           enabled(false),
           pageSize(10),
-          matchOffset(0),
-          lastReceivedMatchOffset(0),
-          lastSyncedMatchOffset(0)
+          matchOffset(0)
     {
     }
 
+    ~Private();
+
+    // in runner threads
+    void publish(PendingMatchPage *page);
+    void queueOp(const QueryMatch &match, bool remove);
+    int pendingCount() const;
+    void requestClear();
+
+    // in the GUI thread
     int syncMatches(int offset);
+    void mergePage(PendingMatchPage *page, int modelOffset);
+    void applyOp(const PendingMatchOp *op, int modelOffset);
+    bool moveMatches(int base, QVector<QueryMatch> &unsynced, int modelOffset);
+    void replaceMatches(int row, QVector<QueryMatch> &unsynced, int count, int modelOffset);
+    PendingMatchOp *takeOps();
+    void dropPending();
+    void clearSynced(int modelOffset);
+
+    // thread agnostic
     void associateSession(QuerySession *session);
+    void adopt(const QVector<QueryMatch> &matches) const;
+    void adopt(const QueryMatch &match, const QString &runnerId) const;
 
     Runner *runner;
+    // our SessionDataRegistry handle, as stored in our matches
+    quint64 handle;
     QAtomicInt busyCount;
+
+    // runner threads hand matches to the GUI thread through these without
+    // locking: a new page replaces any unsynchronized one with an atomic
+    // swap, and updates/removals are pushed onto a stack. Only the GUI
+    // thread takes from them, and whoever takes a page or op owns it.
+    QAtomicPointer<PendingMatchPage> pendingPage;
+    QAtomicPointer<PendingMatchOp> pendingOps;
+    QAtomicInt publishedPages;
+    QAtomicInt takenPages;
+    QAtomicInt publishedCount;
+    // mirrors syncedMatches.size() for the runner threads
+    QAtomicInt syncedCount;
+    // set when the runner was disabled; the next sync drops all matches
+    QAtomicInt clearRequested;
+
+    // only touched in the GUI thread
     QVector<QueryMatch> syncedMatches;
-    QVector<QueryMatch> currentMatches;
-    QSet<int> updatedMatchIndexes;
-    QSet<int> removedMatchIndexes;
+    // the context of the last page synced; only while it is valid are
+    // the synced matches for the current query
+    QueryContext syncedContext;
+
     QuerySession *session;
-    QMutex currentMatchesLock;
-    QUuid sessionId;
-    bool matchesUnsynced;
+    quint64 sessionId;
+    // shared with the runner's metadata; 0 for the placeholder session data
+    QSharedPointer<RunnerStatistics> statistics;
     bool canFetchMoreMatches;
     bool enabled;
     uint pageSize;
     uint matchOffset;
-    uint lastReceivedMatchOffset;
-    uint lastSyncedMatchOffset;
 };
 
 } // namespace
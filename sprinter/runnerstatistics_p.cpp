@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "runnerstatistics_p.h"
+
+#include <algorithm>
+
+#include <time.h>
+
+namespace Sprinter
+{
+
+LatencySamples::LatencySamples(int capacity)
+    : m_samples(capacity),
+      m_next(0),
+      m_count(0)
+{
+}
+
+void LatencySamples::add(qint64 usecs)
+{
+    m_samples[m_next] = usecs;
+    m_next = (m_next + 1) % m_samples.size();
+    m_count = qMin(m_count + 1, m_samples.size());
+}
+
+void LatencySamples::clear()
+{
+    m_next = m_count = 0;
+}
+
+int LatencySamples::count() const
+{
+    return m_count;
+}
+
+qint64 LatencySamples::percentile(int percent) const
+{
+    if (m_count < 1) {
+        return -1;
+    }
+
+    // nearest rank; the window is small, so a partial sort of a copy is cheap
+    QVector<qint64> sorted = m_samples.mid(0, m_count);
+    const int rank = qBound(0, (percent * m_count + 99) / 100 - 1, m_count - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+QVector<int> LatencySamples::histogram(const QVector<qint64> &bounds) const
+{
+    QVector<int> counts(bounds.size() + 1);
+    for (int i = 0; i < m_count; ++i) {
+        const int bucket = std::lower_bound(bounds.constBegin(), bounds.constEnd(), m_samples[i]) - bounds.constBegin();
+        ++counts[bucket];
+    }
+
+    return counts;
+}
+
+RunnerStatistics::RunnerStatistics()
+    : m_timeToFirstMatch(64),
+      m_sessionDataTime(-1),
+      m_matchesProduced(0),
+      m_matchesDisplayed(0),
+      m_cpuTime(0),
+      m_matchRuns(0),
+      m_cancellations(0),
+      m_staleResults(0),
+      m_awaitingFirstMatch(false)
+{
+}
+
+qint64 RunnerStatistics::threadCpuTime()
+{
+#if defined(Q_OS_UNIX) && defined(CLOCK_THREAD_CPUTIME_ID)
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+        return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+    }
+#endif
+    return 0;
+}
+
+void RunnerStatistics::sessionDataCreated(qint64 usecs)
+{
+    QMutexLocker lock(&m_lock);
+    m_sessionDataTime = usecs;
+}
+
+void RunnerStatistics::queryStarted()
+{
+    QMutexLocker lock(&m_lock);
+    m_sinceQuery.start();
+    m_awaitingFirstMatch = true;
+}
+
+void RunnerStatistics::matchFinished(qint64 usecs, qint64 cpuUsecs, bool cancelled)
+{
+    QMutexLocker lock(&m_lock);
+    m_matchLatency.add(usecs);
+    m_cpuTime += cpuUsecs;
+    ++m_matchRuns;
+    if (cancelled) {
+        ++m_cancellations;
+    }
+}
+
+void RunnerStatistics::matchesProduced(int count)
+{
+    QMutexLocker lock(&m_lock);
+    m_matchesProduced += count;
+    if (count > 0 && m_awaitingFirstMatch) {
+        m_awaitingFirstMatch = false;
+        m_timeToFirstMatch.add(m_sinceQuery.nsecsElapsed() / 1000);
+    }
+}
+
+void RunnerStatistics::matchesDisplayed(int count)
+{
+    QMutexLocker lock(&m_lock);
+    m_matchesDisplayed += count;
+}
+
+void RunnerStatistics::staleResultsDropped()
+{
+    QMutexLocker lock(&m_lock);
+    ++m_staleResults;
+}
+
+RunnerStatistics::Snapshot RunnerStatistics::snapshot() const
+{
+    QMutexLocker lock(&m_lock);
+    Snapshot s;
+    s.sessionDataTime = m_sessionDataTime;
+    s.matchLatencyP50 = m_matchLatency.percentile(50);
+    s.matchLatencyP95 = m_matchLatency.percentile(95);
+    s.matchLatencyP99 = m_matchLatency.percentile(99);
+    s.timeToFirstMatch = m_timeToFirstMatch.percentile(50);
+    s.matchesProduced = m_matchesProduced;
+    s.matchesDisplayed = m_matchesDisplayed;
+    s.matchRuns = m_matchRuns;
+    s.cancellations = m_cancellations;
+    s.cpuTime = m_cpuTime;
+    s.staleResults = m_staleResults;
+    return s;
+}
+
+QVariant RunnerStatistics::msecs(qint64 usecs)
+{
+    return usecs < 0 ? QVariant() : QVariant(usecs / 1000.0);
+}
+
+QVariantMap RunnerStatistics::toMap() const
+{
+    const Snapshot s = snapshot();
+    QVariantMap map;
+    map.insert(QStringLiteral("SessionDataTime"), msecs(s.sessionDataTime));
+    map.insert(QStringLiteral("MatchLatencyP50"), msecs(s.matchLatencyP50));
+    map.insert(QStringLiteral("MatchLatencyP95"), msecs(s.matchLatencyP95));
+    map.insert(QStringLiteral("MatchLatencyP99"), msecs(s.matchLatencyP99));
+    map.insert(QStringLiteral("TimeToFirstMatch"), msecs(s.timeToFirstMatch));
+    map.insert(QStringLiteral("MatchesProduced"), s.matchesProduced);
+    map.insert(QStringLiteral("MatchesDisplayed"), s.matchesDisplayed);
+    map.insert(QStringLiteral("MatchRuns"), s.matchRuns);
+    map.insert(QStringLiteral("Cancellations"), s.cancellations);
+    map.insert(QStringLiteral("CpuTime"), msecs(s.cpuTime));
+    map.insert(QStringLiteral("StaleResults"), s.staleResults);
+    return map;
+}
+
+} // namespace
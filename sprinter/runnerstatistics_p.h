@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPRINTER_RUNNERSTATISTICS_P_H
+#define SPRINTER_RUNNERSTATISTICS_P_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QVariantMap>
+#include <QVector>
+
+namespace Sprinter
+{
+
+/**
+ * The most recent samples of a duration, for percentiles over a sliding
+ * window of them. Not thread safe.
+ */
+class LatencySamples
+{
+public:
+    LatencySamples(int capacity = 256);
+
+    void add(qint64 usecs);
+    void clear();
+    int count() const;
+
+    /**
+     * @return the given percentile (0-100) of the samples, or -1 if
+     * there are none
+     */
+    qint64 percentile(int percent) const;
+
+    /**
+     * @return how many samples fall in each bucket: bucket i holds the
+     * samples no larger than bounds[i] (and larger than bounds[i - 1]),
+     * with one more bucket at the end for anything above the last bound
+     */
+    QVector<int> histogram(const QVector<qint64> &bounds) const;
+
+private:
+    QVector<qint64> m_samples;
+    int m_next;
+    int m_count;
+};
+
+/**
+ * Performance figures for one runner, collected over the lifetime of the
+ * QuerySession. They are recorded from the runner threads and the GUI
+ * thread alike, so all methods are thread safe. Durations are in
+ * microseconds; -1 means nothing has been measured yet.
+ */
+class RunnerStatistics
+{
+public:
+    struct Snapshot
+    {
+        qint64 sessionDataTime;
+        qint64 matchLatencyP50;
+        qint64 matchLatencyP95;
+        qint64 matchLatencyP99;
+        qint64 timeToFirstMatch;
+        qint64 matchesProduced;
+        qint64 matchesDisplayed;
+        int matchRuns;
+        int cancellations;
+        qint64 cpuTime;
+        int staleResults;
+    };
+
+    RunnerStatistics();
+
+    /**
+     * @return the CPU time used by the calling thread so far, or 0 where
+     * that can not be measured
+     */
+    static qint64 threadCpuTime();
+
+    /**
+     * @return a duration in microseconds as milliseconds, or an invalid
+     * QVariant if it is -1
+     */
+    static QVariant msecs(qint64 usecs);
+
+    void sessionDataCreated(qint64 usecs);
+    void queryStarted();
+    void matchFinished(qint64 usecs, qint64 cpuUsecs, bool cancelled);
+    void matchesProduced(int count);
+    void matchesDisplayed(int count);
+    void staleResultsDropped();
+
+    Snapshot snapshot() const;
+
+    /**
+     * @return the snapshot as a map, with durations in milliseconds; keys
+     * are named after the matching RunnerModel roles, without "Role"
+     */
+    QVariantMap toMap() const;
+
+private:
+    mutable QMutex m_lock;
+    LatencySamples m_matchLatency;
+    LatencySamples m_timeToFirstMatch;
+    QElapsedTimer m_sinceQuery;
+    qint64 m_sessionDataTime;
+    qint64 m_matchesProduced;
+    qint64 m_matchesDisplayed;
+    qint64 m_cpuTime;
+    int m_matchRuns;
+    int m_cancellations;
+    int m_staleResults;
+    bool m_awaitingFirstMatch;
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sessiondataregistry_p.h"
+
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVector>
+
+namespace Sprinter
+{
+
+static const quint32 SlotsPerChunk = 256;
+static const quint32 MaxChunks = 256;
+
+struct SessionDataSlot
+{
+    QAtomicPointer<RunnerSessionData> data;
+    QAtomicInt generation;
+};
+
+// slots live in chunks which are allocated on demand and never move,
+// so lookups need no lock; only adding and removing is serialized
+struct SessionDataSlots
+{
+    SessionDataSlots()
+        : nextSlot(1) // 0 is reserved so that a null handle is never valid
+    {
+    }
+
+    ~SessionDataSlots()
+    {
+        for (quint32 i = 0; i < MaxChunks; ++i) {
+            delete [] chunks[i].load();
+        }
+    }
+
+    SessionDataSlot *slot(quint32 index)
+    {
+        SessionDataSlot *chunk = chunks[index / SlotsPerChunk].loadAcquire();
+        return chunk ? chunk + (index % SlotsPerChunk) : 0;
+    }
+
+    QAtomicPointer<SessionDataSlot> chunks[MaxChunks];
+    QMutex lock;
+    QVector<quint32> freeSlots;
+    quint32 nextSlot;
+};
+
+Q_GLOBAL_STATIC(SessionDataSlots, s_slots)
+
+quint64 SessionDataRegistry::add(RunnerSessionData *data)
+{
+    SessionDataSlots *slots = s_slots();
+    if (!slots) {
+        return 0;
+    }
+
+    QMutexLocker lock(&slots->lock);
+
+    quint32 index;
+    if (!slots->freeSlots.isEmpty()) {
+        index = slots->freeSlots.takeLast();
+    } else if (slots->nextSlot < SlotsPerChunk * MaxChunks) {
+        index = slots->nextSlot++;
+        QAtomicPointer<SessionDataSlot> &chunk = slots->chunks[index / SlotsPerChunk];
+        if (!chunk.load()) {
+            chunk.storeRelease(new SessionDataSlot[SlotsPerChunk]);
+        }
+    } else {
+        qWarning("Sprinter: out of session data slots");
+        return 0;
+    }
+
+    SessionDataSlot *slot = slots->slot(index);
+    slot->data.storeRelease(data);
+    return (quint64(quint32(slot->generation.loadAcquire())) << 32) | index;
+}
+
+void SessionDataRegistry::remove(quint64 handle)
+{
+    const quint32 index = handle & 0xffffffff;
+    SessionDataSlots *slots = s_slots();
+    if (!index || !slots) {
+        return;
+    }
+
+    QMutexLocker lock(&slots->lock);
+    SessionDataSlot *slot = slots->slot(index);
+    if (!slot || quint32(slot->generation.loadAcquire()) != quint32(handle >> 32)) {
+        return;
+    }
+
+    // clear first, then bump the generation: see lookup
+    slot->data.storeRelease(0);
+    slot->generation.fetchAndAddOrdered(1);
+    slots->freeSlots.append(index);
+}
+
+RunnerSessionData *SessionDataRegistry::lookup(quint64 handle)
+{
+    const quint32 index = handle & 0xffffffff;
+    const quint32 generation = handle >> 32;
+    SessionDataSlots *slots = s_slots();
+    if (!index || !slots) {
+        return 0;
+    }
+
+    SessionDataSlot *slot = slots->slot(index);
+    if (!slot || quint32(slot->generation.loadAcquire()) != generation) {
+        return 0;
+    }
+
+    RunnerSessionData *data = slot->data.loadAcquire();
+
+    // if the slot was reused in the meantime the generation has moved on
+    if (quint32(slot->generation.loadAcquire()) != generation) {
+        return 0;
+    }
+
+    return data;
+}
+
+} // namespace
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPRINTER_SESSIONDATAREGISTRY_P_H
+#define SPRINTER_SESSIONDATAREGISTRY_P_H
+
+#include <QtGlobal>
+
+namespace Sprinter
+{
+
+class RunnerSessionData;
+
+/**
+ * @class SessionDataRegistry
+ * Hands out compact handles for RunnerSessionData objects so that
+ * QueryMatch can refer to its session data with a plain integer rather
+ * than a QPointer. Copying a handle costs nothing, where every QPointer
+ * copy is an atomic reference count operation on a block shared by all
+ * matches of that session data, from all runner threads at once.
+ *
+ * A handle is a slot index in the low 32 bits and the slot's generation
+ * in the high 32 bits; slots are reused with a new generation so stale
+ * handles resolve to null just as a QPointer would. Zero is never a
+ * valid handle.
+ */
+class SessionDataRegistry
+{
+public:
+    static quint64 add(RunnerSessionData *data);
+    static void remove(quint64 handle);
+    static RunnerSessionData *lookup(quint64 handle);
+};
+
+} // namespace
+
+#endif
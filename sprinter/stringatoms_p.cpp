@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stringatoms_p.h"
+
+#include <QHash>
+#include <QReadLocker>
+#include <QReadWriteLock>
+#include <QVector>
+#include <QWriteLocker>
+
+namespace Sprinter
+{
+
+struct AtomTable
+{
+    QReadWriteLock lock;
+    QHash<QString, int> atoms;
+    QVector<QString> strings;
+};
+
+Q_GLOBAL_STATIC(AtomTable, s_atoms)
+
+int StringAtoms::intern(const QString &string)
+{
+    AtomTable *table = s_atoms();
+
+    {
+        QReadLocker lock(&table->lock);
+        QHash<QString, int>::const_iterator it = table->atoms.constFind(string);
+        if (it != table->atoms.constEnd()) {
+            return it.value();
+        }
+    }
+
+    QWriteLocker lock(&table->lock);
+    QHash<QString, int>::const_iterator it = table->atoms.constFind(string);
+    if (it != table->atoms.constEnd()) {
+        // someone else got there first
+        return it.value();
+    }
+
+    const int atom = table->strings.size();
+    table->strings.append(string);
+    table->atoms.insert(string, atom);
+    return atom;
+}
+
+int StringAtoms::find(const QString &string)
+{
+    AtomTable *table = s_atoms();
+    QReadLocker lock(&table->lock);
+    return table->atoms.value(string, -1);
+}
+
+QString StringAtoms::string(int atom)
+{
+    AtomTable *table = s_atoms();
+    QReadLocker lock(&table->lock);
+    return atom >= 0 && atom < table->strings.size() ? table->strings.at(atom) : QString();
+}
+
+QBitArray StringAtoms::atomSet(const QStringList &strings)
+{
+    QBitArray set;
+    for (auto const &string: strings) {
+        const int atom = intern(string);
+        if (atom >= set.size()) {
+            set.resize(atom + 1);
+        }
+        set.setBit(atom);
+    }
+
+    return set;
+}
+
+} // namespace
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPRINTER_STRINGATOMS_P_H
+#define SPRINTER_STRINGATOMS_P_H
+
+#include <QBitArray>
+#include <QString>
+#include <QStringList>
+
+namespace Sprinter
+{
+
+/**
+ * @class StringAtoms
+ * A process-wide table of interned strings, such as runner ids. Each
+ * distinct string is given a small, dense integer (an atom) which never
+ * changes for the life of the process, so that comparisons become integer
+ * compares and sets of strings can be held in a QBitArray.
+ *
+ * All methods are thread safe.
+ */
+class StringAtoms
+{
+public:
+    /**
+     * @return the atom for the string, adding it to the table if needed
+     */
+    static int intern(const QString &string);
+
+    /**
+     * @return the atom for the string, or -1 if it has not been interned
+     */
+    static int find(const QString &string);
+
+    /**
+     * @return the (shared) string for an atom
+     */
+    static QString string(int atom);
+
+    /**
+     * @return a set with the bit for the atom of each string set
+     */
+    static QBitArray atomSet(const QStringList &strings);
+
+    /**
+     * @return true if the atom is in the set
+     */
+    static inline bool contains(const QBitArray &set, int atom)
+    {
+        return atom >= 0 && atom < set.size() && set.testBit(atom);
+    }
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tracerecorder_p.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QThread>
+#include <qnumeric.h>
+
+namespace Sprinter
+{
+
+static void appendJsonString(QByteArray &out, const QString &string)
+{
+    out += '"';
+    const QByteArray utf8 = string.toUtf8();
+    for (int i = 0; i < utf8.size(); ++i) {
+        const char c = utf8[i];
+        switch (c) {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default:
+                if (uchar(c) < 0x20) {
+                    out += "\\u00";
+                    out += QByteArray::number(uchar(c), 16).rightJustified(2, '0');
+                } else {
+                    out += c;
+                }
+                break;
+        }
+    }
+    out += '"';
+}
+
+static void appendJsonValue(QByteArray &out, const QVariant &value)
+{
+    switch (value.type()) {
+        case QVariant::Bool:
+            out += value.toBool() ? "true" : "false";
+            break;
+        case QVariant::Int:
+        case QVariant::UInt:
+        case QVariant::LongLong:
+        case QVariant::ULongLong:
+            out += value.toString().toLatin1();
+            break;
+        case QVariant::Double:
+            // JSON has no NaN or infinity, and viewers reject the whole file over one
+            if (qIsFinite(value.toDouble())) {
+                out += value.toString().toLatin1();
+            } else {
+                out += "null";
+            }
+            break;
+        default:
+            appendJsonString(out, value.toString());
+            break;
+    }
+}
+
+TraceRecorder::TraceRecorder()
+    : m_pid(QCoreApplication::applicationPid()),
+      m_firstEvent(true)
+{
+    m_clock.start();
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    stop();
+}
+
+bool TraceRecorder::start(const QString &path)
+{
+    stop();
+
+    QMutexLocker lock(&m_lock);
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Could not open trace file" << path << ":" << m_file.errorString();
+        return false;
+    }
+
+    m_file.write("[\n");
+    m_threads.clear();
+    m_firstEvent = true;
+    m_recording.store(1);
+    return true;
+}
+
+void TraceRecorder::stop()
+{
+    QMutexLocker lock(&m_lock);
+    if (!m_recording.load()) {
+        return;
+    }
+
+    m_recording.store(0);
+    m_file.write("\n]\n");
+    m_file.close();
+}
+
+void TraceRecorder::flush()
+{
+    QMutexLocker lock(&m_lock);
+    if (m_recording.load()) {
+        m_file.flush();
+    }
+}
+
+QString TraceRecorder::path() const
+{
+    QMutexLocker lock(&m_lock);
+    return m_recording.load() ? m_file.fileName() : QString();
+}
+
+qint64 TraceRecorder::now() const
+{
+    return m_clock.nsecsElapsed() / 1000;
+}
+
+void TraceRecorder::instant(const char *name, const char *category, const QVariantMap &args)
+{
+    write("i", name, category, now(), -1, args);
+}
+
+void TraceRecorder::complete(const char *name, const char *category, qint64 start, const QVariantMap &args)
+{
+    write("X", name, category, start, now() - start, args);
+}
+
+int TraceRecorder::threadId()
+{
+    // must be called with m_lock held; threads are numbered in order of
+    // appearance and named in the trace the first time they are seen
+    const Qt::HANDLE handle = QThread::currentThreadId();
+    QHash<Qt::HANDLE, int>::const_iterator it = m_threads.constFind(handle);
+    if (it != m_threads.constEnd()) {
+        return it.value();
+    }
+
+    const int id = m_threads.size() + 1;
+    m_threads.insert(handle, id);
+
+    QThread *thread = QThread::currentThread();
+    QString threadName = thread->objectName();
+    if (thread == QCoreApplication::instance()->thread()) {
+        threadName = QStringLiteral("Main");
+    } else if (threadName.isEmpty()) {
+        threadName = QString(QStringLiteral("Thread %1")).arg(id);
+    }
+
+    QByteArray event = m_firstEvent ? "" : ",\n";
+    m_firstEvent = false;
+    event += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":";
+    event += QByteArray::number(m_pid);
+    event += ",\"tid\":";
+    event += QByteArray::number(id);
+    event += ",\"args\":{\"name\":";
+    appendJsonString(event, threadName);
+    event += "}}";
+    m_file.write(event);
+
+    return id;
+}
+
+void TraceRecorder::write(const char *phase, const char *name, const char *category,
+                          qint64 start, qint64 duration, const QVariantMap &args)
+{
+    QMutexLocker lock(&m_lock);
+    if (!m_recording.load()) {
+        return;
+    }
+
+    const int tid = threadId();
+
+    QByteArray event = m_firstEvent ? "" : ",\n";
+    m_firstEvent = false;
+    event += "{\"name\":\"";
+    event += name;
+    event += "\",\"cat\":\"";
+    event += category;
+    event += "\",\"ph\":\"";
+    event += phase;
+    event += "\",\"ts\":";
+    event += QByteArray::number(start);
+    if (duration >= 0) {
+        event += ",\"dur\":";
+        event += QByteArray::number(duration);
+    } else {
+        // instants are scoped to their thread
+        event += ",\"s\":\"t\"";
+    }
+    event += ",\"pid\":";
+    event += QByteArray::number(m_pid);
+    event += ",\"tid\":";
+    event += QByteArray::number(tid);
+
+    if (!args.isEmpty()) {
+        event += ",\"args\":{";
+        for (QVariantMap::const_iterator it = args.constBegin(); it != args.constEnd(); ++it) {
+            if (it != args.constBegin()) {
+                event += ',';
+            }
+            appendJsonString(event, it.key());
+            event += ':';
+            appendJsonValue(event, it.value());
+        }
+        event += '}';
+    }
+
+    event += '}';
+    m_file.write(event);
+}
+
+} // namespace
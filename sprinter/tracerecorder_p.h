@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPRINTER_TRACERECORDER_P_H
+#define SPRINTER_TRACERECORDER_P_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVariantMap>
+
+namespace Sprinter
+{
+
+/**
+ * @class TraceRecorder
+ * Records a timeline of what a query session does, for finding out where
+ * the time went when things feel slow, and writes it to a file as Chrome
+ * trace events (load it in chrome://tracing or ui.perfetto.dev).
+ *
+ * Events are either instants or complete events with a start and a
+ * duration, tagged with the thread they were recorded in. Timestamps are
+ * microseconds since the recorder was created.
+ *
+ * Recording is off until start() is called, and callers are expected to
+ * check isRecording() before building any arguments so that it costs no
+ * more than an atomic load when off. All methods are thread safe.
+ */
+class TraceRecorder
+{
+public:
+    TraceRecorder();
+    ~TraceRecorder();
+
+    /**
+     * Starts writing events to the file at path, replacing its contents.
+     * A recording already in progress is finished first.
+     * @return true on success
+     */
+    bool start(const QString &path);
+
+    /**
+     * Finishes the recording, if any, and closes the file
+     */
+    void stop();
+
+    /**
+     * Writes out the events recorded so far without ending the recording
+     */
+    void flush();
+
+    bool isRecording() const { return m_recording.load() != 0; }
+    QString path() const;
+
+    /**
+     * @return the current time, for use as the start of a complete event
+     */
+    qint64 now() const;
+
+    void instant(const char *name, const char *category, const QVariantMap &args = QVariantMap());
+    void complete(const char *name, const char *category, qint64 start, const QVariantMap &args = QVariantMap());
+
+private:
+    void write(const char *phase, const char *name, const char *category,
+               qint64 start, qint64 duration, const QVariantMap &args);
+    int threadId();
+
+    mutable QMutex m_lock;
+    QAtomicInt m_recording;
+    QElapsedTimer m_clock;
+    QFile m_file;
+    QHash<Qt::HANDLE, int> m_threads;
+    qint64 m_pid;
+    bool m_firstEvent;
+};
+
+} // namespace
+
+#endif
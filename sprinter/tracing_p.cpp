@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tracing_p.h"
+
+#if defined(SPRINTER_HAVE_SDT) && !defined(SPRINTER_NO_TRACING)
+
+// the semaphores go where tracers look for them, as dtrace -G would put them
+#define SPRINTER_DEFINE_TRACE_SEMAPHORE(probe) \
+    unsigned short sprinter_##probe##_semaphore __attribute__((section(".probes"))) = 0
+
+SPRINTER_DEFINE_TRACE_SEMAPHORE(query_start);
+SPRINTER_DEFINE_TRACE_SEMAPHORE(runner_dispatch);
+SPRINTER_DEFINE_TRACE_SEMAPHORE(match_start);
+SPRINTER_DEFINE_TRACE_SEMAPHORE(match_end);
+SPRINTER_DEFINE_TRACE_SEMAPHORE(set_matches);
+SPRINTER_DEFINE_TRACE_SEMAPHORE(sync_begin);
+SPRINTER_DEFINE_TRACE_SEMAPHORE(sync_end);
+SPRINTER_DEFINE_TRACE_SEMAPHORE(exec_start);
+SPRINTER_DEFINE_TRACE_SEMAPHORE(exec_end);
+
+#endif
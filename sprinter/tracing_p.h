@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) version 3, or any
+ * later version accepted by the membership of KDE e.V. (or its
+ * successor approved by the membership of KDE e.V.), which shall
+ * act as a proxy defined in Section 6 of version 3 of the license.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPRINTER_TRACING_P_H
+#define SPRINTER_TRACING_P_H
+
+/*
+ * Static trace points on the query lifecycle.
+ *
+ * When built with SystemTap's <sys/sdt.h> available (see SPRINTER_TRACING in
+ * CMakeLists.txt), each SPRINTER_TRACE* macro compiles down to a single nop and
+ * a note in the ELF file describing the probe and where its arguments live.
+ * Nothing else is executed unless a tracer attaches, e.g.:
+ *
+ *   bpftrace -e 'usdt:/usr/lib/libsprinter.so:sprinter:match_end
+ *                { @[str(arg0, arg1 * 2)] = count(); }'
+ *
+ * Without <sys/sdt.h>, or with SPRINTER_NO_TRACING defined, the macros expand
+ * to nothing at all.
+ *
+ * Arguments must be integers or pointers. Strings are passed as a pointer to
+ * their UTF-16 data followed by their length in characters. The arguments are
+ * evaluated whenever the probe is reached, so anything beyond reading a member
+ * goes behind SPRINTER_TRACE_ENABLED(probe), which reads the probe's semaphore:
+ * a counter the tracer raises while attached, and false without <sys/sdt.h>.
+ * Each probe has its semaphore defined in tracing_p.cpp.
+ *
+ * Probes, all in the "sprinter" provider:
+ *   query_start(query, queryLength, fetchMore, defaultMatches, clearMatchers)
+ *   runner_dispatch(runnerId, runnerIdLength, runnerIndex)
+ *   match_start(runnerId, runnerIdLength, sessionData)
+ *   match_end(runnerId, runnerIdLength, sessionData)
+ *   set_matches(runnerId, runnerIdLength, sessionData, matchCount)
+ *   sync_begin()
+ *   sync_end(matchCount)
+ *   exec_start(runnerId, runnerIdLength, matchId)
+ *   exec_end(runnerId, runnerIdLength, matchId, success)
+ */
+
+#if defined(SPRINTER_HAVE_SDT) && !defined(SPRINTER_NO_TRACING)
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define SPRINTER_TRACE_SEMAPHORE(probe) \
+    extern "C" unsigned short sprinter_##probe##_semaphore
+
+SPRINTER_TRACE_SEMAPHORE(query_start);
+SPRINTER_TRACE_SEMAPHORE(runner_dispatch);
+SPRINTER_TRACE_SEMAPHORE(match_start);
+SPRINTER_TRACE_SEMAPHORE(match_end);
+SPRINTER_TRACE_SEMAPHORE(set_matches);
+SPRINTER_TRACE_SEMAPHORE(sync_begin);
+SPRINTER_TRACE_SEMAPHORE(sync_end);
+SPRINTER_TRACE_SEMAPHORE(exec_start);
+SPRINTER_TRACE_SEMAPHORE(exec_end);
+
+#define SPRINTER_TRACE_ENABLED(probe) \
+    __builtin_expect(sprinter_##probe##_semaphore != 0, 0)
+#define SPRINTER_TRACE(probe) \
+    DTRACE_PROBE(sprinter, probe)
+#define SPRINTER_TRACE1(probe, a1) \
+    DTRACE_PROBE1(sprinter, probe, a1)
+#define SPRINTER_TRACE2(probe, a1, a2) \
+    DTRACE_PROBE2(sprinter, probe, a1, a2)
+#define SPRINTER_TRACE3(probe, a1, a2, a3) \
+    DTRACE_PROBE3(sprinter, probe, a1, a2, a3)
+#define SPRINTER_TRACE4(probe, a1, a2, a3, a4) \
+    DTRACE_PROBE4(sprinter, probe, a1, a2, a3, a4)
+#define SPRINTER_TRACE5(probe, a1, a2, a3, a4, a5) \
+    DTRACE_PROBE5(sprinter, probe, a1, a2, a3, a4, a5)
+
+#else
+
+#define SPRINTER_TRACE_ENABLED(probe) false
+#define SPRINTER_TRACE(probe)
+#define SPRINTER_TRACE1(probe, a1)
+#define SPRINTER_TRACE2(probe, a1, a2)
+#define SPRINTER_TRACE3(probe, a1, a2, a3)
+#define SPRINTER_TRACE4(probe, a1, a2, a3, a4)
+#define SPRINTER_TRACE5(probe, a1, a2, a3, a4, a5)
+
+#endif
+
+#endif
@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmarks for the query pipeline, driven without any UI.
+ *
+ * Only the statically linked synthetic runner is enabled, so the numbers
+ * measure Sprinter itself rather than any data source. Run it with
+ * QT_QPA_PLATFORM=offscreen on machines without a display; QtTest's usual
+ * options apply, e.g. -csv or -xml for machine readable results and
+ * -iterations to trade run time for stability.
+ */
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QSignalSpy>
+#include <QThread>
+#include <QtPlugin>
+#include <QtTest>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include "sprinter/querysession.h"
+
+#include "syntheticrunner.h"
+
+Q_IMPORT_PLUGIN(SyntheticRunner)
+
+using namespace Sprinter;
+
+static const char *s_runnerId = "org.kde.sprinter.bench.synthetic";
+static const int s_queryTimeout = 10000;
+
+class ContextValidator : public QThread
+{
+public:
+    ContextValidator(const QueryContext &context,
+                     const RunnerSessionData *sessionData,
+                     int iterations, QAtomicInt *start)
+        : m_context(context),
+          m_sessionData(sessionData),
+          m_iterations(iterations),
+          m_start(start),
+          m_valid(0)
+    {
+    }
+
+    void run()
+    {
+        while (!m_start->load()) {
+            yieldCurrentThread();
+        }
+
+        for (int i = 0; i < m_iterations; ++i) {
+            if (m_context.isValid(m_sessionData)) {
+                ++m_valid;
+            }
+        }
+    }
+
+    int valid() const
+    {
+        return m_valid;
+    }
+
+private:
+    const QueryContext m_context;
+    const RunnerSessionData *m_sessionData;
+    const int m_iterations;
+    QAtomicInt *m_start;
+    int m_valid;
+};
+
+class SprinterBench : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+
+    void queriesPerSecond_data();
+    void queriesPerSecond();
+    void keystrokeToFirstRow_data();
+    void keystrokeToFirstRow();
+    void syncThousandMatches();
+    void modelDataThroughput();
+    void memoryPerMatch();
+    void contextValidScaling_data();
+    void contextValidScaling();
+
+private:
+    void addModeRows();
+    bool runQuery(int expectedRows = -1);
+    QString nextQuery();
+
+    QuerySession *m_session;
+    int m_queryCount;
+};
+
+void SprinterBench::initTestCase()
+{
+    m_queryCount = 0;
+    m_session = new QuerySession(this);
+    m_session->setSyncInterval(0);
+    m_session->setFirstMatchDelay(0);
+
+    QAbstractItemModel *runners = m_session->runnerModel();
+    QTRY_VERIFY(runners->property("runnerIds").toStringList().contains(QLatin1String(s_runnerId)));
+
+    const int row = runners->property("runnerIds").toStringList().indexOf(QLatin1String(s_runnerId));
+    runners->setProperty("enabledRunners", QStringList() << QLatin1String(s_runnerId));
+    QMetaObject::invokeMethod(runners, "loadRunner", Q_ARG(int, row));
+
+    const int loadedRole = runners->roleNames().key("IsLoadedRole");
+    QTRY_VERIFY(runners->data(runners->index(row, 0), loadedRole).toBool());
+}
+
+void SprinterBench::cleanupTestCase()
+{
+    delete m_session;
+    m_session = 0;
+}
+
+void SprinterBench::init()
+{
+    SyntheticRunner::setConfig(SyntheticRunner::Config());
+}
+
+QString SprinterBench::nextQuery()
+{
+    // every query is different so none of them are skipped as repeats
+    return QString(QStringLiteral("query%1")).arg(++m_queryCount);
+}
+
+bool SprinterBench::runQuery(int expectedRows)
+{
+    QSignalSpy completed(m_session, SIGNAL(queryCompleted(int,int,int)));
+    m_session->setQuery(nextQuery());
+    if (!completed.wait(s_queryTimeout)) {
+        return false;
+    }
+
+    return expectedRows < 0 || m_session->rowCount() == expectedRows;
+}
+
+void SprinterBench::addModeRows()
+{
+    QTest::addColumn<int>("mode");
+    QTest::addColumn<int>("latency");
+
+    QTest::newRow("fixed 0ms") << int(SyntheticRunner::FixedLatency) << 0;
+    QTest::newRow("fixed 5ms") << int(SyntheticRunner::FixedLatency) << 5;
+    QTest::newRow("cpu 5ms") << int(SyntheticRunner::CpuBound) << 5;
+    QTest::newRow("async 5ms") << int(SyntheticRunner::Async) << 5;
+    QTest::newRow("flaky 5ms") << int(SyntheticRunner::Flaky) << 5;
+}
+
+void SprinterBench::queriesPerSecond_data()
+{
+    addModeRows();
+}
+
+void SprinterBench::queriesPerSecond()
+{
+    QFETCH(int, mode);
+    QFETCH(int, latency);
+
+    SyntheticRunner::Config config;
+    config.mode = SyntheticRunner::Mode(mode);
+    config.latency = latency;
+    SyntheticRunner::setConfig(config);
+
+    QBENCHMARK {
+        QVERIFY(runQuery());
+    }
+}
+
+void SprinterBench::keystrokeToFirstRow_data()
+{
+    addModeRows();
+}
+
+void SprinterBench::keystrokeToFirstRow()
+{
+    QFETCH(int, mode);
+    QFETCH(int, latency);
+
+    if (mode == SyntheticRunner::Flaky) {
+        QSKIP("Flaky queries do not always produce a first row");
+    }
+
+    SyntheticRunner::Config config;
+    config.mode = SyntheticRunner::Mode(mode);
+    config.latency = latency;
+    SyntheticRunner::setConfig(config);
+
+    const int rounds = 50;
+    qint64 total = 0;
+    for (int i = 0; i < rounds; ++i) {
+        QSignalSpy shown(m_session, SIGNAL(firstMatchesShown(int)));
+        QSignalSpy completed(m_session, SIGNAL(queryCompleted(int,int,int)));
+        QElapsedTimer timer;
+        timer.start();
+        m_session->setQuery(nextQuery());
+        QVERIFY(shown.count() > 0 || shown.wait(s_queryTimeout));
+        total += timer.nsecsElapsed();
+        QVERIFY(completed.count() > 0 || completed.wait(s_queryTimeout));
+    }
+
+    QTest::setBenchmarkResult(total / rounds / 1000000.0, QTest::WalltimeMilliseconds);
+}
+
+void SprinterBench::syncThousandMatches()
+{
+    SyntheticRunner::Config config;
+    config.matchCount = 1000;
+    SyntheticRunner::setConfig(config);
+
+    QBENCHMARK {
+        QVERIFY(runQuery(1000));
+    }
+}
+
+void SprinterBench::modelDataThroughput()
+{
+    SyntheticRunner::Config config;
+    config.matchCount = 1000;
+    SyntheticRunner::setConfig(config);
+    QVERIFY(runQuery(1000));
+
+    const int rows = m_session->rowCount();
+    const int columns = m_session->columnCount();
+    QBENCHMARK {
+        for (int row = 0; row < rows; ++row) {
+            for (int column = 0; column < columns; ++column) {
+                m_session->data(m_session->index(row, column), Qt::DisplayRole);
+            }
+
+            const QModelIndex index = m_session->index(row, 0);
+            m_session->data(index, QuerySession::TextRole);
+            m_session->data(index, QuerySession::IdRole);
+        }
+    }
+}
+
+void SprinterBench::memoryPerMatch()
+{
+#if defined(__GLIBC__)
+    const int matchCount = 5000;
+    SyntheticRunner::Config config;
+    config.matchCount = 0;
+    SyntheticRunner::setConfig(config);
+    QVERIFY(runQuery(0));
+
+    const int before = mallinfo().uordblks;
+
+    config.matchCount = matchCount;
+    SyntheticRunner::setConfig(config);
+    QVERIFY(runQuery(matchCount));
+
+    const int after = mallinfo().uordblks;
+    QTest::setBenchmarkResult(qreal(after - before) / matchCount, QTest::BytesAllocated);
+#else
+    QSKIP("Heap usage is only measured with glibc");
+#endif
+}
+
+void SprinterBench::contextValidScaling_data()
+{
+    QTest::addColumn<int>("threads");
+
+    QTest::newRow("1 thread") << 1;
+    QTest::newRow("2 threads") << 2;
+    QTest::newRow("4 threads") << 4;
+    QTest::newRow("8 threads") << 8;
+    QTest::newRow("16 threads") << 16;
+    QTest::newRow("32 threads") << 32;
+}
+
+void SprinterBench::contextValidScaling()
+{
+    QFETCH(int, threads);
+
+    // keep the query running so the context stays valid while measuring
+    SyntheticRunner::Config config;
+    config.mode = SyntheticRunner::Async;
+    config.latency = 60000;
+    SyntheticRunner::setConfig(config);
+
+    m_session->setQuery(nextQuery());
+    QTRY_VERIFY(SyntheticRunner::lastSessionData() &&
+                SyntheticRunner::lastContext().query() == m_session->query());
+
+    const QueryContext context = SyntheticRunner::lastContext();
+    const RunnerSessionData *sessionData = SyntheticRunner::lastSessionData();
+    const int iterations = 1000000 / threads;
+
+    QBENCHMARK {
+        QAtomicInt start(0);
+        QList<ContextValidator *> validators;
+        for (int i = 0; i < threads; ++i) {
+            validators << new ContextValidator(context, sessionData, iterations, &start);
+            validators.last()->start();
+        }
+
+        start.store(1);
+        bool allValid = true;
+        foreach (ContextValidator *validator, validators) {
+            validator->wait();
+            allValid = allValid && validator->valid() == iterations;
+        }
+
+        qDeleteAll(validators);
+        QVERIFY(allValid);
+    }
+
+    m_session->halt();
+}
+
+QTEST_MAIN(SprinterBench)
+
+#include "sprinterbench.moc"
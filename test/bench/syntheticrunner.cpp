@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "syntheticrunner.h"
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QThread>
+#include <QTimer>
+
+#include "sprinter/matchdata.h"
+#include "sprinter/querymatch.h"
+#include "sprinter/querysession.h"
+
+using namespace Sprinter;
+
+QMutex SyntheticRunner::s_lock;
+SyntheticRunner::Config SyntheticRunner::s_config;
+QueryContext SyntheticRunner::s_lastContext;
+RunnerSessionData *SyntheticRunner::s_lastSessionData = 0;
+
+// QThread::msleep is protected in Qt 5.0
+class Sleeper : public QThread
+{
+public:
+    static void sleep(int msecs) { QThread::msleep(msecs); }
+};
+
+SyntheticRunner::SyntheticRunner(QObject *parent)
+    : Runner(parent)
+{
+    setMinQueryLength(1);
+}
+
+void SyntheticRunner::setConfig(const Config &config)
+{
+    QMutexLocker lock(&s_lock);
+    s_config = config;
+}
+
+SyntheticRunner::Config SyntheticRunner::config()
+{
+    QMutexLocker lock(&s_lock);
+    return s_config;
+}
+
+QueryContext SyntheticRunner::lastContext()
+{
+    QMutexLocker lock(&s_lock);
+    return s_lastContext;
+}
+
+RunnerSessionData *SyntheticRunner::lastSessionData()
+{
+    QMutexLocker lock(&s_lock);
+    return s_lastSessionData;
+}
+
+RunnerSessionData *SyntheticRunner::createSessionData()
+{
+    return new SyntheticSessionData(this);
+}
+
+QVector<QueryMatch> SyntheticRunner::generateMatches(const QueryContext &context, int count)
+{
+    QVector<QueryMatch> matches;
+    matches.reserve(count);
+    const QString query = context.query();
+    for (int i = 0; i < count; ++i) {
+        QueryMatch match;
+        match.setTitle(QString(QStringLiteral("%1 %2")).arg(query).arg(i));
+        match.setText(QStringLiteral("Synthetic match"));
+        match.setType(QuerySession::UnknownType);
+        match.setSource(QuerySession::FromLocalService);
+        match.setPrecision(QuerySession::CloseMatch);
+        match.setKey(QString::number(i));
+        match.setData(i);
+        matches << match;
+    }
+
+    return matches;
+}
+
+void SyntheticRunner::match(MatchData &matchData)
+{
+    const Config c = config();
+    {
+        QMutexLocker lock(&s_lock);
+        s_lastContext = matchData.queryContext();
+        s_lastSessionData = matchData.sessionData();
+    }
+
+    switch (c.mode) {
+        case FixedLatency:
+            Sleeper::sleep(c.latency);
+            break;
+        case CpuBound: {
+            QElapsedTimer timer;
+            timer.start();
+            volatile quint64 spin = 0;
+            while (timer.elapsed() < c.latency) {
+                ++spin;
+            }
+            break;
+        }
+        case Async:
+            matchData.setAsynchronous(true);
+            QMetaObject::invokeMethod(matchData.sessionData(), "deliverLater",
+                                      Q_ARG(Sprinter::QueryContext, matchData.queryContext()),
+                                      Q_ARG(int, c.latency), Q_ARG(int, c.matchCount));
+            return;
+        case Flaky:
+            if (qrand() % 100 < c.failureRate) {
+                Sleeper::sleep(c.latency * 10);
+                return;
+            }
+            Sleeper::sleep(c.latency);
+            break;
+    }
+
+    matchData << generateMatches(matchData.queryContext(), c.matchCount);
+}
+
+SyntheticSessionData::SyntheticSessionData(Runner *runner)
+    : RunnerSessionData(runner),
+      m_count(0)
+{
+}
+
+void SyntheticSessionData::deliverLater(const QueryContext &context, int delay, int count)
+{
+    // a newer query simply replaces the one waiting
+    m_context = context;
+    m_count = count;
+    QTimer::singleShot(delay, this, SLOT(deliver()));
+}
+
+void SyntheticSessionData::deliver()
+{
+    if (m_context.isValid(this)) {
+        setMatches(SyntheticRunner::generateMatches(m_context, m_count), m_context);
+    }
+}
+
+#include "moc_syntheticrunner.cpp"
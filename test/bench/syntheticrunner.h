@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SYNTHETICRUNNER_H
+#define SYNTHETICRUNNER_H
+
+#include <QMutex>
+
+#include "sprinter/querycontext.h"
+#include "sprinter/runner.h"
+#include "sprinter/runnersessiondata.h"
+
+/**
+ * A runner whose behaviour is set by the benchmark rather than by any real
+ * data source. It is linked into the benchmark as a static plugin, so it is
+ * found and loaded through the same path as installed runner plugins.
+ *
+ * Every query produces matchCount matches with titles derived from the
+ * query, after the configured delay:
+ *  - FixedLatency: sleeps for latency milliseconds in Runner::match
+ *  - CpuBound: spins for latency milliseconds in Runner::match
+ *  - Async: returns at once and delivers the matches latency milliseconds
+ *    later from the session data's thread
+ *  - Flaky: like FixedLatency, but failureRate percent of the queries take
+ *    ten times as long and produce nothing
+ */
+class SyntheticRunner : public Sprinter::Runner
+{
+    Q_OBJECT
+    Q_PLUGIN_METADATA(IID "org.kde.sprinter.bench.synthetic" FILE "syntheticrunner.json")
+    Q_INTERFACES(Sprinter::Runner)
+
+public:
+    enum Mode {
+        FixedLatency,
+        CpuBound,
+        Async,
+        Flaky
+    };
+
+    struct Config
+    {
+        Config()
+            : mode(FixedLatency),
+              latency(0),
+              matchCount(10),
+              failureRate(10)
+        {
+        }
+
+        Mode mode;
+        int latency;
+        int matchCount;
+        int failureRate;
+    };
+
+    SyntheticRunner(QObject *parent = 0);
+
+    /**
+     * Sets how all synthetic runners behave from their next match on
+     */
+    static void setConfig(const Config &config);
+    static Config config();
+
+    /**
+     * @return the context and session data of the most recent match, for
+     * benchmarking QueryContext itself
+     */
+    static Sprinter::QueryContext lastContext();
+    static Sprinter::RunnerSessionData *lastSessionData();
+
+    Sprinter::RunnerSessionData *createSessionData();
+    void match(Sprinter::MatchData &matchData);
+
+    static QVector<Sprinter::QueryMatch> generateMatches(const Sprinter::QueryContext &context, int count);
+
+private:
+    static QMutex s_lock;
+    static Config s_config;
+    static Sprinter::QueryContext s_lastContext;
+    static Sprinter::RunnerSessionData *s_lastSessionData;
+};
+
+class SyntheticSessionData : public Sprinter::RunnerSessionData
+{
+    Q_OBJECT
+
+public:
+    SyntheticSessionData(Sprinter::Runner *runner);
+
+public Q_SLOTS:
+    void deliverLater(const Sprinter::QueryContext &context, int delay, int count);
+
+private Q_SLOTS:
+    void deliver();
+
+private:
+    Sprinter::QueryContext m_context;
+    int m_count;
+};
+
+#endif
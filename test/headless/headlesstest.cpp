@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Tests for HeadlessSession and BatchQuery, which both end a query on the
+ * page marked as complete. Two synthetic runners are linked in, and each
+ * session may only run one runnable at a time, so the second runner is
+ * always still waiting on the quota while the first one finishes.
+ *
+ * Run it with QT_QPA_PLATFORM=offscreen on machines without a display.
+ */
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QtPlugin>
+#include <QtTest>
+
+#include "sprinter/batchquery.h"
+#include "sprinter/headlesssession.h"
+
+#include "secondsyntheticrunner.h"
+#include "syntheticrunner.h"
+
+Q_IMPORT_PLUGIN(SyntheticRunner)
+Q_IMPORT_PLUGIN(SecondSyntheticRunner)
+
+using namespace Sprinter;
+
+static const int s_timeout = 10000;
+static const int s_latency = 100;
+static const int s_matchCount = 5;
+
+class HeadlessTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+
+    void completePageIsLast();
+    void sameQueryWhileBusy();
+    void batchCompletesEveryQuery();
+
+private:
+    static QStringList runnerIds();
+};
+
+void HeadlessTest::initTestCase()
+{
+    // read once, when the first session is created
+    qputenv("SPRINTER_SESSION_QUOTA", "1");
+}
+
+void HeadlessTest::init()
+{
+    SyntheticRunner::Config config;
+    config.latency = s_latency;
+    config.matchCount = s_matchCount;
+    SyntheticRunner::setConfig(config);
+}
+
+QStringList HeadlessTest::runnerIds()
+{
+    return QStringList() << QStringLiteral("org.kde.sprinter.bench.synthetic")
+                         << QStringLiteral("org.kde.sprinter.test.synthetic2");
+}
+
+void HeadlessTest::completePageIsLast()
+{
+    QMutex lock;
+    QVector<HeadlessSession::Page> pages;
+
+    HeadlessSession session(runnerIds());
+    QVERIFY(session.waitForRunners(s_timeout));
+    session.setCallback([&lock, &pages](const HeadlessSession::Page &page) {
+        QMutexLocker locker(&lock);
+        pages << page;
+    });
+
+    session.setQuery(QStringLiteral("complete"));
+    HeadlessSession::Page page;
+    while (session.nextPage(page, s_timeout) && !page.complete) {
+    }
+    QVERIFY(page.complete);
+    QCOMPARE(page.matches.size(), 2 * s_matchCount);
+
+    // long enough for any runner still going to have delivered
+    QTest::qWait(4 * s_latency);
+
+    QMutexLocker locker(&lock);
+    QVERIFY(!pages.isEmpty());
+    for (int i = 0; i < pages.size() - 1; ++i) {
+        QVERIFY(!pages[i].complete);
+    }
+    QVERIFY(pages.last().complete);
+    QCOMPARE(pages.last().matches.size(), 2 * s_matchCount);
+}
+
+void HeadlessTest::sameQueryWhileBusy()
+{
+    HeadlessSession session(runnerIds());
+    QVERIFY(session.waitForRunners(s_timeout));
+
+    session.setQuery(QStringLiteral("again"));
+    HeadlessSession::Page page;
+    QVERIFY(session.nextPage(page, s_timeout));
+    QVERIFY(!page.complete);
+
+    // the second runner is still waiting its turn
+    session.setQuery(QStringLiteral("again"));
+    while (session.nextPage(page, s_timeout) && !page.complete) {
+    }
+    QVERIFY(page.complete);
+    QCOMPARE(page.matches.size(), 2 * s_matchCount);
+
+    // and once they are done, asking again completes straight away
+    session.setQuery(QStringLiteral("again"));
+    QVERIFY(session.nextPage(page, s_timeout));
+    QVERIFY(page.complete);
+    QCOMPARE(page.matches.size(), 2 * s_matchCount);
+}
+
+void HeadlessTest::batchCompletesEveryQuery()
+{
+    // fewer queries in flight than there are runners
+    BatchQuery batch(runnerIds(), 1);
+    QVERIFY(batch.waitForRunners(s_timeout));
+    batch.setTimeout(s_timeout);
+
+    QStringList queries;
+    for (int i = 0; i < 4; ++i) {
+        queries << QString(QStringLiteral("batch%1")).arg(i);
+    }
+
+    QVector<BatchQuery::Result> results;
+    batch.run(queries, [&results](const BatchQuery::Result &result) {
+        results << result;
+    });
+
+    QCOMPARE(results.size(), queries.size());
+    for (auto const &result: results) {
+        QVERIFY(result.complete);
+        QCOMPARE(result.matches.size(), 2 * s_matchCount);
+    }
+}
+
+QTEST_MAIN(HeadlessTest)
+
+#include "headlesstest.moc"
+#include "moc_secondsyntheticrunner.cpp"
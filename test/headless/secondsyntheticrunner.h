@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SECONDSYNTHETICRUNNER_H
+#define SECONDSYNTHETICRUNNER_H
+
+#include "syntheticrunner.h"
+
+/**
+ * Another synthetic runner, sharing the configuration of the first, so
+ * that the sessions under test have more than one runner to wait for.
+ */
+class SecondSyntheticRunner : public SyntheticRunner
+{
+    Q_OBJECT
+    Q_PLUGIN_METADATA(IID "org.kde.sprinter.test.synthetic2" FILE "secondsyntheticrunner.json")
+    Q_INTERFACES(Sprinter::Runner)
+
+public:
+    SecondSyntheticRunner(QObject *parent = 0)
+        : SyntheticRunner(parent)
+    {
+    }
+};
+
+#endif
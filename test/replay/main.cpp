@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * sprinter-replay: replays a query log recorded by QuerySession
+ *
+ * Usage: sprinter-replay [--plugin-path DIR] [--runner ID]... [--speed FACTOR]
+ *                        [--execute] LOGFILE
+ *
+ * Logs are recorded with QuerySession::setRecordFile or by setting the
+ * SPRINTER_RECORD_FILE environment variable, which gives each session a
+ * log of its own: PATH.<pid>-<session>. Events are replayed at their
+ * recorded times divided by the speed factor. Executing matches is skipped
+ * unless --execute is given, as it launches whatever the matches point to.
+ * Set QT_QPA_PLATFORM=offscreen to run without a display.
+ */
+
+#include <QGuiApplication>
+#include <QStringList>
+#include <QTextStream>
+
+#include "replayer.h"
+
+static int usage()
+{
+    QTextStream(stderr) << "Usage: sprinter-replay [--plugin-path DIR] [--runner ID]... "
+                           "[--speed FACTOR] [--execute] LOGFILE\n";
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    QGuiApplication app(argc, argv);
+
+    Replayer::Options options;
+    const QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        const QString arg = args.at(i);
+        if (arg == QLatin1String("--execute")) {
+            options.execute = true;
+            continue;
+        } else if (!arg.startsWith(QLatin1String("--"))) {
+            if (!options.logPath.isEmpty()) {
+                return usage();
+            }
+            options.logPath = arg;
+            continue;
+        } else if (arg == QLatin1String("--help") || i + 1 >= args.size()) {
+            return usage();
+        }
+
+        const QString value = args.at(++i);
+        if (arg == QLatin1String("--plugin-path")) {
+            QCoreApplication::addLibraryPath(value);
+        } else if (arg == QLatin1String("--runner")) {
+            options.runnerIds << value;
+        } else if (arg == QLatin1String("--speed")) {
+            bool ok = false;
+            options.speed = value.toDouble(&ok);
+            if (!ok || options.speed <= 0) {
+                return usage();
+            }
+        } else {
+            return usage();
+        }
+    }
+
+    if (options.logPath.isEmpty()) {
+        return usage();
+    }
+
+    Replayer replayer(options);
+    if (!replayer.load()) {
+        return 1;
+    }
+
+    QObject::connect(&replayer, SIGNAL(finished()), &app, SLOT(quit()));
+    replayer.start();
+    app.exec();
+
+    return replayer.result();
+}
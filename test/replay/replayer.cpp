@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "replayer.h"
+
+#include <QAbstractItemModel>
+#include <QDebug>
+#include <QFile>
+#include <QTextStream>
+#include <QUrl>
+
+#include <algorithm>
+
+#include "sprinter/querysession.h"
+
+using namespace Sprinter;
+
+static const int s_loadTimeout = 10000;
+static const int s_drainTimeout = 5000;
+
+Replayer::Replayer(const Options &options, QObject *parent)
+    : QObject(parent),
+      m_options(options),
+      m_session(0),
+      m_next(0),
+      m_currentQuery(-1),
+      m_pendingMore(-1),
+      m_loadFailures(0)
+{
+    m_nextEvent.setSingleShot(true);
+    connect(&m_nextEvent, SIGNAL(timeout()), this, SLOT(replayNext()));
+
+    m_loadCheck.setInterval(50);
+    connect(&m_loadCheck, SIGNAL(timeout()), this, SLOT(checkRunnersLoaded()));
+}
+
+bool Replayer::load()
+{
+    QFile file(m_options.logPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open" << m_options.logPath << ":" << file.errorString();
+        return false;
+    }
+
+    static const QStringList names = QStringList() << QStringLiteral("query")
+                                                   << QStringLiteral("more")
+                                                   << QStringLiteral("default")
+                                                   << QStringLiteral("exec")
+                                                   << QStringLiteral("halt");
+
+    int lineNumber = 0;
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine().trimmed();
+        ++lineNumber;
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+
+        const QList<QByteArray> fields = line.split(' ');
+        Event event;
+        bool ok = false;
+        event.time = fields.at(0).toLongLong(&ok);
+        if (!ok || fields.size() < 2 || !names.contains(QString::fromLatin1(fields.at(1)))) {
+            qWarning() << "Malformed event on line" << lineNumber << ":" << line;
+            return false;
+        }
+
+        event.name = QString::fromLatin1(fields.at(1));
+        if (fields.size() > 2) {
+            event.argument = QUrl::fromPercentEncoding(fields.at(2));
+        }
+        m_events << event;
+    }
+
+    return true;
+}
+
+int Replayer::result() const
+{
+    return m_loadFailures > 0 ? 1 : 0;
+}
+
+void Replayer::start()
+{
+    m_session = new QuerySession(this);
+    connect(m_session->runnerModel(), SIGNAL(runnerIdsChanged()),
+            this, SLOT(prepareRunners()));
+    connect(m_session, SIGNAL(firstMatchesShown(int)),
+            this, SLOT(firstMatchesShown(int)));
+    connect(m_session, SIGNAL(queryCompleted(int,int,int)),
+            this, SLOT(queryCompleted(int,int,int)));
+    connect(m_session, SIGNAL(rowsInserted(QModelIndex,int,int)),
+            this, SLOT(rowsInserted()));
+}
+
+void Replayer::prepareRunners()
+{
+    if (!m_runnerIds.isEmpty()) {
+        return;
+    }
+
+    QAbstractItemModel *runners = m_session->runnerModel();
+    const QStringList available = runners->property("runnerIds").toStringList();
+    if (available.isEmpty()) {
+        return;
+    }
+
+    if (m_options.runnerIds.isEmpty()) {
+        m_runnerIds = available;
+    } else {
+        for (auto const &id: m_options.runnerIds) {
+            if (available.contains(id)) {
+                m_runnerIds << id;
+            } else {
+                qWarning() << "No such runner:" << id;
+                ++m_loadFailures;
+            }
+        }
+    }
+
+    // loading runners takes time that was not part of the recorded
+    // session, so replaying only starts once they are all in
+    runners->setProperty("enabledRunners", m_runnerIds);
+    for (auto const &id: m_runnerIds) {
+        QMetaObject::invokeMethod(runners, "loadRunner", Q_ARG(int, available.indexOf(id)));
+    }
+
+    m_clock.start();
+    m_loadCheck.start();
+}
+
+void Replayer::checkRunnersLoaded()
+{
+    QAbstractItemModel *runners = m_session->runnerModel();
+    const QStringList available = runners->property("runnerIds").toStringList();
+    const int loadedRole = runners->roleNames().key("IsLoadedRole");
+    QStringList notLoaded;
+    for (auto const &id: m_runnerIds) {
+        if (!runners->data(runners->index(available.indexOf(id), 0), loadedRole).toBool()) {
+            notLoaded << id;
+        }
+    }
+
+    if (!notLoaded.isEmpty() && m_clock.elapsed() < s_loadTimeout) {
+        return;
+    }
+
+    for (auto const &id: notLoaded) {
+        qWarning() << "Runner failed to load:" << id;
+        ++m_loadFailures;
+    }
+
+    m_loadCheck.stop();
+    m_clock.start();
+    scheduleNext();
+}
+
+void Replayer::scheduleNext()
+{
+    if (m_next >= m_events.size()) {
+        // give the last query a chance to complete
+        QTimer::singleShot(s_drainTimeout, this, SLOT(finish()));
+        return;
+    }
+
+    const qint64 due = qint64(m_events.at(m_next).time / m_options.speed);
+    m_nextEvent.start(int(qMax(qint64(0), due - m_clock.elapsed())));
+}
+
+void Replayer::replayNext()
+{
+    Event &event = m_events[m_next];
+    event.issuedAt = m_clock.elapsed();
+
+    if (event.name == QLatin1String("query")) {
+        // setting the current query again is a no-op that starts nothing
+        if (event.argument != m_session->query()) {
+            m_currentQuery = m_next;
+        }
+        m_session->setQuery(event.argument);
+    } else if (event.name == QLatin1String("default")) {
+        m_currentQuery = m_next;
+        m_session->requestDefaultMatches();
+    } else if (event.name == QLatin1String("more")) {
+        m_pendingMore = m_next;
+        m_session->requestMoreMatches();
+    } else if (event.name == QLatin1String("exec")) {
+        if (m_options.execute) {
+            m_session->executeMatch(event.argument.toInt());
+        }
+    } else if (event.name == QLatin1String("halt")) {
+        m_currentQuery = -1;
+        m_pendingMore = -1;
+        m_session->halt();
+    }
+
+    ++m_next;
+    scheduleNext();
+}
+
+void Replayer::firstMatchesShown(int msecs)
+{
+    if (m_currentQuery >= 0 && m_events.at(m_currentQuery).firstMatch < 0) {
+        m_events[m_currentQuery].firstMatch = msecs;
+    }
+}
+
+void Replayer::queryCompleted(int firstMatchMsecs, int lastMatchMsecs, int idleMsecs)
+{
+    Q_UNUSED(lastMatchMsecs)
+
+    if (m_currentQuery >= 0) {
+        Event &event = m_events[m_currentQuery];
+        event.completed = idleMsecs;
+        if (event.firstMatch < 0) {
+            event.firstMatch = firstMatchMsecs;
+        }
+        m_currentQuery = -1;
+    }
+
+    if (m_next >= m_events.size()) {
+        finish();
+    }
+}
+
+void Replayer::rowsInserted()
+{
+    if (m_pendingMore >= 0) {
+        Event &event = m_events[m_pendingMore];
+        event.firstMatch = m_clock.elapsed() - event.issuedAt;
+        m_pendingMore = -1;
+    }
+}
+
+void Replayer::finish()
+{
+    if (!m_session) {
+        return;
+    }
+
+    m_nextEvent.stop();
+    m_session->halt();
+    // this may be called from one of the session's signals
+    m_session->deleteLater();
+    m_session = 0;
+
+    report();
+    emit finished();
+}
+
+void Replayer::printLatencies(const char *name, QVector<int> samples)
+{
+    QTextStream out(stdout);
+    out << "  " << name << ": ";
+    if (samples.isEmpty()) {
+        out << "no samples\n";
+        return;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    const int count = samples.size();
+    auto percentile = [&samples, count](int percent) {
+        return samples.at(qMax(0, (count * percent + 99) / 100 - 1));
+    };
+
+    out << "p50 " << percentile(50) << "ms, p95 " << percentile(95)
+        << "ms, p99 " << percentile(99) << "ms, max " << samples.last()
+        << "ms (" << count << " events)\n";
+}
+
+void Replayer::report()
+{
+    QTextStream out(stdout);
+    out << "Log: " << m_options.logPath << " at " << m_options.speed << "x speed\n"
+        << "Runners: " << m_runnerIds.join(QStringLiteral(", ")) << "\n"
+        << "\n   recorded   replayed  event    first    done  argument\n";
+
+    QVector<int> queryFirst;
+    QVector<int> queryDone;
+    QVector<int> moreFirst;
+    int unanswered = 0;
+    for (auto const &event: m_events) {
+        if (event.issuedAt < 0) {
+            // the replay ended before this event
+            break;
+        }
+
+        out << qSetFieldWidth(11) << right << event.time << event.issuedAt
+            << qSetFieldWidth(0) << "  " << qSetFieldWidth(7) << left << event.name
+            << qSetFieldWidth(8) << right
+            << (event.firstMatch < 0 ? QStringLiteral("-") : QString::number(event.firstMatch))
+            << (event.completed < 0 ? QStringLiteral("-") : QString::number(event.completed))
+            << qSetFieldWidth(0) << "  " << event.argument << "\n";
+
+        if (event.name == QLatin1String("more")) {
+            if (event.firstMatch >= 0) {
+                moreFirst << event.firstMatch;
+            }
+        } else if (event.name == QLatin1String("query") ||
+                   event.name == QLatin1String("default")) {
+            if (event.firstMatch >= 0) {
+                queryFirst << event.firstMatch;
+            }
+
+            if (event.completed >= 0) {
+                queryDone << event.completed;
+            } else {
+                ++unanswered;
+            }
+        }
+    }
+
+    out << "\nLatency (ms):\n";
+    out.flush();
+    printLatencies("query to first match", queryFirst);
+    printLatencies("query to runners idle", queryDone);
+    printLatencies("fetch more to new rows", moreFirst);
+    out << "Queries superseded or repeated before completing: " << unanswered << "\n";
+}
+
+#include "moc_replayer.cpp"
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPLAYER_H
+#define REPLAYER_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+
+namespace Sprinter
+{
+    class QuerySession;
+} // namespace
+
+/**
+ * Drives a QuerySession from a log written by QuerySession::setRecordFile,
+ * with the original timing scaled by a speed factor, and reports how long
+ * each event took to show results.
+ */
+class Replayer : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options
+    {
+        Options()
+            : speed(1.0),
+              execute(false)
+        {
+        }
+
+        QString logPath;
+        QStringList runnerIds;
+        double speed;
+        bool execute;
+    };
+
+    Replayer(const Options &options, QObject *parent = 0);
+
+    /**
+     * Reads the log
+     * @return false if it could not be read or is malformed
+     */
+    bool load();
+
+    int result() const;
+
+public Q_SLOTS:
+    void start();
+
+Q_SIGNALS:
+    void finished();
+
+private Q_SLOTS:
+    void prepareRunners();
+    void checkRunnersLoaded();
+    void replayNext();
+    void firstMatchesShown(int msecs);
+    void queryCompleted(int firstMatchMsecs, int lastMatchMsecs, int idleMsecs);
+    void rowsInserted();
+    void finish();
+
+private:
+    struct Event
+    {
+        Event()
+            : time(0),
+              issuedAt(-1),
+              firstMatch(-1),
+              completed(-1)
+        {
+        }
+
+        qint64 time;
+        QString name;
+        QString argument;
+        qint64 issuedAt;
+        int firstMatch;
+        int completed;
+    };
+
+    void scheduleNext();
+    void report();
+    static void printLatencies(const char *name, QVector<int> samples);
+
+    Options m_options;
+    Sprinter::QuerySession *m_session;
+    QVector<Event> m_events;
+    QTimer m_nextEvent;
+    QTimer m_loadCheck;
+    QElapsedTimer m_clock;
+    QStringList m_runnerIds;
+    int m_next;
+    // the query or default matches event results are attributed to, and
+    // the fetchMore waiting for rows, as indexes into m_events; -1 if none
+    int m_currentQuery;
+    int m_pendingMore;
+    int m_loadFailures;
+};
+
+#endif
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * sprinter-torture: a stress test for runner plugins
+ *
+ * Usage: sprinter-torture [--plugin-path DIR] [--runner ID]... [--duration SECS]
+ *                         [--rate ACTIONS_PER_SEC] [--sessions N] [--seed N]
+ *
+ * Runners are looked up in the "sprinter" directory of each library path;
+ * --plugin-path adds to those paths. Without --runner, all runners found
+ * are used. Build with -fsanitize=thread or -fsanitize=address in
+ * CMAKE_CXX_FLAGS to have races and memory errors reported as well.
+ * Set QT_QPA_PLATFORM=offscreen to run without a display.
+ */
+
+#include <QGuiApplication>
+#include <QStringList>
+#include <QTextStream>
+
+#include "torturer.h"
+
+static int usage()
+{
+    QTextStream(stderr) << "Usage: sprinter-torture [--plugin-path DIR] [--runner ID]... "
+                           "[--duration SECS] [--rate ACTIONS_PER_SEC] [--sessions N] [--seed N]\n";
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    QGuiApplication app(argc, argv);
+
+    Torturer::Options options;
+    const QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        const QString arg = args.at(i);
+        if (arg == QLatin1String("--help") || i + 1 >= args.size()) {
+            return usage();
+        }
+
+        const QString value = args.at(++i);
+        bool ok = true;
+        if (arg == QLatin1String("--plugin-path")) {
+            QCoreApplication::addLibraryPath(value);
+        } else if (arg == QLatin1String("--runner")) {
+            options.runnerIds << value;
+        } else if (arg == QLatin1String("--duration")) {
+            options.duration = value.toInt(&ok);
+        } else if (arg == QLatin1String("--rate")) {
+            options.rate = value.toInt(&ok);
+        } else if (arg == QLatin1String("--sessions")) {
+            options.sessions = value.toInt(&ok);
+        } else if (arg == QLatin1String("--seed")) {
+            options.seed = value.toUInt(&ok);
+        } else {
+            return usage();
+        }
+
+        if (!ok) {
+            return usage();
+        }
+    }
+
+    Torturer torturer(options);
+    QObject::connect(&torturer, SIGNAL(finished()), &app, SLOT(quit()));
+    torturer.start();
+    app.exec();
+
+    return torturer.result();
+}
@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "torturer.h"
+
+#include <QAbstractItemModel>
+#include <QDebug>
+#include <QFile>
+#include <QTextStream>
+
+#include <algorithm>
+
+#if defined(Q_OS_LINUX)
+#include <unistd.h>
+#endif
+
+#include "sprinter/querysession.h"
+
+using namespace Sprinter;
+
+Torturer::Torturer(const Options &options, QObject *parent)
+    : QObject(parent),
+      m_options(options),
+      m_session(0),
+      m_sessionCount(0),
+      m_keystrokes(0),
+      m_actions(0),
+      m_rowsRead(0),
+      m_staleResults(0),
+      m_matchRuns(0),
+      m_cancellations(0),
+      m_staleRows(0),
+      m_loadFailures(0)
+{
+    qsrand(m_options.seed);
+
+    m_stepTimer.setSingleShot(true);
+    connect(&m_stepTimer, SIGNAL(timeout()), this, SLOT(step()));
+
+    m_sessionTimer.setSingleShot(true);
+    m_sessionTimer.setInterval(qMax(1, m_options.duration * 1000 / qMax(1, m_options.sessions)));
+    connect(&m_sessionTimer, SIGNAL(timeout()), this, SLOT(endSession()));
+}
+
+int Torturer::result() const
+{
+    return m_staleRows > 0 || m_loadFailures > 0 ? 1 : 0;
+}
+
+void Torturer::start()
+{
+    startSession();
+}
+
+void Torturer::startSession()
+{
+    if (m_sessionCount > 0) {
+        m_resident << residentBytes();
+    }
+
+    if (m_sessionCount >= m_options.sessions) {
+        report();
+        emit finished();
+        return;
+    }
+
+    m_query.clear();
+    m_disabled.clear();
+    m_disabledAtQuery.clear();
+
+    m_session = new QuerySession(this);
+    connect(m_session->runnerModel(), SIGNAL(runnerIdsChanged()),
+            this, SLOT(prepareRunners()));
+    connect(m_session, SIGNAL(rowsInserted(QModelIndex,int,int)),
+            this, SLOT(rowsInserted(QModelIndex,int,int)));
+    connect(m_session, SIGNAL(queryCompleted(int,int,int)),
+            this, SLOT(queryCompleted(int,int,int)));
+    m_sessionTimer.start();
+}
+
+void Torturer::prepareRunners()
+{
+    if (!m_session || m_stepTimer.isActive()) {
+        return;
+    }
+
+    QAbstractItemModel *runners = m_session->runnerModel();
+    const QStringList available = runners->property("runnerIds").toStringList();
+    if (available.isEmpty()) {
+        return;
+    }
+
+    m_runnerIds.clear();
+    if (m_options.runnerIds.isEmpty()) {
+        m_runnerIds = available;
+    } else {
+        for (auto const &id: m_options.runnerIds) {
+            if (available.contains(id)) {
+                m_runnerIds << id;
+            } else if (m_sessionCount == 0) {
+                qWarning() << "No such runner:" << id;
+                ++m_loadFailures;
+            }
+        }
+    }
+
+    runners->setProperty("enabledRunners", m_runnerIds);
+    for (auto const &id: m_runnerIds) {
+        QMetaObject::invokeMethod(runners, "loadRunner", Q_ARG(int, available.indexOf(id)));
+    }
+
+    step();
+}
+
+void Torturer::step()
+{
+    if (!m_session) {
+        return;
+    }
+
+    ++m_actions;
+    const int action = qrand() % 100;
+    if (action < 70) {
+        static const QString keys = QStringLiteral("abcdefghijklmnopqrstuvwxyz ");
+        if (!m_query.isEmpty() && qrand() % 5 == 0) {
+            m_query.chop(1);
+        } else {
+            m_query.append(keys.at(qrand() % keys.size()));
+        }
+        ++m_keystrokes;
+        setQuery(m_query);
+    } else if (action < 78) {
+        m_session->requestMoreMatches();
+    } else if (action < 83) {
+        m_query.clear();
+        m_disabledAtQuery = m_disabled;
+        m_session->requestDefaultMatches();
+    } else if (action < 88) {
+        m_session->halt();
+    } else if (action < 95) {
+        toggleRunner();
+    } else {
+        m_query.clear();
+        setQuery(m_query);
+    }
+
+    // on average rate actions per second, in irregular bursts
+    m_stepTimer.start(qrand() % (2000 / qMax(1, m_options.rate) + 1));
+}
+
+void Torturer::setQuery(const QString &query)
+{
+    m_disabledAtQuery = m_disabled;
+    m_session->setQuery(query);
+}
+
+void Torturer::toggleRunner()
+{
+    if (m_runnerIds.isEmpty()) {
+        return;
+    }
+
+    const QString id = m_runnerIds.at(qrand() % m_runnerIds.size());
+    if (m_disabled.contains(id)) {
+        m_disabled.remove(id);
+    } else {
+        m_disabled.insert(id);
+    }
+
+    QStringList enabled;
+    for (auto const &runnerId: m_runnerIds) {
+        if (!m_disabled.contains(runnerId)) {
+            enabled << runnerId;
+        }
+    }
+
+    m_session->runnerModel()->setProperty("enabledRunners", enabled);
+}
+
+void Torturer::rowsInserted(const QModelIndex &parent, int first, int last)
+{
+    // read the new rows as a view would
+    for (int row = first; row <= last; ++row) {
+        const QModelIndex index = m_session->index(row, 0, parent);
+        m_session->data(index, Qt::DisplayRole);
+        m_session->data(index, QuerySession::TextRole);
+        m_session->data(index, QuerySession::RunnerRole);
+        ++m_rowsRead;
+    }
+}
+
+void Torturer::queryCompleted(int firstMatchMsecs, int lastMatchMsecs, int idleMsecs)
+{
+    if (firstMatchMsecs >= 0) {
+        m_firstMatch << firstMatchMsecs;
+    }
+
+    if (lastMatchMsecs >= 0) {
+        m_lastMatch << lastMatchMsecs;
+    }
+
+    m_idle << idleMsecs;
+    checkDisabledRows();
+}
+
+void Torturer::checkDisabledRows()
+{
+    // runners disabled before the query started must have no rows left
+    // once it has completed
+    const int rows = m_session->rowCount();
+    for (int row = 0; row < rows; ++row) {
+        const QString runner = m_session->data(m_session->index(row, 0), QuerySession::RunnerRole).toString();
+        if (m_disabledAtQuery.contains(runner) && m_disabled.contains(runner)) {
+            qWarning() << "Row" << row << "still shows a match from disabled runner" << runner;
+            ++m_staleRows;
+        }
+    }
+}
+
+void Torturer::endSession()
+{
+    m_stepTimer.stop();
+    m_session->halt();
+
+    QAbstractItemModel *runners = m_session->runnerModel();
+    const QStringList available = runners->property("runnerIds").toStringList();
+    const int loadedRole = runners->roleNames().key("IsLoadedRole");
+    for (auto const &id: m_runnerIds) {
+        if (!runners->data(runners->index(available.indexOf(id), 0), loadedRole).toBool()) {
+            qWarning() << "Runner failed to load:" << id;
+            ++m_loadFailures;
+        }
+
+        const QVariantMap stats = m_session->runnerStatistics(id);
+        m_staleResults += stats.value(QStringLiteral("StaleResults")).toLongLong();
+        m_matchRuns += stats.value(QStringLiteral("MatchRuns")).toLongLong();
+        m_cancellations += stats.value(QStringLiteral("Cancellations")).toLongLong();
+    }
+
+    delete m_session;
+    m_session = 0;
+    ++m_sessionCount;
+
+    // let deferred deletes run before measuring memory
+    QTimer::singleShot(250, this, SLOT(startSession()));
+}
+
+qint64 Torturer::residentBytes()
+{
+#if defined(Q_OS_LINUX)
+    QFile statm(QStringLiteral("/proc/self/statm"));
+    if (statm.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.size() > 1) {
+            return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+        }
+    }
+#endif
+    return -1;
+}
+
+void Torturer::printLatencies(const char *name, QVector<int> &samples)
+{
+    QTextStream out(stdout);
+    out << "  " << name << ": ";
+    if (samples.isEmpty()) {
+        out << "no samples\n";
+        return;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    const int count = samples.size();
+    auto percentile = [&samples, count](int percent) {
+        return samples.at(qMax(0, (count * percent + 99) / 100 - 1));
+    };
+
+    out << "p50 " << percentile(50) << "ms, p95 " << percentile(95)
+        << "ms, p99 " << percentile(99) << "ms, max " << samples.last()
+        << "ms (" << count << " queries)\n";
+}
+
+void Torturer::report()
+{
+    QTextStream out(stdout);
+    out << "Runners: " << m_runnerIds.join(QStringLiteral(", ")) << "\n"
+        << "Seed: " << m_options.seed << "\n"
+        << "Sessions: " << m_sessionCount << "\n"
+        << "Actions: " << m_actions << " (" << m_keystrokes << " keystrokes)\n"
+        << "Rows read: " << m_rowsRead << "\n"
+        << "Latency:\n";
+    out.flush();
+
+    printLatencies("first match", m_firstMatch);
+    printLatencies("last match", m_lastMatch);
+    printLatencies("runners idle", m_idle);
+
+    out << "Match runs: " << m_matchRuns << " (" << m_cancellations << " outlived their query)\n"
+        << "Stale results (setMatches after invalidation, dropped): " << m_staleResults << "\n"
+        << "Stale rows (matches of disabled runners left in the model): " << m_staleRows << "\n"
+        << "Load failures: " << m_loadFailures << "\n";
+
+    if (m_resident.size() > 1 && m_resident.first() >= 0) {
+        const qint64 growth = (m_resident.last() - m_resident.first()) / (m_resident.size() - 1);
+        out << "Resident memory after each session (KiB):";
+        for (qint64 bytes: m_resident) {
+            out << " " << bytes / 1024;
+        }
+        out << "\nMemory growth per session: " << growth / 1024 << " KiB\n";
+    } else {
+        out << "Memory growth per session: not measured\n";
+    }
+}
+
+#include "moc_torturer.cpp"
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2014 Aaron Seigo <aseigo@kde.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TORTURER_H
+#define TORTURER_H
+
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+
+namespace Sprinter
+{
+    class QuerySession;
+} // namespace
+
+/**
+ * Drives runner plugins through a series of QuerySessions the way an
+ * impatient user would: bursts of keystrokes with fetchMore, default
+ * match requests, halts and runners being enabled and disabled in
+ * between, all while earlier queries are still being matched.
+ *
+ * The runners are found and loaded by QuerySession itself, exactly as
+ * they are in applications. At the end a report of latencies, stale
+ * results and memory growth is written to stdout.
+ */
+class Torturer : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options
+    {
+        Options()
+            : duration(30),
+              rate(50),
+              sessions(3),
+              seed(0)
+        {
+        }
+
+        QStringList runnerIds;
+        int duration;
+        int rate;
+        int sessions;
+        uint seed;
+    };
+
+    Torturer(const Options &options, QObject *parent = 0);
+
+    /**
+     * @return the process exit code: non-zero if a runner failed to load
+     * or the model still held matches of a runner after disabling it
+     */
+    int result() const;
+
+public Q_SLOTS:
+    void start();
+
+Q_SIGNALS:
+    void finished();
+
+private Q_SLOTS:
+    void startSession();
+    void endSession();
+    void prepareRunners();
+    void step();
+    void rowsInserted(const QModelIndex &parent, int first, int last);
+    void queryCompleted(int firstMatchMsecs, int lastMatchMsecs, int idleMsecs);
+
+private:
+    void setQuery(const QString &query);
+    void toggleRunner();
+    void checkDisabledRows();
+    void report();
+    static qint64 residentBytes();
+    static void printLatencies(const char *name, QVector<int> &samples);
+
+    Options m_options;
+    Sprinter::QuerySession *m_session;
+    QTimer m_stepTimer;
+    QTimer m_sessionTimer;
+    QStringList m_runnerIds;
+    QSet<QString> m_disabled;
+    QSet<QString> m_disabledAtQuery;
+    QString m_query;
+    int m_sessionCount;
+
+    QVector<int> m_firstMatch;
+    QVector<int> m_lastMatch;
+    QVector<int> m_idle;
+    QVector<qint64> m_resident;
+    qint64 m_keystrokes;
+    qint64 m_actions;
+    qint64 m_rowsRead;
+    qint64 m_staleResults;
+    qint64 m_matchRuns;
+    qint64 m_cancellations;
+    int m_staleRows;
+    int m_loadFailures;
+};
+
+#endif